@@ -19,14 +19,22 @@ author = 'This page is maintained by the Flux community.'
 man_pages = [
     ('man3/flux_sign_wrap', 'flux_sign_wrap', 'Wrap signed credential', [author], 3),
     ('man3/flux_sign_wrap', 'flux_sign_wrap_as', 'Wrap signed credential', [author], 3),
+    ('man3/flux_sign_wrap', 'flux_sign_wrap_batch', 'Wrap signed credential', [author], 3),
+    ('man3/flux_sign_wrap', 'flux_sign_wrap_batch_as', 'Wrap signed credential', [author], 3),
+    ('man3/flux_sign_wrap', 'flux_sign_wrap_delta', 'Wrap signed credential', [author], 3),
     ('man3/flux_sign_unwrap', 'flux_sign_unwrap', 'Unwrap signed credential', [author], 3),
     ('man3/flux_sign_unwrap', 'flux_sign_unwrap_anymech', 'Unwrap signed credential', [author], 3),
+    ('man3/flux_sign_unwrap', 'flux_sign_unwrap_delta', 'Unwrap signed credential', [author], 3),
     ('man3/flux_security_create', 'flux_security_create', 'Create Flux security context', [author], 3),
     ('man3/flux_security_create', 'flux_security_destroy', 'Destroy Flux security context', [author], 3),
     ('man3/flux_security_last_error', 'flux_security_last_error', 'Get last error string', [author], 3),
     ('man3/flux_security_last_error', 'flux_security_last_errnum', 'Get last error number', [author], 3),
     ('man3/flux_security_aux_set', 'flux_security_aux_set', 'Attach data to security context', [author], 3),
     ('man3/flux_security_aux_set', 'flux_security_aux_get', 'Retrieve data from security context', [author], 3),
+    ('man3/flux_security_config_get', 'flux_security_config_get', 'Share security configuration', [author], 3),
+    ('man3/flux_security_config_get', 'flux_security_config_attach', 'Share security configuration', [author], 3),
+    ('man3/flux_security_config_get', 'flux_security_config_incref', 'Share security configuration', [author], 3),
+    ('man3/flux_security_config_get', 'flux_security_config_decref', 'Share security configuration', [author], 3),
     ('man5/flux-config-security', 'flux-config-security', 'Flux security configuration files', [author], 5),
     ('man5/flux-config-security-imp', 'flux-config-security-imp', 'configure Flux IMP behavior', [author], 5),
     ('man5/flux-config-security-sign', 'flux-config-security-sign', 'configure Flux security signing library', [author], 5),
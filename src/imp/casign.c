@@ -35,16 +35,11 @@
 static struct sigcert *get_cert_from_kv (const struct kv *kv)
 {
     struct kv *cert_kv;
-    const char *buf;
-    int len;
-    struct sigcert *cert = NULL;
+    struct sigcert *cert;
 
-    if (!(cert_kv = kv_split (kv, "cert")))
-        goto done;
-    if (kv_encode (cert_kv, &buf, &len) < 0)
-        goto done;
-    cert = sigcert_decode (buf, len);
-done:
+    if (!(cert_kv = kv_view_prefix (kv, "cert")))
+        return NULL;
+    cert = sigcert_decode_kv (cert_kv);
     kv_destroy (cert_kv);
     return cert;
 }
@@ -61,7 +56,7 @@ static int add_cert_to_kv (struct kv *kv, const struct sigcert *cert)
 
     if (sigcert_encode (cert, &buf, &len) < 0)
         goto done;
-    if (!(cert_kv = kv_decode (buf, len)))
+    if (!(cert_kv = kv_view (buf, len)))
         goto done;
     rc = kv_join (kv, cert_kv, "cert");
 done:
@@ -0,0 +1,441 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdbool.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_MAGIC_H
+#include <linux/magic.h>
+#endif
+#if HAVE_STRUCT_CLONE_ARGS
+#include <linux/sched.h>
+#endif
+#include <signal.h>
+
+#include "src/libutil/strlcpy.h"
+
+#include "cgroup.h"
+#include "imp_log.h"
+#include "pidfd.h"
+
+#if HAVE_STRUCT_CLONE_ARGS && defined (SYS_clone3) \
+    && defined (CLONE_INTO_CGROUP)
+#define HAVE_CLONE_INTO_CGROUP 1
+#endif
+
+/*  See https://systemd.io/CGROUP_DELEGATION/
+ */
+int cgroup_info_init (struct cgroup_info *cg)
+{
+    struct statfs fs;
+
+    (void) strlcpy (cg->mount_dir, "/sys/fs/cgroup", sizeof (cg->mount_dir));
+    cg->unified = true;
+
+    if (statfs (cg->mount_dir, &fs) < 0)
+        return -1;
+
+#ifdef CGROUP2_SUPER_MAGIC
+    /* if cgroup2 fs mounted: unified hierarchy for all users of cgroupfs
+     */
+    if (fs.f_type == CGROUP2_SUPER_MAGIC)
+        return 0;
+#endif /* CGROUP2_SUPER_MAGIC */
+
+    /*  O/w, if /sys/fs/cgroup is mounted as tmpfs, we need to check
+     *   for /sys/fs/cgroup/systemd mounted as cgroupfs (legacy).
+     *   We do not support hybrid mode (/sys/fs/cgroup/systemd or
+     *   /sys/fs/cgroup/unified mounted as cgroup2fs), since there were
+     *   no systems on which to test this configuration.
+     */
+    if (fs.f_type == TMPFS_MAGIC) {
+
+        (void) strlcpy (cg->mount_dir,
+                        "/sys/fs/cgroup/systemd",
+                        sizeof (cg->mount_dir));
+        if (statfs (cg->mount_dir, &fs) == 0
+            && fs.f_type == CGROUP_SUPER_MAGIC) {
+            cg->unified = false;
+            return 0;
+            }
+    }
+
+    /*  Unable to determine cgroup mount point and/or unified vs legacy */
+    return -1;
+}
+
+/*  Return true if 'path' is on a cgroup2 filesystem.
+ */
+static bool is_cgroup2 (const char *path)
+{
+#ifdef CGROUP2_SUPER_MAGIC
+    struct statfs fs;
+    if (statfs (path, &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC)
+        return true;
+#endif /* CGROUP2_SUPER_MAGIC */
+    return false;
+}
+
+/*  Find the cgroup2 mount point.  Unlike cgroup_info_init(), this
+ *   includes the cgroup2 hierarchy of hybrid mode, since it is only
+ *   used to place processes.
+ */
+static const char *cgroup2_mount_dir (void)
+{
+    if (is_cgroup2 ("/sys/fs/cgroup"))
+        return "/sys/fs/cgroup";
+    if (is_cgroup2 ("/sys/fs/cgroup/unified"))
+        return "/sys/fs/cgroup/unified";
+    return NULL;
+}
+
+/*  Return true if 'path' is absolute with no "." or ".." components.
+ */
+static bool cgroup_path_valid (const char *path)
+{
+    const char *p = path;
+
+    if (*p != '/')
+        return false;
+    while (*p) {
+        const char *next;
+        int n;
+        while (*p == '/')
+            p++;
+        n = (next = strchr (p, '/')) ? next - p : (int) strlen (p);
+        if ((n == 1 && p[0] == '.')
+            || (n == 2 && p[0] == '.' && p[1] == '.'))
+            return false;
+        p += n;
+    }
+    return true;
+}
+
+int cgroup_open (const char *path, uid_t owner)
+{
+    const char *mount_dir;
+    char buf[PATH_MAX + 1];
+    struct stat st;
+    int fd;
+
+    if (!path || !cgroup_path_valid (path)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(mount_dir = cgroup2_mount_dir ())) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    if (snprintf (buf, sizeof (buf), "%s%s", mount_dir, path)
+        >= (int) sizeof (buf)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((fd = open (buf, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0)
+        return -1;
+    if (fstat (fd, &st) < 0)
+        goto error;
+    if (owner != (uid_t) -1 && st.st_uid != owner) {
+        errno = EPERM;
+        goto error;
+    }
+    return fd;
+error:
+    {
+        int saved_errno = errno;
+        close (fd);
+        errno = saved_errno;
+    }
+    return -1;
+}
+
+/*  Move the calling process into the cgroup open on 'cgroup_fd'.
+ */
+static int cgroup_enter (int cgroup_fd)
+{
+    int fd;
+    int rc = -1;
+
+    if ((fd = openat (cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC)) < 0)
+        return -1;
+    if (write (fd, "0", 1) == 1)
+        rc = 0;
+    (void) close (fd);
+    return rc;
+}
+
+#if HAVE_CLONE_INTO_CGROUP
+static pid_t clone_into_cgroup (int cgroup_fd)
+{
+    struct clone_args args;
+
+    memset (&args, 0, sizeof (args));
+    args.flags = CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = (uint64_t) cgroup_fd;
+
+    return (pid_t) syscall (SYS_clone3, &args, sizeof (args));
+}
+#endif /* HAVE_CLONE_INTO_CGROUP */
+
+pid_t cgroup_fork (int cgroup_fd)
+{
+    pid_t pid;
+
+    if (cgroup_fd < 0)
+        return fork ();
+
+#if HAVE_CLONE_INTO_CGROUP
+    /*  ENOSYS: no clone3(2), E2BIG or EINVAL: kernel does not support
+     *   CLONE_INTO_CGROUP, EBADF: cgroup_fd is not on cgroup2, e.g. the
+     *   legacy systemd hierarchy.  Any other error would also occur on
+     *   migration.
+     */
+    if ((pid = clone_into_cgroup (cgroup_fd)) >= 0
+        || (errno != ENOSYS && errno != E2BIG && errno != EINVAL
+            && errno != EBADF))
+        return pid;
+#endif /* HAVE_CLONE_INTO_CGROUP */
+
+    if ((pid = fork ()) == 0) {
+        if (cgroup_enter (cgroup_fd) < 0)
+            imp_die (1, "failed to enter cgroup: %s", strerror (errno));
+    }
+    return pid;
+}
+
+/*  Write SIGKILL request to cgroup.kill of cgroup open on 'dirfd'.
+ */
+static int cgroup_kill_all (int dirfd)
+{
+    int fd;
+    int rc = -1;
+
+    if ((fd = openat (dirfd, "cgroup.kill", O_WRONLY | O_CLOEXEC)) < 0)
+        return -1;
+    if (write (fd, "1", 1) == 1)
+        rc = 0;
+    (void) close (fd);
+    return rc;
+}
+
+static int pid_cmp (const void *a, const void *b)
+{
+    pid_t p1 = *(const pid_t *)a;
+    pid_t p2 = *(const pid_t *)b;
+    return (p1 > p2) - (p1 < p2);
+}
+
+/*  Signal 'pid' through 'pidfd', or with kill(2) if 'pidfd' is -1.
+ */
+static int signal_pid (pid_t pid, int pidfd, int sig)
+{
+    if (pidfd >= 0)
+        return imp_pidfd_send_signal (pidfd, sig);
+    return kill (pid, sig);
+}
+
+/*  Read the pids in cgroup.procs of cgroup open on 'dirfd' into a sorted
+ *   array, which the caller must free.  Returns the number of pids, or
+ *   -1 on failure.
+ */
+static int cgroup_read_procs (int dirfd, pid_t **pidsp)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t size = 0;
+    pid_t *pids = NULL;
+    int count = 0;
+    int alloc = 0;
+    int fd;
+
+    if ((fd = openat (dirfd, "cgroup.procs", O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    if (!(fp = fdopen (fd, "r"))) {
+        (void) close (fd);
+        return -1;
+    }
+    while (getline (&line, &size, fp) >= 0) {
+        pid_t pid = strtol (line, NULL, 10);
+        if (pid <= 0)
+            continue;
+        if (count == alloc) {
+            int newalloc = alloc ? alloc * 2 : 64;
+            pid_t *new;
+            if (!(new = realloc (pids, newalloc * sizeof (*new)))) {
+                free (pids);
+                free (line);
+                fclose (fp);
+                errno = ENOMEM;
+                return -1;
+            }
+            pids = new;
+            alloc = newalloc;
+        }
+        pids[count++] = pid;
+    }
+    free (line);
+    fclose (fp);
+    if (count > 1)
+        qsort (pids, count, sizeof (*pids), pid_cmp);
+    *pidsp = pids;
+    return count;
+}
+
+/*  Signal each process in cgroup.procs of cgroup open on 'dirfd', then
+ *   recurse into child cgroups.  Returns the number of processes
+ *   signaled or -1 on failure.
+ *
+ *  Each pid is pinned with a pidfd, then cgroup.procs is read again to
+ *   confirm the pid is still in the cgroup before the pidfd is signaled.
+ *   A pid that exited and was reused after the first read is either not
+ *   listed the second time, or refers to a process that was in the
+ *   cgroup while the pidfd held it.  kill(2) is used only when pidfds
+ *   are not supported.
+ */
+static int cgroup_kill_procs (int dirfd, int sig)
+{
+    DIR *dirp;
+    struct dirent *dent;
+    pid_t *pids = NULL;
+    pid_t *current = NULL;
+    int *pidfds = NULL;
+    pid_t self = getpid ();
+    bool nopidfd = false;
+    int npids;
+    int ncurrent;
+    int count = 0;
+    int fd;
+    int i;
+
+    if ((npids = cgroup_read_procs (dirfd, &pids)) < 0)
+        return -1;
+    if (npids > 0) {
+        if (!(pidfds = calloc (npids, sizeof (*pidfds)))) {
+            free (pids);
+            return -1;
+        }
+        for (i = 0; i < npids; i++) {
+            pidfds[i] = -1;
+            if (pids[i] == self || nopidfd)
+                continue;
+            if ((pidfds[i] = imp_pidfd_open (pids[i])) < 0) {
+                if (errno == ENOSYS)
+                    nopidfd = true;
+                else if (errno != ESRCH)
+                    imp_warn ("pidfd_open %jd: %s",
+                              (intmax_t) pids[i],
+                              strerror (errno));
+            }
+        }
+        if ((ncurrent = cgroup_read_procs (dirfd, &current)) < 0) {
+            imp_warn ("failed to read cgroup.procs: %s", strerror (errno));
+            ncurrent = 0;
+        }
+        for (i = 0; i < npids; i++) {
+            if ((pidfds[i] >= 0 || nopidfd)
+                && pids[i] != self
+                && ncurrent > 0
+                && bsearch (&pids[i],
+                            current,
+                            ncurrent,
+                            sizeof (*current),
+                            pid_cmp)) {
+                if (signal_pid (pids[i], pidfds[i], sig) == 0)
+                    count++;
+                else if (errno != ESRCH)
+                    imp_warn ("kill %jd: %s",
+                              (intmax_t) pids[i],
+                              strerror (errno));
+            }
+            if (pidfds[i] >= 0)
+                (void) close (pidfds[i]);
+        }
+        free (current);
+        free (pidfds);
+    }
+    free (pids);
+
+    /*  Child cgroups are the subdirectories of a cgroup
+     */
+    if ((fd = openat (dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        return -1;
+    if (!(dirp = fdopendir (fd))) {
+        (void) close (fd);
+        return -1;
+    }
+    while ((dent = readdir (dirp))) {
+        int n;
+        int cfd;
+
+        if (dent->d_type != DT_DIR
+            || strcmp (dent->d_name, ".") == 0
+            || strcmp (dent->d_name, "..") == 0)
+            continue;
+        cfd = openat (dirfd,
+                      dent->d_name,
+                      O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (cfd < 0)
+            continue;
+        if ((n = cgroup_kill_procs (cfd, sig)) > 0)
+            count += n;
+        (void) close (cfd);
+    }
+    closedir (dirp);
+    return count;
+}
+
+int cgroup_kill (const char *path, int sig)
+{
+    int dirfd;
+    int rc;
+
+    if (!path || sig < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((dirfd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        return -1;
+
+    /*  cgroup.kill does not exist on cgroup v1 or before Linux 5.14
+     */
+    if (sig == SIGKILL && cgroup_kill_all (dirfd) == 0)
+        rc = 0;
+    else
+        rc = cgroup_kill_procs (dirfd, sig);
+
+    if (rc < 0) {
+        int saved_errno = errno;
+        (void) close (dirfd);
+        errno = saved_errno;
+        return -1;
+    }
+    (void) close (dirfd);
+    return rc;
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,64 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef HAVE_IMP_CGROUP_H
+#define HAVE_IMP_CGROUP_H 1
+
+#include <stdbool.h>
+#include <limits.h>
+#include <sys/types.h>
+
+struct cgroup_info {
+    char mount_dir[PATH_MAX + 1];
+    bool unified;
+};
+
+/*  Determine if this system is using the unified (v2) or legacy (v1)
+ *   cgroups hierarchy and the mount point for systemd managed cgroups.
+ *  Returns 0 on success, -1 if neither could be determined.
+ */
+int cgroup_info_init (struct cgroup_info *cg);
+
+/*  Open the cgroup2 directory 'path', given relative to the root of the
+ *   cgroup2 hierarchy, e.g. "/system.slice/flux.service/job", for use
+ *   with cgroup_fork().  If 'owner' is not (uid_t) -1, the cgroup must
+ *   be owned by 'owner'.
+ *
+ *  Returns an O_PATH file descriptor on success, -1 on failure with
+ *   errno set:
+ *    EINVAL  - path is not absolute or contains "." or ".." components
+ *    ENOTSUP - no cgroup2 hierarchy is mounted
+ *    EPERM   - cgroup is not owned by 'owner'
+ */
+int cgroup_open (const char *path, uid_t owner);
+
+/*  Fork a child process directly into the cgroup open on 'cgroup_fd'
+ *   using clone3(2) with CLONE_INTO_CGROUP.  If that is not supported,
+ *   or 'cgroup_fd' is a legacy (v1) cgroup, fall back to fork(2), after
+ *   which the child moves itself into the cgroup, exiting on failure.
+ *   If cgroup_fd < 0, just fork(2).
+ *
+ *  Returns as fork(2).
+ */
+pid_t cgroup_fork (int cgroup_fd);
+
+/*  Send signal 'sig' to every process in the cgroup at 'path', a full
+ *   path such as pid_info.cg_path, and its descendant cgroups.  SIGKILL
+ *   is sent with a single write to cgroup.kill where supported (cgroup2,
+ *   Linux 5.14+).  Otherwise each process listed in cgroup.procs is
+ *   signaled, skipping the calling process.  Since cgroup.kill would
+ *   also kill the caller, callers must not be in the cgroup.
+ *
+ *  Returns the number of processes signaled, or 0 if cgroup.kill was
+ *   used.  Returns -1 on failure with errno set.
+ */
+int cgroup_kill (const char *path, int sig);
+
+#endif /* !HAVE_IMP_CGROUP_H */
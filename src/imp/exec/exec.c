@@ -11,12 +11,35 @@
 /* exec - given valid signed 'J', execute a job shell as user
  *
  * Usage: flux-imp exec /path/to/job/shell arg
+ *        flux-imp exec < jobs.json
  *
  * Input:
  *
  * Signed J as key "J" in JSON object on stdin, path to requested
  *  job shell and single argument on cmdline.
  *
+ * Cgroup:
+ *
+ * An optional "cgroup" key in the JSON object on stdin requests that
+ *  the job shell be started directly in that cgroup2 cgroup, given
+ *  relative to the root of the hierarchy.  The cgroup must be owned by
+ *  the IMP user.  Otherwise, exec.cgroup from the IMP configuration is
+ *  used if set.  The shell is created in the cgroup with clone3(2)
+ *  CLONE_INTO_CGROUP where available, so it is never accounted to
+ *  the IMP's own cgroup.
+ *
+ * Multi-exec:
+ *
+ * With no cmdline arguments, stdin is a JSON array of objects
+ *  {"J":s, "shell_path":s, "args"?:[s], "cgroup"?:s}, each describing
+ *  one job shell.
+ *  Every J is verified and every shell checked against allowed-shells
+ *  before any shell is started.  Shells are then launched and supervised
+ *  from a single privileged IMP.  As each shell exits, a JSON object
+ *  {"index":i, "pid":i, "status":i} is written to stdout, where status is
+ *  the exit code of the shell, or 128 + signal number if it was killed.
+ *  The IMP exits with 0 if all shells exited with 0, 1 otherwise.
+ *
  */
 
 #if HAVE_CONFIG_H
@@ -29,7 +52,15 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#if HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+#include <poll.h>
+#include <signal.h>
 #include <sys/types.h>
+#include <sys/signalfd.h>
 #include <wait.h>
 #include <jansson.h>
 
@@ -42,12 +73,30 @@
 #include "impcmd.h"
 #include "privsep.h"
 #include "passwd.h"
+#include "cgroup.h"
+#include "pidfd.h"
 #include "user.h"
 
 #if HAVE_PAM
 #include "pam.h"
 #endif
 
+/*  Max number of job shells in one multi-exec request */
+#define IMP_EXEC_MULTI_MAX 1024
+
+/*  One job shell of a multi-exec request.
+ */
+struct imp_exec_job {
+    struct kv *kv;          /* Job kv from unprivileged child (owns J) */
+    const char *J;
+    const char *shell;
+    struct kv *args;
+    const char *cgroup;
+    int cgroup_fd;
+    uid_t userid;
+    pid_t pid;
+};
+
 struct imp_exec {
     struct passwd *imp_pwd;
     struct imp_state *imp;
@@ -60,11 +109,37 @@ struct imp_exec {
     const char *J;
     const char *shell;
     struct kv *args;
+    const char *cgroup;
+    int cgroup_fd;
     const void *spec;
     int specsz;
+
+    struct imp_exec_job *jobs;  /* multi-exec only */
+    int njobs;
 };
 
-static pid_t imp_child = (pid_t) -1;
+/*  Signals received by the IMP which are forwarded to job shells */
+static const int forward_signals[] = {
+    SIGTERM,
+    SIGINT,
+    SIGHUP,
+    SIGCONT,
+    SIGALRM,
+    SIGWINCH,
+    SIGTTIN,
+    SIGTTOU,
+};
+static const int nforward_signals =
+    sizeof (forward_signals) / sizeof (forward_signals[0]);
+
+/*  Called by imp_exec_supervise() as child 'index' exits
+ */
+typedef void (*imp_exec_exit_f) (int index,
+                                 pid_t pid,
+                                 int status,
+                                 void *arg);
+
+extern char **environ;
 
 extern const char *imp_get_security_config_pattern (void);
 extern int imp_get_security_flags (void);
@@ -83,14 +158,12 @@ static flux_security_t *sec_init (void)
 
 static bool imp_exec_user_allowed (struct imp_exec *exec)
 {
-    return cf_array_contains (cf_get_in (exec->conf, "allowed-users"),
-                              exec->imp_pwd->pw_name);
+    return cf_set_contains (exec->imp->exec_users, exec->imp_pwd->pw_name);
 }
 
-static bool imp_exec_shell_allowed (struct imp_exec *exec)
+static bool imp_exec_shell_allowed (struct imp_exec *exec, const char *shell)
 {
-    return cf_array_contains (cf_get_in (exec->conf, "allowed-shells"),
-                              exec->shell);
+    return cf_set_contains (exec->imp->exec_shells, shell);
 }
 
 static bool imp_exec_unprivileged_allowed (struct imp_exec *exec)
@@ -107,13 +180,32 @@ static bool imp_supports_pam (struct imp_exec *exec) {
 }
 #endif
 
+static void imp_exec_jobs_destroy (struct imp_exec_job *jobs, int njobs)
+{
+    int i;
+
+    if (jobs) {
+        for (i = 0; i < njobs; i++) {
+            kv_destroy (jobs[i].kv);
+            kv_destroy (jobs[i].args);
+            if (jobs[i].cgroup_fd >= 0)
+                close (jobs[i].cgroup_fd);
+        }
+        free (jobs);
+    }
+}
+
 static void imp_exec_destroy (struct imp_exec *exec)
 {
     if (exec) {
-        flux_security_destroy (exec->sec);
+        imp_exec_jobs_destroy (exec->jobs, exec->njobs);
+        if (exec->sec != exec->imp->sec)
+            flux_security_destroy (exec->sec);
         json_decref (exec->input);
         passwd_destroy (exec->imp_pwd);
         kv_destroy (exec->args);
+        if (exec->cgroup_fd >= 0)
+            close (exec->cgroup_fd);
         free (exec);
     }
 }
@@ -123,8 +215,9 @@ static struct imp_exec *imp_exec_create (struct imp_state *imp)
     struct imp_exec *exec = calloc (1, sizeof (*exec));
     if (exec) {
         exec->userid = (uid_t) -1;
+        exec->cgroup_fd = -1;
         exec->imp = imp;
-        exec->sec = sec_init ();
+        exec->sec = imp->sec ? imp->sec : sec_init ();
         exec->conf = cf_get_in (imp->conf, "exec");
 
         if (!(exec->imp_pwd = passwd_from_uid (getuid ())))
@@ -133,7 +226,7 @@ static struct imp_exec *imp_exec_create (struct imp_state *imp)
     return exec;
 }
 
-static void imp_exec_unwrap (struct imp_exec *exec, const char *J)
+static uid_t imp_exec_unwrap (struct imp_exec *exec, const char *J)
 {
     int64_t userid;
 
@@ -146,7 +239,7 @@ static void imp_exec_unwrap (struct imp_exec *exec, const char *J)
         imp_die (1, "exec: signature validation failed: %s",
                  flux_security_last_error (exec->sec));
 
-    exec->userid = (uid_t) userid;
+    return (uid_t) userid;
 }
 
 static void imp_exec_init_kv (struct imp_exec *exec, struct kv *kv)
@@ -162,7 +255,106 @@ static void imp_exec_init_kv (struct imp_exec *exec, struct kv *kv)
     if (!(exec->args = kv_split (kv, "args")))
         imp_die (1, "exec: Failed to get job shell arguments");
 
-    imp_exec_unwrap (exec, exec->J);
+    if (kv_get (kv, "cgroup", KV_STRING, &exec->cgroup) < 0
+        && errno != ENOENT)
+        imp_die (1, "exec: Failed to get job cgroup");
+
+    exec->userid = imp_exec_unwrap (exec, exec->J);
+}
+
+/*  Init job 'index' of a multi-exec request from kv sent by the
+ *   unprivileged child.  The job kv is kept since J points into it.
+ */
+static void imp_exec_job_init_kv (struct imp_exec *exec,
+                                  struct kv *kv,
+                                  int index)
+{
+    struct imp_exec_job *job = &exec->jobs[index];
+    char prefix[32];
+
+    snprintf (prefix, sizeof (prefix), "%d.", index);
+    if (!(job->kv = kv_split (kv, prefix)))
+        imp_die (1, "exec: Failed to get job %d", index);
+    if (kv_get (job->kv, "J", KV_STRING, &job->J) < 0)
+        imp_die (1, "exec: Error decoding J of job %d", index);
+    if (kv_get (job->kv, "shell_path", KV_STRING, &job->shell) < 0)
+        imp_die (1, "exec: Failed to get shell path of job %d", index);
+    if (!(job->args = kv_split (job->kv, "args")))
+        imp_die (1, "exec: Failed to get shell arguments of job %d", index);
+    if (kv_get (job->kv, "cgroup", KV_STRING, &job->cgroup) < 0
+        && errno != ENOENT)
+        imp_die (1, "exec: Failed to get cgroup of job %d", index);
+
+    job->userid = imp_exec_unwrap (exec, job->J);
+    job->pid = (pid_t) -1;
+}
+
+/*  Init job 'index' of a multi-exec request from JSON 'o' on stdin.
+ */
+static void imp_exec_job_init_json (struct imp_exec *exec,
+                                    json_t *o,
+                                    int index)
+{
+    struct imp_exec_job *job = &exec->jobs[index];
+    json_t *args = NULL;
+    const char **argv;
+    json_error_t err;
+    size_t i;
+    json_t *arg;
+
+    if (json_unpack_ex (o,
+                        &err,
+                        0,
+                        "{s:s s:s s?o s?s}",
+                        "J", &job->J,
+                        "shell_path", &job->shell,
+                        "args", &args,
+                        "cgroup", &job->cgroup) < 0)
+        imp_die (1, "exec: invalid json input for job %d: %s",
+                 index,
+                 err.text);
+    if (args && !json_is_array (args))
+        imp_die (1, "exec: args of job %d is not an array", index);
+
+    /*  Shell argv is shell_path followed by args, as on the cmdline */
+    if (!(argv = calloc (json_array_size (args) + 2, sizeof (*argv))))
+        imp_die (1, "exec: out of memory");
+    argv[0] = job->shell;
+    json_array_foreach (args, i, arg) {
+        if (!(argv[i + 1] = json_string_value (arg)))
+            imp_die (1, "exec: args of job %d must be strings", index);
+    }
+    if (!(job->args = kv_encode_argv (argv)))
+        imp_die (1, "exec: failed to encode shell arguments of job %d",
+                 index);
+    free (argv);
+
+    job->userid = imp_exec_unwrap (exec, job->J);
+    job->pid = (pid_t) -1;
+}
+
+static void imp_exec_jobs_create (struct imp_exec *exec, int64_t count)
+{
+    int i;
+
+    if (count <= 0 || count > IMP_EXEC_MULTI_MAX)
+        imp_die (1, "exec: number of jobs must be between 1 and %d",
+                 IMP_EXEC_MULTI_MAX);
+    if (!(exec->jobs = calloc (count, sizeof (exec->jobs[0]))))
+        imp_die (1, "exec: out of memory");
+    exec->njobs = count;
+    for (i = 0; i < count; i++)
+        exec->jobs[i].cgroup_fd = -1;
+}
+
+static void imp_exec_init_multi (struct imp_exec *exec)
+{
+    json_t *o;
+    size_t i;
+
+    imp_exec_jobs_create (exec, json_array_size (exec->input));
+    json_array_foreach (exec->input, i, o)
+        imp_exec_job_init_json (exec, o, i);
 }
 
 static void imp_exec_init_stream (struct imp_exec *exec, FILE *fp)
@@ -174,6 +366,16 @@ static void imp_exec_init_stream (struct imp_exec *exec, FILE *fp)
 
     imp = exec->imp;
 
+    /* Multi-exec: array of jobs on stdin and no other arguments */
+    if (imp->argc == 2 && !isatty (fileno (fp))) {
+        if (!(exec->input = json_loadf (fp, 0, &err)))
+            imp_die (1, "exec: invalid json input: %s", err.text);
+        if (!json_is_array (exec->input))
+            imp_die (1, "exec: missing arguments to exec subcommand");
+        imp_exec_init_multi (exec);
+        return;
+    }
+
     /* shell path and `arg` come from imp->argv */
     if (imp->argc < 4)
         imp_die (1, "exec: missing arguments to exec subcommand");
@@ -188,14 +390,16 @@ static void imp_exec_init_stream (struct imp_exec *exec, FILE *fp)
         || json_unpack_ex (exec->input,
                            &err,
                            0,
-                           "{s:s}",
-                           "J", &exec->J) < 0)
+                           "{s:s s?s}",
+                           "J", &exec->J,
+                           "cgroup", &exec->cgroup) < 0)
         imp_die (1, "exec: invalid json input: %s", err.text);
 
-    imp_exec_unwrap (exec, exec->J);
+    exec->userid = imp_exec_unwrap (exec, exec->J);
 }
 
-static void __attribute__((noreturn)) imp_exec (struct imp_exec *exec)
+static void __attribute__((noreturn)) imp_exec (const char *shell,
+                                                struct kv *args)
 {
     char **argv;
     int exit_code;
@@ -206,79 +410,533 @@ static void __attribute__((noreturn)) imp_exec (struct imp_exec *exec)
     if (chdir ("/") < 0)
         imp_die (1, "exec: failed to chdir to /");
 
-    if (kv_expand_argv (exec->args, &argv) < 0)
+    if (kv_expand_argv (args, &argv) < 0)
         imp_die (1, "exec: failed to expand argv");
 
-    execvp (exec->shell, argv);
+    execvp (shell, argv);
 
     if (errno == EPERM || errno == EACCES)
         exit_code =  126;
     exit_code = 127;
-    imp_die (exit_code, "%s: %s", exec->shell, strerror (errno));
+    imp_die (exit_code, "%s: %s", shell, strerror (errno));
+}
+
+static void sigblock_all (void)
+{
+    sigset_t mask;
+    sigfillset (&mask);
+    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
+        imp_die (1, "failed to block signals: %s", strerror (errno));
+}
+
+static void sigunblock_all (void)
+{
+    sigset_t mask;
+    sigemptyset (&mask);
+    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
+        imp_die (1, "failed to unblock signals: %s", strerror (errno));
 }
 
-static void fwd_signal (int signal)
+/*  Return the IMP exit code corresponding to child wait status.
+ */
+static int exit_code (int status)
 {
-    if (imp_child > 0)
-        kill (imp_child, signal);
+    if (WIFEXITED (status))
+        return WEXITSTATUS (status);
+    else if (WIFSIGNALED (status))
+        return WTERMSIG (status) + 128;
+    return 1;
 }
 
-/*  Setup signal handlers in the IMP for common signals which
- *   we want to forward to any child process.
+/*  Forward signal 'signum' to all running children.  Use the pidfd
+ *   where available so a reaped child's pid can never be signaled.
+ */
+static void forward_signal (const pid_t *pids,
+                            const int *pidfds,
+                            int n,
+                            int signum)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (pids[i] <= 0)
+            continue;
+        if (pidfds[i] >= 0)
+            (void) imp_pidfd_send_signal (pidfds[i], signum);
+        else
+            (void) kill (pids[i], signum);
+    }
+}
+
+/*  Reap child 'index' if it has exited, calling 'cb' with its status.
+ *   Returns 1 if the child was reaped, 0 if not.
+ */
+static int reap_child (pid_t *pids,
+                       int *pidfds,
+                       int index,
+                       imp_exec_exit_f cb,
+                       void *arg)
+{
+    int status;
+    pid_t pid = pids[index];
+
+    if (pid <= 0 || waitpid (pid, &status, WNOHANG) != pid)
+        return 0;
+    if (pidfds[index] >= 0) {
+        close (pidfds[index]);
+        pidfds[index] = -1;
+    }
+    pids[index] = (pid_t) -1;
+    (*cb) (index, pid, status, arg);
+    return 1;
+}
+
+/*  Supervise children 'pids' (entries <= 0 are ignored) until all have
+ *   exited.  Signals in forward_signals received by the IMP are forwarded
+ *   to the children, and 'cb' is called as each child exits.
+ *
+ *  All signals must be blocked.  Rather than run handlers, this polls a
+ *   signalfd(2) for forwarded signals and a pidfd(2) per child, which
+ *   becomes readable when the child exits.  If pidfds are not supported,
+ *   SIGCHLD is used to detect child exit instead.
  */
-static void setup_signal_forwarding (void)
+static void imp_exec_supervise (pid_t *pids,
+                                int n,
+                                imp_exec_exit_f cb,
+                                void *arg)
 {
-    struct sigaction sa;
+    struct pollfd *pfd;
+    int *pidfds;
     sigset_t mask;
+    int running = 0;
     int i;
-    int signals[] = {
-        SIGTERM,
-        SIGINT,
-        SIGHUP,
-        SIGCONT,
-        SIGALRM,
-        SIGWINCH,
-        SIGTTIN,
-        SIGTTOU,
-    };
-    int nsignals =  sizeof (signals) / sizeof (signals[0]);
-
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = fwd_signal;
-    sa.sa_flags = SA_RESTART;
-    sigemptyset(&sa.sa_mask);
 
-    sigfillset (&mask);
-    for (i = 0; i < nsignals; i++) {
-        sigdelset (&mask, signals[i]);
-        if (sigaction(signals[i], &sa, NULL) < 0)
-            imp_warn ("sigaction (signal=%d): %s",
-                      signals[i],
+    if (!(pfd = calloc (n + 1, sizeof (*pfd)))
+        || !(pidfds = calloc (n, sizeof (*pidfds))))
+        imp_die (1, "exec: out of memory");
+
+    sigemptyset (&mask);
+    sigaddset (&mask, SIGCHLD);
+    for (i = 0; i < nforward_signals; i++)
+        sigaddset (&mask, forward_signals[i]);
+    if ((pfd[0].fd = signalfd (-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0)
+        imp_die (1, "exec: signalfd: %s", strerror (errno));
+    pfd[0].events = POLLIN;
+
+    for (i = 0; i < n; i++) {
+        pidfds[i] = -1;
+        if (pids[i] <= 0)
+            continue;
+        if ((pidfds[i] = imp_pidfd_open (pids[i])) < 0 && errno != ENOSYS)
+            imp_die (1, "exec: pidfd_open: %s", strerror (errno));
+        pfd[i + 1].fd = pidfds[i];
+        pfd[i + 1].events = POLLIN;
+        running++;
+    }
+
+    while (running > 0) {
+        if (poll (pfd, n + 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            imp_die (1, "exec: poll: %s", strerror (errno));
+        }
+        if (pfd[0].revents) {
+            struct signalfd_siginfo si;
+
+            while (read (pfd[0].fd, &si, sizeof (si)) == sizeof (si)) {
+                if (si.ssi_signo != SIGCHLD) {
+                    forward_signal (pids, pidfds, n, si.ssi_signo);
+                    continue;
+                }
+                /*  Children without a pidfd are only reaped here */
+                for (i = 0; i < n; i++) {
+                    if (pidfds[i] < 0)
+                        running -= reap_child (pids, pidfds, i, cb, arg);
+                }
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (pfd[i + 1].fd < 0 || !pfd[i + 1].revents)
+                continue;
+            pfd[i + 1].fd = -1;
+            if (reap_child (pids, pidfds, i, cb, arg)) {
+                running--;
+                continue;
+            }
+            /*  The pidfd may be readable before the child can be reaped,
+             *   e.g. when the thread group leader exits before its other
+             *   threads.  Fall back to SIGCHLD for this child.
+             */
+            close (pidfds[i]);
+            pidfds[i] = -1;
+        }
+    }
+    close (pfd[0].fd);
+    free (pidfds);
+    free (pfd);
+}
+
+/*  Read VmRSS and RssAnon from /proc/self/status in KiB.  Either is
+ *   set to -1 if not found.
+ */
+static void status_rss (long *rss, long *anon)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t size = 0;
+
+    *rss = *anon = -1;
+    if (!(fp = fopen ("/proc/self/status", "r")))
+        return;
+    while (getline (&line, &size, fp) >= 0) {
+        if (sscanf (line, "VmRSS: %ld", rss) < 1)
+            (void) sscanf (line, "RssAnon: %ld", anon);
+    }
+    free (line);
+    fclose (fp);
+}
+
+/*  Release all state which is no longer needed once the job shells have
+ *   been started: the IMP configuration, security context, decoded input
+ *   and the privsep kv 'kv' and handle.  The parent IMP then stays small
+ *   for the lifetime of the job, holding only what is needed to forward
+ *   signals, finish PAM sessions and report exit status.
+ *
+ *  The caller's 'kv' may be destroyed here because imp_exec_privileged()
+ *   does not return.
+ */
+static void imp_exec_release (struct imp_exec *exec, struct kv *kv)
+{
+    struct imp_state *imp = exec->imp;
+    bool debug = imp_log_enabled (IMP_LOG_DEBUG);
+    long rss, anon, rss_after, anon_after;
+    int i;
+
+    /*  Only measure when the result will be logged */
+    if (debug)
+        status_rss (&rss, &anon);
+
+    for (i = 0; i < exec->njobs; i++) {
+        struct imp_exec_job *job = &exec->jobs[i];
+        kv_destroy (job->kv);
+        kv_destroy (job->args);
+        if (job->cgroup_fd >= 0)
+            close (job->cgroup_fd);
+        job->kv = job->args = NULL;
+        job->J = job->shell = job->cgroup = NULL;
+        job->cgroup_fd = -1;
+    }
+    kv_destroy (exec->args);
+    if (exec->cgroup_fd >= 0)
+        close (exec->cgroup_fd);
+    exec->args = NULL;
+    exec->J = exec->shell = exec->cgroup = NULL;
+    exec->cgroup_fd = -1;
+    exec->spec = NULL;
+
+    if (exec->sec == imp->sec)
+        imp->sec = NULL;
+    flux_security_destroy (exec->sec);
+    exec->sec = NULL;
+    json_decref (exec->input);
+    exec->input = NULL;
+    passwd_destroy (exec->imp_pwd);
+    exec->imp_pwd = NULL;
+
+    kv_destroy (kv);
+    privsep_destroy (imp->ps);
+    imp->ps = NULL;
+
+    exec->conf = NULL;
+    cf_set_destroy (imp->exec_users);
+    cf_set_destroy (imp->exec_shells);
+    if (imp->run_env)
+        hash_destroy (imp->run_env);
+    cf_destroy (imp->conf);
+    imp->exec_users = imp->exec_shells = NULL;
+    imp->run_env = NULL;
+    imp->conf = NULL;
+
+#if HAVE_MALLOC_TRIM
+    /*  Return freed heap to the system */
+    (void) malloc_trim (0);
+#endif
+    /*  Most of VmRSS is shared library text, so also log RssAnon, which
+     *   is where the freed heap shows up.
+     */
+    if (debug) {
+        status_rss (&rss_after, &anon_after);
+        imp_debug ("exec: released state after launch: "
+                   "VmRSS %ld kB -> %ld kB, RssAnon %ld kB -> %ld kB",
+                   rss,
+                   rss_after,
+                   anon,
+                   anon_after);
+    }
+}
+
+/*  Open the cgroup in which to start a job shell: the 'requested'
+ *   cgroup, which must be owned by the IMP user, or else exec.cgroup
+ *   from the configuration.  Returns -1 if neither is set.
+ */
+static int imp_exec_cgroup_open (struct imp_exec *exec, const char *requested)
+{
+    const cf_t *cf;
+    int fd;
+
+    if (requested) {
+        if ((fd = cgroup_open (requested, getuid ())) < 0)
+            imp_die (1, "exec: cgroup %s: %s", requested, strerror (errno));
+        return fd;
+    }
+    if (!(cf = cf_get_in (exec->conf, "cgroup")))
+        return -1;
+    if (cf_typeof (cf) != CF_STRING)
+        imp_die (1, "exec: exec.cgroup must be a string");
+    if ((fd = cgroup_open (cf_string (cf), (uid_t) -1)) < 0)
+        imp_die (1, "exec: cgroup %s: %s", cf_string (cf), strerror (errno));
+    return fd;
+}
+
+/*  Fork job shell 'shell' with 'args' as 'userid', in the cgroup open
+ *   on 'cgroup_fd' if >= 0.  If 'env' is non-NULL, it replaces the
+ *   environment once the child has switched to 'userid'.
+ *  Returns pid of child in the parent, or -1 on failure.
+ */
+static pid_t imp_exec_fork (uid_t userid,
+                            const char *shell,
+                            struct kv *args,
+                            int cgroup_fd,
+                            char **env)
+{
+    pid_t pid;
+
+    if ((pid = cgroup_fork (cgroup_fd)) < 0)
+        return -1;
+
+    if (pid == 0) {
+
+        /* unblock all signals */
+        sigunblock_all ();
+
+        /* Irreversibly switch to user */
+        imp_switch_user (userid);
+
+        if (env)
+            environ = env;
+
+        /* execute shell (NORETURN) */
+        imp_exec (shell, args);
+    }
+    return pid;
+}
+
+static void single_exited (int index __attribute__ ((unused)),
+                           pid_t pid __attribute__ ((unused)),
+                           int status,
+                           void *arg)
+{
+    *(int *) arg = status;
+}
+
+/*  Exit status reporting for a multi-exec request
+ */
+struct multi_report {
+    const pid_t *shell_pids;    /* reported pid of each job shell */
+    int rc;
+};
+
+/*  Report the exit of job 'index' of a multi-exec request.  'pid' may
+ *   be that of a supervisor, so the pid of the job shell is reported.
+ */
+static void multi_exited (int index,
+                          pid_t pid __attribute__ ((unused)),
+                          int status,
+                          void *arg)
+{
+    struct multi_report *report = arg;
+
+    if (exit_code (status) != 0)
+        report->rc = 1;
+    printf ("{\"index\":%d,\"pid\":%jd,\"status\":%d}\n",
+            index,
+            (intmax_t) report->shell_pids[index],
+            exit_code (status));
+    fflush (stdout);
+}
+
+#if HAVE_PAM
+/*  Start the shell of 'job' from a supervisor process which opens the
+ *   PAM session of the job.  Modules such as pam_limits and pam_systemd
+ *   act on the calling process, so each session is opened in a process
+ *   of its own and the shell inherits the effects of its own session
+ *   only.  The supervisor forwards signals to the shell, finishes the
+ *   session once the shell exits, then exits with the shell's exit code.
+ *
+ *  Returns the pid of the supervisor and sets job->pid to the pid of
+ *   the shell, which the supervisor sends over a pipe.  Returns -1 if
+ *   the PAM stack fails or the shell could not be started.
+ */
+static pid_t imp_exec_job_fork_pam (struct imp_exec_job *job,
+                                    int index,
+                                    char **env)
+{
+    int pfd[2];
+    pid_t pid;
+    ssize_t n;
+    int status;
+
+    if (pipe2 (pfd, O_CLOEXEC) < 0) {
+        imp_warn ("exec: pipe job %d: %s", index, strerror (errno));
+        return -1;
+    }
+    if ((pid = fork ()) < 0) {
+        imp_warn ("exec: fork job %d: %s", index, strerror (errno));
+        close (pfd[0]);
+        close (pfd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        struct passwd *user_pwd;
+        pam_handle_t *pam_h;
+        pid_t child;
+
+        close (pfd[0]);
+        if (!(user_pwd = passwd_from_uid (job->userid))
+            || !(pam_h = pam_setup (user_pwd->pw_name)))
+            imp_die (1, "exec: PAM stack failure");
+        passwd_destroy (user_pwd);
+
+        if ((child = imp_exec_fork (job->userid,
+                                    job->shell,
+                                    job->args,
+                                    job->cgroup_fd,
+                                    env)) < 0) {
+            pam_finish (pam_h);
+            imp_die (1, "exec: fork: %s", strerror (errno));
+        }
+        if (write (pfd[1], &child, sizeof (child)) != sizeof (child))
+            imp_warn ("exec: failed to report job shell pid: %s",
                       strerror (errno));
+        close (pfd[1]);
+
+        imp_exec_supervise (&child, 1, single_exited, &status);
+        pam_finish (pam_h);
+        exit (exit_code (status));
     }
-    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
-       imp_die (1, "failed to block signals: %s", strerror (errno));
+    close (pfd[1]);
+    while ((n = read (pfd[0], &job->pid, sizeof (job->pid))) < 0
+           && errno == EINTR)
+        ;
+    close (pfd[0]);
+    if (n != sizeof (job->pid)) {
+        /*  The supervisor has logged the reason */
+        imp_warn ("exec: failed to start job %d", index);
+        (void) waitpid (pid, &status, 0);
+        job->pid = (pid_t) -1;
+        return -1;
+    }
+    return pid;
 }
+#endif /* HAVE_PAM */
 
-static void sigblock_all (void)
+/*  Start the shell of job 'index', from a supervisor process if
+ *   'use_pam' is true.  Returns the pid of the process to supervise,
+ *   with the pid of the shell in job->pid, or -1 on failure.
+ */
+static pid_t imp_exec_job_start (struct imp_exec *exec,
+                                 int index,
+                                 bool use_pam __attribute__ ((unused)))
 {
-    sigset_t mask;
-    sigfillset (&mask);
-    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
-        imp_die (1, "failed to block signals: %s", strerror (errno));
+    struct imp_exec_job *job = &exec->jobs[index];
+
+#if HAVE_PAM
+    if (use_pam)
+        return imp_exec_job_fork_pam (job, index, exec->imp->client_env);
+#endif /* HAVE_PAM */
+    if ((job->pid = imp_exec_fork (job->userid,
+                                   job->shell,
+                                   job->args,
+                                   job->cgroup_fd,
+                                   exec->imp->client_env)) < 0)
+        imp_warn ("exec: fork job %d: %s", index, strerror (errno));
+    return job->pid;
 }
 
-static void sigunblock_all (void)
+/*  Launch and supervise all job shells of a multi-exec request,
+ *   reporting the exit status of each on stdout.
+ */
+static void __attribute__((noreturn))
+imp_exec_multi_privileged (struct imp_exec *exec, struct kv *kv)
 {
-    sigset_t mask;
-    sigemptyset (&mask);
-    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
-        imp_die (1, "failed to unblock signals: %s", strerror (errno));
+    struct imp_state *imp = exec->imp;
+    struct multi_report report = { .rc = 0 };
+    int64_t count;
+    pid_t *pids;
+    pid_t *shell_pids;
+    bool use_pam = false;
+    int i;
+
+    if (kv_get (kv, "multi", KV_INT64, &count) < 0)
+        imp_die (1, "exec: Failed to get number of jobs");
+    imp_exec_jobs_create (exec, count);
+
+    /* Verify every job before starting any */
+    for (i = 0; i < exec->njobs; i++) {
+        imp_exec_job_init_kv (exec, kv, i);
+
+        /* Paranoia checks
+         */
+        if (exec->jobs[i].userid == 0)
+            imp_die (1, "exec: switching to user root not supported");
+        if (!imp_exec_shell_allowed (exec, exec->jobs[i].shell))
+            imp_die (1, "exec: shell not in allowed-shells list");
+
+        exec->jobs[i].cgroup_fd = imp_exec_cgroup_open (exec,
+                                                        exec->jobs[i].cgroup);
+    }
+
+    /* Ensure child exited with nonzero status */
+    if (privsep_wait (imp->ps) < 0)
+        exit (1);
+
+#if HAVE_PAM
+    /* Each job's PAM session is opened by its own supervisor process */
+    use_pam = imp_supports_pam (exec);
+#endif /* HAVE_PAM */
+
+    if (!(pids = calloc (exec->njobs, sizeof (pids[0])))
+        || !(shell_pids = calloc (exec->njobs, sizeof (shell_pids[0]))))
+        imp_die (1, "exec: out of memory");
+
+    /* Block signals so parent IMP isn't unduly terminated */
+    sigblock_all ();
+
+    for (i = 0; i < exec->njobs; i++) {
+        if ((pids[i] = imp_exec_job_start (exec, i, use_pam)) < 0)
+            report.rc = 1;
+        shell_pids[i] = exec->jobs[i].pid;
+    }
+
+    imp_exec_release (exec, kv);
+
+    /* Parent: forward signals to the children (or their supervisors)
+     *  and wait for all to exit
+     */
+    report.shell_pids = shell_pids;
+    imp_exec_supervise (pids, exec->njobs, multi_exited, &report);
+    free (pids);
+    free (shell_pids);
+
+    exit (report.rc);
 }
 
 int imp_exec_privileged (struct imp_state *imp, struct kv *kv)
 {
     int status;
+    pid_t child;
+#if HAVE_PAM
+    pam_handle_t *pam_h = NULL;
+#endif
     struct imp_exec *exec = imp_exec_create (imp);
     if (!exec)
         imp_die (1, "exec: failed to initialize state");
@@ -287,6 +945,9 @@ int imp_exec_privileged (struct imp_state *imp, struct kv *kv)
         imp_die (1, "exec: user %s not in allowed-users list",
                     exec->imp_pwd->pw_name);
 
+    if (kv_get (kv, "multi", KV_INT64, NULL) == 0)
+        imp_exec_multi_privileged (exec, kv);
+
     /* Init IMP input from kv object */
     imp_exec_init_kv (exec, kv);
 
@@ -294,9 +955,11 @@ int imp_exec_privileged (struct imp_state *imp, struct kv *kv)
      */
     if (exec->userid == 0)
         imp_die (1, "exec: switching to user root not supported");
-    if (!imp_exec_shell_allowed (exec))
+    if (!imp_exec_shell_allowed (exec, exec->shell))
         imp_die (1, "exec: shell not in allowed-shells list");
 
+    exec->cgroup_fd = imp_exec_cgroup_open (exec, exec->cgroup);
+
     /* Ensure child exited with nonzero status */
     if (privsep_wait (imp->ps) < 0)
         exit (1);
@@ -305,7 +968,7 @@ int imp_exec_privileged (struct imp_state *imp, struct kv *kv)
     /* Call privileged IMP plugins/containment */
     if (imp_supports_pam (exec)) {
         struct passwd *user_pwd = passwd_from_uid (exec->userid);
-        if (pam_setup (user_pwd->pw_name) < 0)
+        if (!(pam_h = pam_setup (user_pwd->pw_name)))
             imp_die (1, "exec: PAM stack failure");
     }
 #endif /* HAVE_PAM */
@@ -313,60 +976,74 @@ int imp_exec_privileged (struct imp_state *imp, struct kv *kv)
     /* Block signals so parent IMP isn't unduly terminated */
     sigblock_all ();
 
-    if ((imp_child = fork ()) < 0)
+    if ((child = imp_exec_fork (exec->userid,
+                                exec->shell,
+                                exec->args,
+                                exec->cgroup_fd,
+                                exec->imp->client_env)) < 0)
         imp_die (1, "exec: fork: %s", strerror (errno));
 
-    if (imp_child == 0) {
-
-        /* unblock all signals */
-        sigunblock_all ();
+    imp_exec_release (exec, kv);
 
-        /* Irreversibly switch to user */
-        imp_switch_user (exec->userid);
-
-        /* execute shell (NORETURN) */
-        imp_exec (exec);
-    }
-
-    /* Ensure common signals received by this IMP are forwarded to
-     *  the child process
+    /* Parent: forward signals to the child and wait for it to exit
      */
-    setup_signal_forwarding ();
-
-    /* Parent: wait for child to exit */
-    while (waitpid (imp_child, &status, 0) != imp_child) {
-        if (errno != EINTR)
-            imp_die (1, "waitpid: %s", strerror (errno));
-    }
+    imp_exec_supervise (&child, 1, single_exited, &status);
 
 #if HAVE_PAM
     /* Call privliged IMP plugins/containment finalization */
-    if (imp_supports_pam (exec))
-        pam_finish ();
+    pam_finish (pam_h);
 #endif /* HAVE_PAM */
 
     /* Exit with status of the child process */
-    if (WIFEXITED (status))
-        exit (WEXITSTATUS (status));
-    else if (WIFSIGNALED (status))
-        exit (WTERMSIG (status) + 128);
-    else
-        exit (1);
+    exit (exit_code (status));
 
     return (-1);
 }
 
+/* Put all jobs of a multi-exec request into kv struct `kv`
+ */
+static void imp_exec_put_kv_multi (struct imp_exec *exec, struct kv *kv)
+{
+    char key[64];
+    int i;
+
+    if (kv_put (kv, "multi", KV_INT64, (int64_t) exec->njobs) < 0)
+        imp_die (1, "exec: Failed to set number of jobs");
+    for (i = 0; i < exec->njobs; i++) {
+        struct imp_exec_job *job = &exec->jobs[i];
+
+        snprintf (key, sizeof (key), "%d.J", i);
+        if (kv_put (kv, key, KV_STRING, job->J) < 0)
+            imp_die (1, "exec: Error encoding J");
+        snprintf (key, sizeof (key), "%d.shell_path", i);
+        if (kv_put (kv, key, KV_STRING, job->shell) < 0)
+            imp_die (1, "exec: Failed to set job shell path");
+        snprintf (key, sizeof (key), "%d.args", i);
+        if (kv_join (kv, job->args, key) < 0)
+            imp_die (1, "exec: Failed to set job shell arguments");
+        snprintf (key, sizeof (key), "%d.cgroup", i);
+        if (job->cgroup && kv_put (kv, key, KV_STRING, job->cgroup) < 0)
+            imp_die (1, "exec: Failed to set job cgroup");
+    }
+}
+
 /* Put all data from imp_exec into kv struct `kv`
  */
 static void imp_exec_put_kv (struct imp_exec *exec,
                                    struct kv *kv)
 {
+    if (exec->jobs) {
+        imp_exec_put_kv_multi (exec, kv);
+        return;
+    }
     if (kv_put (kv, "J", KV_STRING, exec->J) < 0)
         imp_die (1, "exec: Error decoding J");
     if (kv_put (kv, "shell_path", KV_STRING, exec->shell) < 0)
         imp_die (1, "exec: Failed to get job shell path");
     if (kv_join (kv, exec->args, "args") < 0)
         imp_die (1, "exec: Failed to set job shell arguments");
+    if (exec->cgroup && kv_put (kv, "cgroup", KV_STRING, exec->cgroup) < 0)
+        imp_die (1, "exec: Failed to set job cgroup");
 }
 
 int imp_exec_unprivileged (struct imp_state *imp, struct kv *kv)
@@ -387,8 +1064,14 @@ int imp_exec_unprivileged (struct imp_state *imp, struct kv *kv)
     //   imp_die (1, "exec: failed to parse jobspec: %s", err.text);
 
     if (imp->ps) {
-        if (!imp_exec_shell_allowed (exec))
+        int i;
+
+        if (!exec->jobs && !imp_exec_shell_allowed (exec, exec->shell))
             imp_die (1, "exec: shell not in allowed-shells");
+        for (i = 0; i < exec->njobs; i++) {
+            if (!imp_exec_shell_allowed (exec, exec->jobs[i].shell))
+                imp_die (1, "exec: shell not in allowed-shells");
+        }
 
         /* In privsep mode, write kv to privileged parent and exit */
         imp_exec_put_kv (exec, kv);
@@ -401,13 +1084,18 @@ int imp_exec_unprivileged (struct imp_state *imp, struct kv *kv)
 
     if (!imp_exec_unprivileged_allowed (exec))
         imp_die (1, "exec: IMP not installed setuid, operation disabled.");
+    if (exec->jobs)
+        imp_die (1, "exec: multiple jobs require a setuid IMP");
 
     /* Unprivileged exec allowed. Issue warning and process input for
      *  testing purposes.
      */
     imp_warn ("Running without privilege, userid switching not available");
+    if (exec->cgroup)
+        imp_warn ("Running without privilege, ignoring cgroup %s",
+                  exec->cgroup);
 
-    imp_exec (exec);
+    imp_exec (exec->shell, exec->args);
 
     /* imp_exec() does not return */
     return -1;
@@ -18,11 +18,10 @@
 #include <security/pam_appl.h>
 #include <security/pam_misc.h>
 
-static pam_handle_t *pam_h = NULL;
-
-int pam_setup (const char *user)
+pam_handle_t *pam_setup (const char *user)
 {
     struct pam_conv conv = {misc_conv, NULL};
+    pam_handle_t *pam_h = NULL;
     int rc;
 
     if ((rc = pam_start ("flux",
@@ -48,7 +47,7 @@ int pam_setup (const char *user)
         imp_warn ("pam_open_session: %s", pam_strerror (pam_h, rc));
         goto fail3;
     }
-    return 0;
+    return pam_h;
 
 fail3:
     pam_setcred (pam_h, PAM_DELETE_CRED);
@@ -57,11 +56,10 @@ fail2:
     pam_end (pam_h, rc);
 
 fail1:
-    pam_h = NULL;
-    return rc == PAM_SUCCESS ? 0 : -1;
+    return NULL;
 }
 
-void pam_finish ()
+void pam_finish (pam_handle_t *pam_h)
 {
     int rc = 0;
     if (pam_h != NULL) {
@@ -74,7 +72,6 @@ void pam_finish ()
         if ((rc = pam_end (pam_h, rc)) != PAM_SUCCESS) {
             imp_warn ("pam_end: %s", pam_strerror (pam_h, rc));
         }
-        pam_h = NULL;
     }
 }
 
@@ -11,8 +11,15 @@
 #ifndef HAVE_IMP_PAM_H_
 #define HAVE_IMP_PAM_H_ 1
 
-int pam_setup (const char *user);
+#include <security/pam_appl.h>
 
-void pam_finish ();
+/*  Open a session for 'user' with the "flux" PAM stack.
+ *  Returns a handle for pam_finish(), or NULL on failure.
+ */
+pam_handle_t *pam_setup (const char *user);
+
+/*  Close session opened by pam_setup(), if non-NULL.
+ */
+void pam_finish (pam_handle_t *pam_h);
 
 #endif  // HAVE_IMP_PAM_H_
@@ -21,6 +21,7 @@
 #include <grp.h>
 
 #include "imp_log.h"
+#include "passwd.h"
 
 /*
  *  Switch process to new UID/GID with supplementary group initialization
@@ -29,19 +30,17 @@
 void imp_switch_user (uid_t uid)
 {
     gid_t gid = -1;
-    const char *user = NULL;
 
-    struct passwd *pwd = getpwuid (uid);
+    const struct passwd *pwd = passwd_lookup (uid);
     if (!pwd)
         imp_die (1, "lookup userid=%ld failed: %s",
                      (long) uid,
                      strerror (errno));
 
-    user = pwd->pw_name;
     gid = pwd->pw_gid;
 
     /*  Intialize groups from /etc/group */
-    if (initgroups (user, gid) < 0)
+    if (passwd_initgroups (pwd, gid) < 0)
         imp_die (1, "initgroups");
 
     /*  Set saved, effective, and real gids/uids */
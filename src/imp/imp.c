@@ -23,12 +23,15 @@
 #include "imp_log.h"
 #include "impcmd.h"
 #include "sudosim.h"
+#include "server.h"
 
 /*
  *  External function used to return current default config pattern.
  */
 extern const char *imp_get_config_pattern (void);
 
+extern char **environ;
+
 /*  External function used to initialize imp config object */
 extern int imp_conf_init (cf_t *cf, struct cf_error *error);
 
@@ -37,12 +40,14 @@ extern int imp_conf_init (cf_t *cf, struct cf_error *error);
 static void initialize_logging ();
 static int  imp_state_init (struct imp_state *imp, int argc, char **argv);
 static cf_t * imp_conf_load (const char *pattern);
+static int  imp_policy_compile (struct imp_state *imp);
 static bool imp_is_privileged ();
 static bool imp_is_setuid ();
 static void initialize_sudo_support ();
 
 static void imp_child (privsep_t *ps, void *arg);
 static void imp_parent (struct imp_state *imp);
+static int  imp_privsep_run (struct imp_state *imp);
 
 int main (int argc, char *argv[])
 {
@@ -54,10 +59,22 @@ int main (int argc, char *argv[])
     if (imp_state_init (&imp, argc, argv) < 0)
         imp_die (1, "Initialization error");
 
+    /*  Forward to a server if one is listening.  This is done before
+     *   configuration is loaded, since the server has already done so.
+     */
+    imp_server_forward (&imp);
+
     /*  Configuration:
      */
     if (!(imp.conf = imp_conf_load (imp_get_config_pattern ())))
         imp_die (1, "Failed to load configuration");
+    if (imp_policy_compile (&imp) < 0)
+        imp_die (1, "Failed to compile configured allow-lists");
+
+    /*  Persistent server mode
+     */
+    if (imp.argc > 1 && strcmp (imp.argv[1], "server") == 0)
+        imp_server (&imp, imp_privsep_run);
 
     /*  Audit subsystem initialization
      */
@@ -73,17 +90,7 @@ int main (int argc, char *argv[])
         if (!imp_is_setuid ())
             imp_die (1, "Refusing to run as root");
 
-        /*  Initialize privilege separation (required for now)
-         */
-        if (!(imp.ps = privsep_init (imp_child, &imp)))
-            imp_die (1, "Privilege separation initialization failed");
-
-        imp_parent (&imp);
-
-        /*  Wait for child to exit. Exit with failure if child did so.
-         */
-        if (privsep_wait (imp.ps) < 0)
-            exit_code = 1;
+        exit_code = imp_privsep_run (&imp);
     }
     else {
         /*  Not running with privilege, run child half of function only */
@@ -91,6 +98,10 @@ int main (int argc, char *argv[])
     }
 
     privsep_destroy (imp.ps);
+    cf_set_destroy (imp.exec_users);
+    cf_set_destroy (imp.exec_shells);
+    if (imp.run_env)
+        hash_destroy (imp.run_env);
     cf_destroy (imp.conf);
     imp_closelog ();
     exit (exit_code);
@@ -123,6 +134,61 @@ static int imp_state_init (struct imp_state *imp, int argc, char *argv[])
     return (0);
 }
 
+/*  Compile an allow-list from 'key' in table 'cf'.  As with
+ *   cf_array_contains(), a missing or non-array value allows nothing.
+ */
+static struct cf_set *allow_list_compile (const cf_t *cf, const char *key)
+{
+    const cf_t *list = cf_get_in (cf, key);
+
+    if (list && cf_typeof (list) != CF_ARRAY)
+        list = NULL;
+    return cf_set_create (list, 0);
+}
+
+/*  Compile the allowed-environment patterns of [run.NAME] table 'cf'
+ *   and add them to the run_env hash under 'name'.
+ */
+static int run_env_compile (const char *name, const cf_t *cf, void *arg)
+{
+    hash_t run_env = arg;
+    const cf_t *allowed_env = cf_get_in (cf, "allowed-environment");
+    struct cf_set *filter;
+
+    if (cf_typeof (cf) != CF_TABLE)
+        return 0;
+    /*  As with cf_array_contains_match(), a non-array allows nothing */
+    if (allowed_env && cf_typeof (allowed_env) != CF_ARRAY)
+        allowed_env = NULL;
+    if (!(filter = cf_set_create (allowed_env, CF_SET_MATCH)))
+        return -1;
+    if (!hash_insert (run_env, name, filter)) {
+        cf_set_destroy (filter);
+        return -1;
+    }
+    return 0;
+}
+
+/*  Compile exec allow-lists and run environment filters once so that
+ *   policy checks are simple hash lookups.
+ */
+static int imp_policy_compile (struct imp_state *imp)
+{
+    const cf_t *exec = cf_get_in (imp->conf, "exec");
+    const cf_t *run = cf_get_in (imp->conf, "run");
+
+    if (!(imp->exec_users = allow_list_compile (exec, "allowed-users"))
+        || !(imp->exec_shells = allow_list_compile (exec, "allowed-shells")))
+        return -1;
+    if (!(imp->run_env = hash_create (0,
+                                      (hash_key_f)hash_key_string,
+                                      (hash_cmp_f)strcmp,
+                                      (hash_del_f)cf_set_destroy))
+        || cf_table_foreach (run, run_env_compile, imp->run_env) < 0)
+        return -1;
+    return 0;
+}
+
 /*
  *  Load IMP configuration from glob(7) `pattern`. Fatal error if configuration
  *   fails to load.
@@ -132,6 +198,8 @@ static cf_t * imp_conf_load (const char *pattern)
     int rc;
     struct cf_error err;
     cf_t *cf = NULL;
+    char cachepath[PATH_MAX + 1];
+    const char *cache = NULL;
 
     if (pattern == NULL)
         imp_die (1, "imp_conf_load: Internal error");
@@ -139,9 +207,22 @@ static cf_t * imp_conf_load (const char *pattern)
     if (!(cf = cf_create ()))
         return (NULL);
 
+    /*  When privileged, load the merged configuration from a root-owned
+     *   compiled cache.  The cache is only recompiled if the config files
+     *   have changed when run by root, not by a setuid IMP, which cannot
+     *   write the config directory on behalf of an unprivileged user.
+     */
+    if (geteuid () == 0
+        && cf_cache_path (pattern, cachepath, sizeof (cachepath)) == 0)
+        cache = cachepath;
+
     memset (&err, 0, sizeof (err));
     if (imp_conf_init (cf, &err) < 0
-        || (rc = cf_update_glob (cf, pattern, &err)) < 0) {
+        || (rc = cf_update_glob_cached (cf,
+                                        pattern,
+                                        cache,
+                                        getuid () == 0 ? CF_CACHE_UPDATE : 0,
+                                        &err)) < 0) {
         imp_warn ("loading config: %s: %d: %s",
                  err.filename, err.lineno, err.errbuf);
         cf_destroy (cf);
@@ -215,6 +296,12 @@ static void imp_child (privsep_t *ps, void *arg)
      */
     imp->ps = ps;
 
+    /*  In a server worker, privilege has now been dropped, so the
+     *   client environment may be used.
+     */
+    if (imp->client_env)
+        environ = imp->client_env;
+
     if (imp->argc <= 1)
         imp_die (1, "command required");
 
@@ -230,6 +317,25 @@ static void imp_child (privsep_t *ps, void *arg)
     kv_destroy (kv);
 }
 
+/*  Run the command in imp->argv with privilege separation.
+ *   Returns the exit code for the IMP.
+ */
+static int imp_privsep_run (struct imp_state *imp)
+{
+    /*  Initialize privilege separation (required for now)
+     */
+    if (!(imp->ps = privsep_init (imp_child, imp)))
+        imp_die (1, "Privilege separation initialization failed");
+
+    imp_parent (imp);
+
+    /*  Wait for child to exit. Exit with failure if child did so.
+     */
+    if (privsep_wait (imp->ps) < 0)
+        return (1);
+    return (0);
+}
+
 static void imp_parent (struct imp_state *imp)
 {
     struct kv * kv = privsep_read_kv (imp->ps);
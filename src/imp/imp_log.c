@@ -81,6 +81,14 @@ log_output_call (struct log_output *o, const char *x __attribute__ ((unused)),
     return (1);
 }
 
+static int
+log_output_accepts (struct log_output *o,
+                    const char *x __attribute__ ((unused)),
+                    int *level)
+{
+    return (*level <= o->level);
+}
+
 static int find_by_name (void *data __attribute__ ((unused)),
                          const char *key, const char *name)
 {
@@ -167,6 +175,14 @@ int imp_log_set_level (const char *name, int level)
     return (0);
 }
 
+int imp_log_enabled (int level)
+{
+    if (imp_logger.level < level)
+        return (0);
+    return (hash_for_each (imp_logger.outputs,
+                           (hash_arg_f) log_output_accepts,
+                           &level) > 0);
+}
 
 /*
  *   Logging interface functions
@@ -59,6 +59,13 @@ int imp_log_remove (char *name);
  */
 int imp_log_set_level (const char *name, int level);
 
+/*
+ *  Return nonzero if a message issued at `level` would be passed to at
+ *   least one log provider, so callers can skip work that is only needed
+ *   to build a message that would be discarded.
+ */
+int imp_log_enabled (int level);
+
 /*
  *  Logging types passed to output provider.
  */
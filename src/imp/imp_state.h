@@ -12,6 +12,8 @@
 #define HAVE_IMP_STATE_H 1
 
 #include "src/libutil/cf.h"
+#include "src/libutil/hash.h"
+#include "src/lib/context.h"
 #include "privsep.h"
 
 struct imp_state {
@@ -19,6 +21,20 @@ struct imp_state {
     char     **argv;        /* cmdline arguments from main() */
     cf_t      *conf;        /* IMP configuration */
     privsep_t *ps;          /* Privilege separation handle */
+
+    /*  Allow-lists compiled from conf at load time */
+    struct cf_set *exec_users;  /* exec.allowed-users */
+    struct cf_set *exec_shells; /* exec.allowed-shells */
+    hash_t run_env;             /* run.NAME -> run.NAME.allowed-environment */
+
+    /*  Security context shared by requests in 'flux-imp server' */
+    flux_security_t *sec;
+
+    /*  Environment of the client of a 'flux-imp server' worker, which
+     *   is only adopted by processes that have dropped privilege.
+     *   NULL when not running in a server worker.
+     */
+    char **client_env;
 };
 
 #endif /* !HAVE_IMP_STATE_H */
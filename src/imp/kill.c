@@ -30,6 +30,15 @@
  *  to launch multi-user jobs, since the systemd instance spawning jobs
  *  will also be running under a delegated cgroup.
  *
+ *  With --cgroup, every process in the cgroup containing the target
+ *  process, including its descendant cgroups, is signaled instead. This
+ *  requires that the cgroup itself is owned by the requesting user, and
+ *  that it does not contain the IMP.
+ *
+ *  Multiple pids may be given to signal them all from a single IMP,
+ *  which avoids a separate IMP and privsep setup per pid when many
+ *  processes are signaled at once, e.g. on job cancellation.
+ *
  */
 
 #if HAVE_CONFIG_H
@@ -44,6 +53,8 @@
 #include <errno.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
 
 #include <pwd.h>
 #include <signal.h>
@@ -56,128 +67,334 @@
 #include "impcmd.h"
 #include "privsep.h"
 #include "pidinfo.h"
+#include "passwd.h"
+#include "cgroup.h"
+#include "pidfd.h"
 
 /*  Return true if the user executing the IMP is allowed to run
  *   'flux-imp kill'. This is the same set of users allowed to run
  *   'flux-imp exec', so look in exec.allowed-users.
  */
-static bool imp_kill_allowed (const cf_t *conf)
+static bool imp_kill_allowed (struct imp_state *imp)
 {
-    struct passwd * pwd = getpwuid (getuid ());
-    const cf_t *exec = cf_get_in (conf, "exec");
+    const struct passwd *pwd = passwd_lookup (getuid ());
 
-    if (pwd && exec)
-        return cf_array_contains (cf_get_in (exec, "allowed-users"),
-                                  pwd->pw_name);
+    if (pwd)
+        return cf_set_contains (imp->exec_users, pwd->pw_name);
     return false;
 }
 
-static void check_and_kill_process (struct imp_state *imp, pid_t pid, int sig)
+/*  Return true if the cgroup at 'path' is or contains the cgroup of
+ *   this process.
+ */
+static bool cgroup_contains_self (const char *path)
+{
+    struct pid_info *self;
+    size_t len = strlen (path);
+    bool result;
+
+    if (!(self = pid_info_create (getpid ())))
+        imp_die (1, "kill: failed to get own pid info: %s", strerror (errno));
+    result = strncmp (self->cg_path, path, len) == 0
+             && (self->cg_path[len] == '\0' || self->cg_path[len] == '/');
+    pid_info_destroy (self);
+    return result;
+}
+
+/*  Error text for a single failed pid, reported by the caller
+ */
+struct kill_error {
+    char text[256];
+};
+
+static int __attribute__ ((format (printf, 2, 3)))
+kill_errorf (struct kill_error *e, const char *fmt, ...)
+{
+    va_list ap;
+    va_start (ap, fmt);
+    vsnprintf (e->text, sizeof (e->text), fmt, ap);
+    va_end (ap);
+    return -1;
+}
+
+/*  Signal every process in the cgroup of 'p' on behalf of 'user'
+ */
+static int check_and_kill_cgroup (struct pid_info *p,
+                                  uid_t user,
+                                  int sig,
+                                  struct kill_error *e)
+{
+    if (p->cg_owner != user)
+        return kill_errorf (e,
+            "kill: refusing request from uid=%ju to kill cgroup %s (owner=%ju)",
+            (uintmax_t) user,
+            p->cg_path,
+            (uintmax_t) p->cg_owner);
+    if (cgroup_contains_self (p->cg_path))
+        return kill_errorf (e,
+            "kill: refusing to kill cgroup %s containing flux-imp",
+            p->cg_path);
+    if (cgroup_kill (p->cg_path, sig) < 0)
+        return kill_errorf (e,
+                            "kill: cgroup %s sig=%ju: %s",
+                            p->cg_path,
+                            (uintmax_t) sig,
+                            strerror (errno));
+    return 0;
+}
+
+/*  Send 'sig' to 'pid' through 'pidfd' if it is valid, otherwise kill(2).
+ */
+static int send_signal (int pidfd, pid_t pid, int sig)
+{
+    if (pidfd >= 0)
+        return imp_pidfd_send_signal (pidfd, sig);
+    return kill (pid, sig);
+}
+
+/*  Validate and signal one pid.  A pidfd is opened before the target is
+ *   inspected under /proc and is checked again afterward, so the checks
+ *   and the signal apply to the same process even if the pid is reused.
+ *
+ *  When signaling multiple pids, 'snapshot' points to a process tree
+ *   snapshot, taken on first use, from which the children of all
+ *   flux-imp targets are found.
+ */
+static int check_and_kill_process (pid_t pid,
+                                   int sig,
+                                   bool cgroup,
+                                   struct pid_snapshot **snapshot,
+                                   struct kill_error *e)
 {
     uid_t user = getuid ();
     struct pid_info *p = NULL;
+    int pidfd;
+    int rc = -1;
 
-    if (!imp_kill_allowed (imp->conf))
-        imp_die (1, "kill command not allowed");
+    /*  On failure, fall back to kill(2) and let pid_info_create()
+     *   report a missing pid as before.
+     */
+    pidfd = imp_pidfd_open (pid);
 
-    if (!(p = pid_info_create ((pid_t) pid)))
-        imp_die (1, "kill: failed to initialize pid info: %s",
-                    strerror (errno));
+    if (!(p = pid_info_create ((pid_t) pid))) {
+        kill_errorf (e, "kill: failed to initialize pid info: %s",
+                     strerror (errno));
+        goto out;
+    }
+    if (pidfd >= 0 && imp_pidfd_send_signal (pidfd, 0) < 0) {
+        kill_errorf (e, "kill: %jd: %s", (intmax_t) pid, strerror (errno));
+        goto out;
+    }
     if (sig == 0) {
-        printf ("pid=%ju owner=%ju cg_path=%s cg_owner=%ju",
+        printf ("pid=%ju owner=%ju cg_path=%s cg_owner=%ju%s",
                  (uintmax_t) pid,
                  (uintmax_t) p->pid_owner,
                  p->cg_path,
-                 (uintmax_t) p->cg_owner);
-        pid_info_destroy (p);
-        return;
+                 (uintmax_t) p->cg_owner,
+                 snapshot ? "\n" : "");
+        rc = 0;
+        goto out;
+    }
+
+    if (cgroup) {
+        rc = check_and_kill_cgroup (p, user, sig, e);
+        goto out;
     }
 
     /* Check if pid is in pids cgroup owned by IMP user */
     if (p->cg_owner != user
-        && p->pid_owner != user)
-        imp_die (1,
+        && p->pid_owner != user) {
+        kill_errorf (e,
             "kill: refusing request from uid=%ju to kill pid %jd (owner=%ju)",
             (uintmax_t) user,
             (intmax_t) pid,
             (uintmax_t) p->cg_owner);
+        goto out;
+    }
 
     /*  If pid is owned by root and is a flux-imp process, then deliver
      *   signal to child process instead (presumably a job shell)
      */
     if (p->pid_owner == 0
         && strcmp (p->command, "flux-imp") == 0) {
-        int count = pid_kill_children (pid, sig);
+        int count;
+        if (!snapshot)
+            count = pid_kill_children (pid, sig);
+        else if (*snapshot || (*snapshot = pid_snapshot_create ()))
+            count = pid_snapshot_kill_children (*snapshot, pid, sig);
+        else
+            count = -1;
         if (count < 0)
-            imp_die (1,
-                     "kill: failed to signal flux-imp children: %s",
-                     strerror (errno));
+            kill_errorf (e,
+                         "kill: failed to signal flux-imp children: %s",
+                         strerror (errno));
         else if (count == 0)
-            imp_die (1, "kill: killed 0 flux-imp children");
+            kill_errorf (e, "kill: killed 0 flux-imp children");
+        else
+            rc = 0;
     }
-    else if (kill (pid, sig) < 0)
-        imp_die (1, "kill: %jd sig=%ju: %s",
-                    (intmax_t) pid,
-                    (uintmax_t) sig,
-                    strerror (errno));
-
+    else if (send_signal (pidfd, pid, sig) < 0)
+        kill_errorf (e,
+                     "kill: %jd sig=%ju: %s",
+                     (intmax_t) pid,
+                     (uintmax_t) sig,
+                     strerror (errno));
+    else
+        rc = 0;
+out:
+    if (pidfd >= 0)
+        (void) close (pidfd);
     pid_info_destroy (p);
+    return rc;
 }
 
+/*  Signal each of 'pids'.  A single pid fails as it always has.  With
+ *   multiple pids, every pid is attempted and a "pid=PID result=ok|failed"
+ *   line is written to stdout for each, with the reason for any failure
+ *   logged as a warning.  Exit with error if any pid failed.
+ */
+static void kill_pids (struct imp_state *imp,
+                       const int64_t *pids,
+                       int npids,
+                       int sig,
+                       bool cgroup)
+{
+    struct kill_error e;
+    struct pid_snapshot *snapshot = NULL;
+    int errors = 0;
+    int i;
 
-/*  Read pid and signal from the privsep pipe, then check if user
- *   is allowed to kill the target process.
+    if (!imp_kill_allowed (imp))
+        imp_die (1, "kill command not allowed");
+
+    if (npids == 1) {
+        if (check_and_kill_process (pids[0], sig, cgroup, NULL, &e) < 0)
+            imp_die (1, "%s", e.text);
+        return;
+    }
+    for (i = 0; i < npids; i++) {
+        int rc = check_and_kill_process (pids[i], sig, cgroup, &snapshot, &e);
+        if (rc < 0) {
+            imp_warn ("%s", e.text);
+            errors++;
+        }
+        printf ("pid=%jd result=%s\n",
+                (intmax_t) pids[i],
+                rc < 0 ? "failed" : "ok");
+    }
+    fflush (stdout);
+    pid_snapshot_destroy (snapshot);
+    if (errors)
+        imp_die (1, "kill: failed to signal %d of %d pids", errors, npids);
+}
+
+/*  Read pids and signal from the privsep pipe, then check if user
+ *   is allowed to kill the target processes.
  */
 int imp_kill_privileged (struct imp_state *imp, struct kv *kv)
 {
-    int64_t pid;
+    int64_t *pids;
+    int64_t npids = 1;
     int64_t signum;
+    bool cgroup = false;
+    int i;
 
-    if (kv_get (kv, "pid", KV_INT64, &pid) < 0)
-        imp_die (1, "kill: failed to get pid");
     if (kv_get (kv, "signal", KV_INT64, &signum) < 0)
         imp_die (1, "kill: failed to get signal");
+    if (kv_get (kv, "cgroup", KV_BOOL, &cgroup) < 0 && errno != ENOENT)
+        imp_die (1, "kill: failed to get cgroup flag");
+    if (kv_get (kv, "npids", KV_INT64, &npids) < 0 && errno != ENOENT)
+        imp_die (1, "kill: failed to get npids");
+    if (npids < 1 || npids > INT_MAX)
+        imp_die (1, "kill: invalid npids %jd", (intmax_t) npids);
+    if (!(pids = calloc (npids, sizeof (pids[0]))))
+        imp_die (1, "kill: out of memory");
+
+    if (npids == 1) {
+        if (kv_get (kv, "pid", KV_INT64, &pids[0]) < 0)
+            imp_die (1, "kill: failed to get pid");
+    }
+    else {
+        for (i = 0; i < npids; i++) {
+            char key[64];
+            snprintf (key, sizeof (key), "%d.pid", i);
+            if (kv_get (kv, key, KV_INT64, &pids[i]) < 0)
+                imp_die (1, "kill: failed to get %s", key);
+        }
+    }
 
-    check_and_kill_process (imp, pid, signum);
+    kill_pids (imp, pids, npids, signum, cgroup);
+    free (pids);
     return 0;
 }
 
-/*  Unprivileged process reads signal and pid from cmdline and
+/*  Unprivileged process reads signal and pids from cmdline and
  *   sends to parent over privsep pipe. If not running privileged,
  *   try killing as requesting user (used for testing).
  */
 int imp_kill_unprivileged (struct imp_state *imp, struct kv *kv)
 {
     char *p = NULL;
-    int64_t pid = 0;
+    int64_t *pids;
     int64_t signum = -1;
+    bool cgroup = false;
+    int argi = 2;
+    int npids;
+    int i;
 
-    if (imp->argc < 4)
-        imp_die (1, "kill: Usage flux-imp kill SIGNAL PID");
+    if (imp->argc > argi && strcmp (imp->argv[argi], "--cgroup") == 0) {
+        cgroup = true;
+        argi++;
+    }
+    if (imp->argc < argi + 2)
+        imp_die (1, "kill: Usage flux-imp kill [--cgroup] SIGNAL PID...");
 
     errno = 0;
-    if ((signum = strtol (imp->argv[2], &p, 10)) < 0
+    if ((signum = strtol (imp->argv[argi], &p, 10)) < 0
         || errno != 0
         || *p != '\0')
-        imp_die (1, "kill: invalid SIGNAL %s", imp->argv[2]);
+        imp_die (1, "kill: invalid SIGNAL %s", imp->argv[argi]);
+    argi++;
+
+    npids = imp->argc - argi;
+    if (!(pids = calloc (npids, sizeof (pids[0]))))
+        imp_die (1, "kill: out of memory");
 
     /*  PID of 0 is explicitly forbidden here as it could be used
      *   to inadvertenly kill our parent.
      */
-    if ((pid = strtol (imp->argv[3], &p, 10)) == 0
-        || *p != '\0')
-        imp_die (1, "kill: invalid PID %s", imp->argv[3]);
+    for (i = 0; i < npids; i++) {
+        const char *arg = imp->argv[argi + i];
+        if ((pids[i] = strtol (arg, &p, 10)) == 0
+            || *p != '\0')
+            imp_die (1, "kill: invalid PID %s", arg);
+    }
 
-    if (kv_put (kv, "pid", KV_INT64, pid) < 0)
-        imp_die (1, "kill: kv_put pid: %s", strerror (errno));
     if (kv_put (kv, "signal", KV_INT64, signum) < 0)
         imp_die (1, "kill: kv_put signum: %s", strerror (errno));
+    if (cgroup && kv_put (kv, "cgroup", KV_BOOL, true) < 0)
+        imp_die (1, "kill: kv_put cgroup: %s", strerror (errno));
+    if (npids == 1) {
+        if (kv_put (kv, "pid", KV_INT64, pids[0]) < 0)
+            imp_die (1, "kill: kv_put pid: %s", strerror (errno));
+    }
+    else {
+        if (kv_put (kv, "npids", KV_INT64, (int64_t) npids) < 0)
+            imp_die (1, "kill: kv_put npids: %s", strerror (errno));
+        for (i = 0; i < npids; i++) {
+            char key[64];
+            snprintf (key, sizeof (key), "%d.pid", i);
+            if (kv_put (kv, key, KV_INT64, pids[i]) < 0)
+                imp_die (1, "kill: kv_put %s: %s", key, strerror (errno));
+        }
+    }
 
     if (!imp->ps)
-        check_and_kill_process (imp, pid, signum);
+        kill_pids (imp, pids, npids, signum, cgroup);
     else if (privsep_write_kv (imp->ps, kv) < 0)
         imp_die (1, "kill: failed to communicate with privsep parent");
 
+    free (pids);
     return 0;
 }
 
@@ -14,10 +14,34 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <grp.h>
 
 #include "passwd.h"
 
-static struct passwd * passwd_copy (struct passwd *arg)
+/*  Cache of passwd entries and supplementary group lists, so that a
+ *   user is resolved through NSS at most once no matter how many callers
+ *   need the entry.  Failed lookups are cached too.  Entries are never
+ *   expired, so the cache must only live as long as one request: a
+ *   flux-imp command, or in 'flux-imp server' a per-request handler,
+ *   which calls passwd_cache_clear() first.  The server main loop does
+ *   not use the cache.
+ */
+struct passwd_cache_entry {
+    uid_t uid;
+    struct passwd *pwd;     /* NULL if lookup failed */
+    int errnum;             /* errno from failed lookup */
+    gid_t gid;              /* primary gid used for 'groups' */
+    gid_t *groups;          /* NULL until passwd_groups() is called */
+    int ngroups;
+};
+
+static struct passwd_cache_entry *cache = NULL;
+static int cache_count = 0;
+static int cache_size = 0;
+
+static struct passwd * passwd_copy (const struct passwd *arg)
 {
     struct passwd *pwd = calloc (1, sizeof (*pwd));
     if (pwd) {
@@ -35,14 +59,134 @@ static struct passwd * passwd_copy (struct passwd *arg)
     return pwd;
 }
 
+static struct passwd_cache_entry *cache_find (uid_t uid)
+{
+    int i;
+    for (i = 0; i < cache_count; i++) {
+        if (cache[i].uid == uid)
+            return &cache[i];
+    }
+    return NULL;
+}
+
+static struct passwd_cache_entry *cache_add (uid_t uid)
+{
+    struct passwd_cache_entry *entry;
+    struct passwd *pwd;
+
+    if (cache_count == cache_size) {
+        int newsize = cache_size ? cache_size * 2 : 8;
+        struct passwd_cache_entry *new;
+        if (!(new = realloc (cache, newsize * sizeof (*new))))
+            return NULL;
+        cache = new;
+        cache_size = newsize;
+    }
+    entry = &cache[cache_count];
+    memset (entry, 0, sizeof (*entry));
+    entry->uid = uid;
+
+    errno = 0;
+    if ((pwd = getpwuid (uid))) {
+        if (!(entry->pwd = passwd_copy (pwd)))
+            return NULL;
+    }
+    else
+        entry->errnum = errno ? errno : ENOENT;
+    cache_count++;
+    return entry;
+}
+
+const struct passwd *passwd_lookup (uid_t uid)
+{
+    struct passwd_cache_entry *entry;
+
+    if (!(entry = cache_find (uid)) && !(entry = cache_add (uid)))
+        return NULL;
+    if (!entry->pwd) {
+        errno = entry->errnum;
+        return NULL;
+    }
+    return entry->pwd;
+}
+
+int passwd_groups (const struct passwd *pwd, gid_t gid, const gid_t **groups)
+{
+    struct passwd_cache_entry *entry;
+    gid_t *list = NULL;
+    int ngroups = 64;
+
+    if (!pwd || !groups) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(entry = cache_find (pwd->pw_uid)) || entry->pwd != pwd) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (entry->groups && entry->gid == gid) {
+        *groups = entry->groups;
+        return entry->ngroups;
+    }
+
+    /*  getgrouplist(3) sets ngroups to the required size when the
+     *   list is too small, so at most two calls are needed.
+     */
+    for (;;) {
+        int n = ngroups;
+        gid_t *new;
+        if (!(new = realloc (list, n * sizeof (gid_t)))) {
+            free (list);
+            return -1;
+        }
+        list = new;
+        if (getgrouplist (pwd->pw_name, gid, list, &ngroups) >= 0)
+            break;
+        if (ngroups <= n) {
+            free (list);
+            errno = ENOENT;
+            return -1;
+        }
+    }
+    free (entry->groups);
+    entry->groups = list;
+    entry->ngroups = ngroups;
+    entry->gid = gid;
+    *groups = entry->groups;
+    return entry->ngroups;
+}
+
+int passwd_initgroups (const struct passwd *pwd, gid_t gid)
+{
+    const gid_t *groups;
+    int ngroups;
+
+    if ((ngroups = passwd_groups (pwd, gid, &groups)) < 0)
+        return -1;
+    return setgroups (ngroups, groups);
+}
+
 struct passwd * passwd_from_uid (uid_t uid)
 {
-    struct passwd *pwd = NULL;
-    if (!(pwd = getpwuid (uid)))
+    const struct passwd *pwd;
+    if (!(pwd = passwd_lookup (uid)))
         return NULL;
     return passwd_copy (pwd);
 }
 
+void passwd_cache_clear (void)
+{
+    int i;
+    for (i = 0; i < cache_count; i++) {
+        passwd_destroy (cache[i].pwd);
+        free (cache[i].groups);
+    }
+    free (cache);
+    cache = NULL;
+    cache_count = 0;
+    cache_size = 0;
+}
+
 void passwd_destroy (struct passwd *pwd)
 {
     if (pwd) {
@@ -14,6 +14,33 @@
 #include <pwd.h>
 #include <sys/types.h>
 
+/*
+ *  Return the passwd entry for UID.  NSS is consulted at most once per
+ *   UID for the life of the process, after which the cached entry (or
+ *   failure) is returned.  The entry is owned by the cache and must not
+ *   be modified or freed.  Returns NULL with errno set on failure.
+ */
+const struct passwd *passwd_lookup (uid_t uid);
+
+/*
+ *  Set 'groups' to the supplementary group list of user 'pwd', which
+ *   must have been returned by passwd_lookup(), including 'gid' as with
+ *   getgrouplist(3).  The list is cached along with the passwd entry.
+ *   Returns the number of groups, or -1 on failure.
+ */
+int passwd_groups (const struct passwd *pwd, gid_t gid, const gid_t **groups);
+
+/*
+ *  Like initgroups(3), but uses the group list from passwd_groups().
+ */
+int passwd_initgroups (const struct passwd *pwd, gid_t gid);
+
+/*
+ *  Discard all cached passwd entries and group lists.  Pointers
+ *   returned by passwd_lookup() and passwd_groups() become invalid.
+ */
+void passwd_cache_clear (void);
+
 /*
  *  Return a copy of the passwd entry for UID
  *  Caller must free with passwd_destroy()
@@ -0,0 +1,52 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/*  Wrappers for the pidfd system calls, which older C libraries do
+ *   not provide.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+
+#include "pidfd.h"
+
+int imp_pidfd_open (pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    int fd;
+    if ((fd = syscall (SYS_pidfd_open, pid, 0)) < 0)
+        return -1;
+    /*  pidfds are always opened close-on-exec */
+    return fd;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int imp_pidfd_send_signal (int pidfd, int sig)
+{
+#ifdef SYS_pidfd_send_signal
+    return syscall (SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
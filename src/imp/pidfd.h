@@ -0,0 +1,29 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef HAVE_IMP_PIDFD_H
+#define HAVE_IMP_PIDFD_H 1
+
+#include <sys/types.h>
+
+/*  Open a pidfd(2) referring to process 'pid', with close-on-exec set.
+ *  Returns the pidfd on success, -1 on failure with errno set.
+ *   ENOSYS - pidfds are not supported by this system
+ */
+int imp_pidfd_open (pid_t pid);
+
+/*  Send signal 'sig' to the process referred to by 'pidfd'.  Unlike
+ *   kill(2), this cannot signal an unrelated process that has reused
+ *   the pid.
+ *  Returns 0 on success, -1 on failure with errno set.
+ */
+int imp_pidfd_send_signal (int pidfd, int sig);
+
+#endif /* !HAVE_IMP_PIDFD_H */
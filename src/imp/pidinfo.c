@@ -19,16 +19,14 @@
 #include <string.h>
 #include <errno.h>
 #include <dirent.h>
-#include <ctype.h>
 #include <stdbool.h>
 #include <limits.h>
 
+#include <fcntl.h>
+
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/vfs.h>
-#ifdef HAVE_LINUX_MAGIC_H
-#include <linux/magic.h>
-#endif
+#include <sys/syscall.h>
 
 #include <pwd.h>
 #include <signal.h>
@@ -36,57 +34,10 @@
 #include "src/libutil/strlcpy.h"
 
 #include "pidinfo.h"
+#include "cgroup.h"
+#include "pidfd.h"
 #include "imp_log.h"
 
-struct cgroup_info {
-    char mount_dir[PATH_MAX + 1];
-    bool unified;
-};
-
-/*  Determine if this system is using the unified (v2) or legacy (v1)
- *   cgroups hierarchy (See https://systemd.io/CGROUP_DELEGATION/)
- *   and mount point for systemd managed cgroups.
- */
-static int cgroup_info_init (struct cgroup_info *cg)
-{
-    struct statfs fs;
-
-    (void) strlcpy (cg->mount_dir, "/sys/fs/cgroup", sizeof (cg->mount_dir));
-    cg->unified = true;
-
-    if (statfs (cg->mount_dir, &fs) < 0)
-        return -1;
-
-#ifdef CGROUP2_SUPER_MAGIC
-    /* if cgroup2 fs mounted: unified hierarchy for all users of cgroupfs
-     */
-    if (fs.f_type == CGROUP2_SUPER_MAGIC)
-        return 0;
-#endif /* CGROUP2_SUPER_MAGIC */
-
-    /*  O/w, if /sys/fs/cgroup is mounted as tmpfs, we need to check
-     *   for /sys/fs/cgroup/systemd mounted as cgroupfs (legacy).
-     *   We do not support hybrid mode (/sys/fs/cgroup/systemd or
-     *   /sys/fs/cgroup/unified mounted as cgroup2fs), since there were
-     *   no systems on which to test this configuration.
-     */
-    if (fs.f_type == TMPFS_MAGIC) {
-
-        (void) strlcpy (cg->mount_dir,
-                        "/sys/fs/cgroup/systemd",
-                        sizeof (cg->mount_dir));
-        if (statfs (cg->mount_dir, &fs) == 0
-            && fs.f_type == CGROUP_SUPER_MAGIC) {
-            cg->unified = false;
-            return 0;
-            }
-    }
-
-    /*  Unable to determine cgroup mount point and/or unified vs legacy */
-    return -1;
-}
-
-
 /*  Store the command name from /proc/PID/comm into buffer 'buf' of size 'len'.
  */
 static int pid_command (pid_t pid, char *buf, int len)
@@ -241,40 +192,6 @@ static int parse_pid (const char *s, pid_t *ppid)
     return 0;
 }
 
-static pid_t pid_ppid (pid_t pid)
-{
-    char path [64];
-    char *line = NULL;
-    const int len = sizeof (path);
-    int n;
-    size_t size = 0;
-    FILE *fp = NULL;
-    pid_t ppid = -1;
-    int saved_errno;
-
-    /*  /proc/%ju/status is guaranteed to fit in 64 bytes
-     */
-    (void) snprintf (path, len, "/proc/%ju/status", (uintmax_t) pid);
-    if (!(fp = fopen (path, "r")))
-        return (pid_t) -1;
-
-    while ((n = getline (&line, &size, fp)) >= 0) {
-        if (strncmp (line, "PPid:", 5) == 0) {
-            char *p = line + 5;
-            while (isspace (*p))
-                ++p;
-            if (parse_pid (p, &ppid) < 0)
-                imp_warn ("parse_pid (%s): %s", p, strerror (errno));
-            break;
-        }
-    }
-    saved_errno = errno;
-    free (line);
-    fclose (fp);
-    errno = saved_errno;
-    return ppid;
-}
-
 void pid_info_destroy (struct pid_info *pi)
 {
     if (pi) {
@@ -311,56 +228,231 @@ err:
     return NULL;
 }
 
-int pid_kill_children_fallback (pid_t parent, int sig)
+/*  Process tree snapshot: one pass over /proc using getdents64(2) on
+ *   the /proc directory and openat(2) relative reads of PID/stat,
+ *   indexed by parent pid.
+ */
+struct pid_entry {
+    pid_t ppid;
+    pid_t pid;
+};
+
+struct pid_snapshot {
+    int proc_fd;
+    struct pid_entry *entries;  /* sorted by ppid, then pid */
+    pid_t *pids;                /* entries[i].pid, for pid_snapshot_children */
+    int count;
+};
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/*  Return the parent of 'pid' from PID/stat relative to 'proc_fd'.
+ *   Only the leading "pid (comm) state ppid" fields are needed.
+ */
+static pid_t stat_ppid (int proc_fd, pid_t pid)
 {
+    char path [64];
+    char buf [512];
+    char *p;
+    ssize_t n;
+    int fd;
+    long ppid;
+
+    (void) snprintf (path, sizeof (path), "%ju/stat", (uintmax_t) pid);
+    if ((fd = openat (proc_fd, path, O_RDONLY | O_CLOEXEC)) < 0)
+        return (pid_t) -1;
+    n = read (fd, buf, sizeof (buf) - 1);
+    (void) close (fd);
+    if (n <= 0)
+        return (pid_t) -1;
+    buf[n] = '\0';
+
+    /*  comm may contain spaces and parentheses, so find the last ')'
+     */
+    if (!(p = strrchr (buf, ')'))
+        || sscanf (p + 1, " %*c %ld", &ppid) != 1) {
+        errno = EINVAL;
+        return (pid_t) -1;
+    }
+    return (pid_t) ppid;
+}
+
+static int pid_entry_cmp (const void *a, const void *b)
+{
+    const struct pid_entry *e1 = a;
+    const struct pid_entry *e2 = b;
+
+    if (e1->ppid != e2->ppid)
+        return e1->ppid < e2->ppid ? -1 : 1;
+    if (e1->pid != e2->pid)
+        return e1->pid < e2->pid ? -1 : 1;
+    return 0;
+}
+
+static int pid_snapshot_append (struct pid_snapshot *ps,
+                                int *size,
+                                pid_t pid,
+                                pid_t ppid)
+{
+    if (ps->count == *size) {
+        int newsize = *size ? *size * 2 : 1024;
+        struct pid_entry *new;
+        if (!(new = realloc (ps->entries, newsize * sizeof (*new))))
+            return -1;
+        ps->entries = new;
+        *size = newsize;
+    }
+    ps->entries[ps->count].pid = pid;
+    ps->entries[ps->count].ppid = ppid;
+    ps->count++;
+    return 0;
+}
+
+void pid_snapshot_destroy (struct pid_snapshot *ps)
+{
+    if (ps) {
+        int saved_errno = errno;
+        if (ps->proc_fd >= 0)
+            (void) close (ps->proc_fd);
+        free (ps->entries);
+        free (ps->pids);
+        free (ps);
+        errno = saved_errno;
+    }
+}
+
+struct pid_snapshot *pid_snapshot_create (void)
+{
+    struct pid_snapshot *ps;
+    char buf [32768];
+    int size = 0;
+    long n;
+    int i;
+
+    if (!(ps = calloc (1, sizeof (*ps))))
+        return NULL;
+    if ((ps->proc_fd = open ("/proc",
+                             O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        goto error;
+
+    while ((n = syscall (SYS_getdents64,
+                         ps->proc_fd,
+                         buf,
+                         sizeof (buf))) > 0) {
+        long offset = 0;
+        while (offset < n) {
+            struct linux_dirent64 *d = (void *) (buf + offset);
+            pid_t pid;
+            pid_t ppid;
+
+            offset += d->d_reclen;
+            if (d->d_type != DT_DIR || parse_pid (d->d_name, &pid) < 0)
+                continue;
+            /*  A process may exit after its dirent was read.  Skip it.
+             */
+            if ((ppid = stat_ppid (ps->proc_fd, pid)) < 0)
+                continue;
+            if (pid_snapshot_append (ps, &size, pid, ppid) < 0)
+                goto error;
+        }
+    }
+    if (n < 0)
+        goto error;
+    qsort (ps->entries, ps->count, sizeof (ps->entries[0]), pid_entry_cmp);
+    if (!(ps->pids = calloc (ps->count + 1, sizeof (ps->pids[0]))))
+        goto error;
+    for (i = 0; i < ps->count; i++)
+        ps->pids[i] = ps->entries[i].pid;
+    return ps;
+error:
+    pid_snapshot_destroy (ps);
+    return NULL;
+}
+
+int pid_snapshot_children (struct pid_snapshot *ps,
+                           pid_t parent,
+                           const pid_t **pids)
+{
+    int lo = 0;
+    int hi;
+    int first;
+
+    if (!ps || !pids) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /*  Binary search for the first entry with ppid == parent
+     */
+    hi = ps->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ps->entries[mid].ppid < parent)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo;
+    while (lo < ps->count && ps->entries[lo].ppid == parent)
+        lo++;
+    *pids = &ps->pids[first];
+    return lo - first;
+}
+
+int pid_snapshot_kill_children (struct pid_snapshot *ps,
+                                pid_t parent,
+                                int sig)
+{
+    const pid_t *pids;
+    int n;
+    int i;
     int count = 0;
     int rc = 0;
     int saved_errno = 0;
-    DIR *dirp = NULL;
-    struct dirent *dent;
-    pid_t pid;
-    pid_t ppid;
 
-    if (parent <= (pid_t) 0 || sig < 0) {
+    if (!ps || parent <= (pid_t) 0 || sig < 0) {
         errno = EINVAL;
         return -1;
     }
-
-    if (!(dirp = opendir ("/proc")))
+    if ((n = pid_snapshot_children (ps, parent, &pids)) < 0)
         return -1;
-
-    while ((dent = readdir (dirp))) {
-        if (parse_pid (dent->d_name, &pid) < 0)
-            continue;
-        if ((ppid = pid_ppid (pid)) < 0) {
-            /* ENOENT is an expected error since a process on the system
-             *  could have exited between when we read the /proc dirents
-             *  and when we are checking for /proc/PID/status.
-             */
-            if (errno != ENOENT) {
-                saved_errno = errno;
-                rc = -1;
-                imp_warn ("Failed to get ppid of %lu: %s\n",
-                          (unsigned long) pid,
-                          strerror (errno));
-
+    for (i = 0; i < n; i++) {
+        int pidfd;
+        int result;
+
+        /*  Pin the child with a pidfd and confirm it is still a child
+         *   of 'parent', in case it exited and its pid was reused since
+         *   the snapshot was taken.
+         */
+        if ((pidfd = imp_pidfd_open (pids[i])) >= 0) {
+            if (stat_ppid (ps->proc_fd, pids[i]) != parent) {
+                (void) close (pidfd);
+                continue;
             }
-            continue;
+            result = imp_pidfd_send_signal (pidfd, sig);
+            (void) close (pidfd);
         }
-        if (ppid != parent)
+        else if (errno == ESRCH)
             continue;
-        if (kill (pid, sig) < 0) {
+        else
+            result = kill (pids[i], sig);
+        if (result < 0) {
             saved_errno = errno;
             rc = -1;
-            imp_warn ("Failed to send signal %d to pid %lu: %s\n",
+            imp_warn ("Failed to send signal %d to pid %lu: %s",
                       sig,
-                      (unsigned long) pid,
+                      (unsigned long) pids[i],
                       strerror (errno));
             continue;
         }
         count++;
     }
-    closedir (dirp);
     if (rc < 0 && count == 0) {
         count = -1;
         errno = saved_errno;
@@ -368,6 +460,22 @@ int pid_kill_children_fallback (pid_t parent, int sig)
     return count;
 }
 
+int pid_kill_children_fallback (pid_t parent, int sig)
+{
+    struct pid_snapshot *ps;
+    int count;
+
+    if (parent <= (pid_t) 0 || sig < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(ps = pid_snapshot_create ()))
+        return -1;
+    count = pid_snapshot_kill_children (ps, parent, sig);
+    pid_snapshot_destroy (ps);
+    return count;
+}
+
 int pid_kill_children (pid_t pid, int sig)
 {
     int count = 0;
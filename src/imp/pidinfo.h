@@ -32,4 +32,29 @@ int pid_kill_children (pid_t pid, int sig);
  */
 int pid_kill_children_fallback (pid_t parent, int sig);
 
+/*  A snapshot of the process tree, read from /proc in one pass and
+ *   indexed by parent pid, so that the children of many processes can
+ *   be found without rescanning /proc for each.
+ */
+struct pid_snapshot;
+
+struct pid_snapshot *pid_snapshot_create (void);
+void pid_snapshot_destroy (struct pid_snapshot *ps);
+
+/*  Set 'pids' to the array of children of 'parent' in the snapshot.
+ *   The array is valid for the lifetime of the snapshot.
+ *  Returns the number of children, or -1 on error.
+ */
+int pid_snapshot_children (struct pid_snapshot *ps,
+                           pid_t parent,
+                           const pid_t **pids);
+
+/*  Send signal to children of 'parent' found in the snapshot.  Children
+ *   which have since exited or been reparented are skipped.
+ *  Returns the number of children signaled or -1 if an error occurred.
+ */
+int pid_snapshot_kill_children (struct pid_snapshot *ps,
+                                pid_t parent,
+                                int sig);
+
 #endif /* !HAVE_PIDINFO_H */
@@ -17,14 +17,24 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
 
-/*  Max size of KV array allowed to be sent over privsep pipe */
+/*  Max size of KV array allowed to be sent inline over privsep socket */
 #define PRIVSEP_MAX_KVLEN 1024*1024*4
 
+/*  KV arrays larger than this are sent in a sealed memfd */
+#define PRIVSEP_MEMFD_KVLEN 64*1024
+
+/*  Seals required on a memfd received from the remote */
+#define PRIVSEP_MEMFD_SEALS \
+    (F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
 #include "privsep.h"
 #include "imp_log.h"
 
@@ -39,6 +49,14 @@ struct privsep {
 
     int wfd;       /* Copy of current process' write fd */
     int rfd;       /* Copy of current process' read fd  */
+
+    struct privsep_map *maps; /* memfd mappings backing kv views */
+};
+
+struct privsep_map {
+    struct privsep_map *next;
+    void *addr;
+    size_t len;
 };
 
 static int wakeup_child (privsep_t *ps)
@@ -59,7 +77,7 @@ static int wait_for_parent (privsep_t *ps)
     return (0);
 }
 
-void drop_privileges ()
+void drop_privileges (void)
 {
     uid_t ruid = -1, euid, suid;
     gid_t rgid = -1, egid, sgid;
@@ -147,8 +165,13 @@ privsep_t * privsep_init (privsep_child_f fn, void *arg)
     ps->wfd = -1;
     ps->rfd = -1;
 
-    if (pipe (ps->upfds) < 0 || pipe (ps->ppfds) < 0) {
-        imp_warn ("privsep_init: pipe: %s\n", strerror (errno));
+    /*  Use socketpairs rather than pipes so that file descriptors may
+     *   be passed between parent and child.  Each is used in one
+     *   direction only.
+     */
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, ps->upfds) < 0
+        || socketpair (AF_UNIX, SOCK_STREAM, 0, ps->ppfds) < 0) {
+        imp_warn ("privsep_init: socketpair: %s\n", strerror (errno));
         privsep_destroy (ps);
         return (NULL);
     }
@@ -187,6 +210,12 @@ void privsep_destroy (privsep_t *ps)
             close (ps->wfd);
         if (ps->rfd >= 0)
             close (ps->rfd);
+        while (ps->maps) {
+            struct privsep_map *map = ps->maps;
+            ps->maps = map->next;
+            munmap (map->addr, map->len);
+            free (map);
+        }
         free (ps);
     }
 }
@@ -255,18 +284,133 @@ ssize_t privsep_read (privsep_t *ps, void *buf, size_t count)
     return (count - nleft);
 }
 
+/*  Read the length header of a kv from the privsep socket, along with
+ *   a memfd if one was attached.  Sets *fdp to the memfd or -1.
+ */
+static int privsep_read_header (privsep_t *ps, int *lenp, int *fdp)
+{
+    char cbuf[CMSG_SPACE (sizeof (int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    ssize_t n;
+
+    if (!ps || ps->rfd < 0) {
+        errno = EINVAL;
+        return (-1);
+    }
+    memset (&msg, 0, sizeof (msg));
+    iov.iov_base = lenp;
+    iov.iov_len = sizeof (*lenp);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof (cbuf);
+
+    while ((n = recvmsg (ps->rfd, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+        if (errno != EINTR)
+            return (-1);
+    }
+    *fdp = -1;
+    if ((cmsg = CMSG_FIRSTHDR (&msg))) {
+        if (cmsg->cmsg_level != SOL_SOCKET
+            || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN (sizeof (int))) {
+            errno = EPROTO;
+            return (-1);
+        }
+        memcpy (fdp, CMSG_DATA (cmsg), sizeof (int));
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        errno = EPROTO;
+        goto error;
+    }
+    /*  A short read of the length is possible on a stream socket */
+    if (n < (ssize_t) sizeof (*lenp)
+        && privsep_read (ps, (char *) lenp + n, sizeof (*lenp) - n)
+           != (ssize_t) sizeof (*lenp) - n) {
+        errno = EPROTO;
+        goto error;
+    }
+    return (0);
+error:
+    if (*fdp >= 0) {
+        int saved_errno = errno;
+        close (*fdp);
+        *fdp = -1;
+        errno = saved_errno;
+    }
+    return (-1);
+}
+
+/*  Map 'len' bytes of encoded kv from memfd 'fd' and return a read-only
+ *   view of it.  The memfd must be sealed so that its contents cannot
+ *   change after they have been validated here.  The mapping is kept
+ *   until privsep_destroy().
+ */
+static struct kv *privsep_map_kv (privsep_t *ps, int fd, int len)
+{
+    struct privsep_map *map;
+    struct stat st;
+    struct kv *kv;
+    int seals;
+
+    if ((seals = fcntl (fd, F_GET_SEALS)) < 0
+        || (seals & PRIVSEP_MEMFD_SEALS) != PRIVSEP_MEMFD_SEALS
+        || fstat (fd, &st) < 0
+        || st.st_size != len) {
+        errno = EPROTO;
+        return (NULL);
+    }
+    if (!(map = calloc (1, sizeof (*map))))
+        return (NULL);
+    map->len = len;
+    if ((map->addr = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0))
+        == MAP_FAILED) {
+        int saved_errno = errno;
+        free (map);
+        errno = saved_errno;
+        return (NULL);
+    }
+    if (!(kv = kv_view (map->addr, len))) {
+        int saved_errno = errno;
+        munmap (map->addr, map->len);
+        free (map);
+        errno = saved_errno;
+        return (NULL);
+    }
+    map->next = ps->maps;
+    ps->maps = map;
+    return (kv);
+}
+
 struct kv * privsep_read_kv (privsep_t *ps)
 {
     struct kv *kv = NULL;
     char *buf;
     int len;
+    int fd;
 
     /*
      *  First read length of kv that is being sent
      */
-    if (privsep_read (ps, &len, sizeof (len)) != sizeof (len))
+    if (privsep_read_header (ps, &len, &fd) < 0)
         return (NULL);
 
+    /*
+     *  Large kv arrays arrive in a sealed memfd. Map it in place.
+     */
+    if (fd >= 0) {
+        if (len <= 0) {
+            close (fd);
+            errno = EPROTO;
+            return (NULL);
+        }
+        kv = privsep_map_kv (ps, fd, len);
+        close (fd);
+        return (kv);
+    }
+
     if (len <= 0 || len > PRIVSEP_MAX_KVLEN) {
         errno = E2BIG;
         return (NULL);
@@ -293,16 +437,93 @@ struct kv * privsep_read_kv (privsep_t *ps)
     return (kv);
 }
 
+/*  Copy encoded kv 'buf' of length 'len' into a new sealed memfd.
+ *   Returns the memfd on success, -1 on failure with errno set.
+ */
+static int privsep_memfd_create (const char *buf, int len)
+{
+    int fd;
+    int saved_errno;
+
+    if ((fd = memfd_create ("privsep-kv", MFD_CLOEXEC | MFD_ALLOW_SEALING))
+        < 0)
+        return (-1);
+    if (ftruncate (fd, len) < 0
+        || pwrite (fd, buf, len, 0) != len
+        || fcntl (fd, F_ADD_SEALS, PRIVSEP_MEMFD_SEALS) < 0)
+        goto error;
+    return (fd);
+error:
+    saved_errno = errno;
+    close (fd);
+    errno = saved_errno;
+    return (-1);
+}
+
+/*  Send the length 'len' of a kv with memfd 'fd' attached.
+ */
+static int privsep_write_memfd (privsep_t *ps, int fd, int len)
+{
+    char cbuf[CMSG_SPACE (sizeof (fd))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+
+    memset (&msg, 0, sizeof (msg));
+    memset (cbuf, 0, sizeof (cbuf));
+    iov.iov_base = &len;
+    iov.iov_len = sizeof (len);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof (cbuf);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (fd));
+    memcpy (CMSG_DATA (cmsg), &fd, sizeof (fd));
+
+    while (sendmsg (ps->wfd, &msg, 0) != sizeof (len)) {
+        if (errno != EINTR)
+            return (-1);
+    }
+    return (0);
+}
+
 ssize_t privsep_write_kv (privsep_t *ps, struct kv *kv)
 {
     int n;
     int len;
     const char *buf;
 
+    if (!ps || ps->wfd < 0) {
+        errno = EINVAL;
+        return (-1);
+    }
     if (kv_encode (kv, &buf, &len) < 0)
         return (-1);
 
-    if (len <= 0 || len > PRIVSEP_MAX_KVLEN) {
+    if (len <= 0) {
+        errno = E2BIG;
+        return (-1);
+    }
+
+    /*  Send large kv arrays in a sealed memfd, falling back to the
+     *   socket if memfd_create(2) is not available.
+     */
+    if (len > PRIVSEP_MEMFD_KVLEN) {
+        int fd = privsep_memfd_create (buf, len);
+        if (fd >= 0) {
+            int rc = privsep_write_memfd (ps, fd, len);
+            int saved_errno = errno;
+            close (fd);
+            errno = saved_errno;
+            return (rc < 0 ? -1 : len);
+        }
+        if (errno != ENOSYS && errno != EINVAL)
+            return (-1);
+    }
+    if (len > PRIVSEP_MAX_KVLEN) {
         errno = E2BIG;
         return (-1);
     }
@@ -21,13 +21,18 @@ typedef struct privsep privsep_t;
 typedef void (*privsep_child_f) (privsep_t *ps, void *arg);
 
 /*  Spawn an unprivliged child running child_fn from a setuid program,
- *   connected to the current process with pipes for IPC.
+ *   connected to the current process with socketpairs for IPC.
  *
  *  Parent returns valid privsep_t on success, child calls function fn
  *   and does not return.
  */
 privsep_t * privsep_init (privsep_child_f fn, void *arg);
 
+/*  Permanently set all uids and gids to the real uid and gid.
+ *   Exits on failure.
+ */
+void drop_privileges (void);
+
 /*  If this is the parent process, wait for child to exit.
  *  Returns 0 if child exited normally, -1 if not.
  */
@@ -59,8 +64,10 @@ ssize_t privsep_read (privsep_t *ps, void *buf, size_t count);
 ssize_t privsep_write (privsep_t *ps, const void *buf, size_t count);
 
 /*
- *  Write a struct kv over privsep pipe, returning size of the kv
- *   written on success, -1 on failure.
+ *  Write a struct kv over privsep socket, returning size of the kv
+ *   written on success, -1 on failure.  Large kv objects are copied
+ *   into a sealed memfd which is passed to the remote instead, so
+ *   their size is not limited.
  *
  *  Specific errno values include:
  *    EINVAL  - Invalid argument (bad privsep handle or struct kv)
@@ -69,12 +76,16 @@ ssize_t privsep_write (privsep_t *ps, const void *buf, size_t count);
 ssize_t privsep_write_kv (privsep_t *ps, struct kv *kv);
 
 /*
- *  Read a struct kv from privsep pipe. Returns kv on success or NULL
+ *  Read a struct kv from privsep socket. Returns kv on success or NULL
  *   on failure with errno set.
  *
+ *  A kv sent in a memfd is returned as a read-only view of the mapped
+ *   memfd (see kv_view()), which must be destroyed before privsep_destroy().
+ *
  *  Specific errno values include:
  *    EINVAL  - Invalide privsep handle
  *    E2BIG   - Remote tried to send kv that was too large
+ *    EPROTO  - Remote sent a memfd that was not sealed or a bad message
  */
 struct kv * privsep_read_kv (privsep_t *ps);
 
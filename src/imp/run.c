@@ -61,6 +61,7 @@
 #include "imp_state.h"
 #include "impcmd.h"
 #include "privsep.h"
+#include "passwd.h"
 
 extern char **environ;
 
@@ -97,39 +98,49 @@ static const cf_t *imp_run_lookup (struct imp_state *imp,
 
 static bool run_user_allowed (const cf_t *cf_run)
 {
-    struct passwd *pwd;
+    const struct passwd *pwd;
 
-    if (!(pwd = getpwuid (getuid ())) || !pwd->pw_name)
+    if (!(pwd = passwd_lookup (getuid ())) || !pwd->pw_name)
         imp_die (1, "Unable to lookup user");
 
     return cf_array_contains (cf_get_in (cf_run, "allowed-users"),
                               pwd->pw_name);
 }
 
-static bool run_env_var_allowed (const cf_t *allowed_env,
-                                 const char *name)
+/*  Return the allowed-environment filter for command 'name', compiled
+ *   once by imp_policy_compile() so that each variable is checked with
+ *   a hash lookup plus, for patterns containing wildcards, a prefix
+ *   compare before fnmatch(3).
+ */
+static struct cf_set *run_env_filter (struct imp_state *imp, const char *name)
+{
+    struct cf_set *filter;
+
+    if (!(filter = hash_find (imp->run_env, name)))
+        imp_die (1, "run: %s: allowed-environment not compiled", name);
+    return filter;
+}
+
+static bool run_env_var_allowed (const char *name, void *arg)
 {
+    const struct cf_set *filter = arg;
+
     if (strcmp (name, "FLUX_JOB_ID") == 0
         || strcmp (name, "FLUX_JOB_USERID") == 0)
         return true;
-    return cf_array_contains_match (allowed_env, name);
+    return cf_set_contains (filter, name);
 }
 
 /*  Return a kv structure with the environment for this run command.
  */
-static struct kv *get_run_env (struct kv *kv, const cf_t *allowed_env)
+static struct kv *get_run_env (struct kv *kv, struct cf_set *filter)
 {
     struct kv *kv_env;
-    const char *var = NULL;
 
-    if (!(kv_env = kv_split (kv, "IMP_RUN_ENV_")))
+    kv_env = kv_split_filter (kv, "IMP_RUN_ENV_", run_env_var_allowed, filter);
+    if (!kv_env)
         return NULL;
 
-    while ((var = kv_next (kv_env, var))) {
-        if (!run_env_var_allowed (allowed_env, var))
-            kv_delete (kv_env, var);
-    }
-
     /*  Capture uid that ran the imp as the "owner" */
     if (kv_put (kv_env,
                 "FLUX_OWNER_USERID",
@@ -146,7 +157,7 @@ imp_run (const char *name,
          struct kv *kv_env)
 {
     const char *path;
-    struct passwd *pwd;
+    const struct passwd *pwd;
     char **env;
     const char *args[2];
     int exit_code;
@@ -159,7 +170,7 @@ imp_run (const char *name,
         imp_die (1, "run %s: relative path not allowed", name);
 
     /*  Get passwd entry for current user to set HOME and USER */
-    if (!(pwd = getpwuid (getuid ())))
+    if (!(pwd = passwd_lookup (getuid ())))
         imp_die (1, "run: failed to find target user");
 
     /*  Set HOME and USER */
@@ -229,7 +240,7 @@ int imp_run_privileged (struct imp_state *imp,
     if (!run_user_allowed (cf_run))
         imp_die (1, "run: permission denied");
 
-    kv_env = get_run_env (kv, cf_get_in (cf_run, "allowed-environment"));
+    kv_env = get_run_env (kv, run_env_filter (imp, name));
     if (!kv_env)
         imp_die (1, "run: error processing command environment");
 
@@ -242,11 +253,11 @@ int imp_run_privileged (struct imp_state *imp,
     return 0;
 }
 
-/*  Put all environment variables that match any entry in allowed_env
+/*  Put all environment variables that match any entry in 'filter'
  *   into `kv` as `IMP_RUN_ENV_${name}` for later inclusion in final
  *   environment of run command by privileged parent process.
  */
-static void imp_run_kv_putenv (struct kv *kv, const cf_t *allowed_env)
+static void imp_run_kv_putenv (struct kv *kv, struct cf_set *filter)
 {
     char **env = environ;
     char *p;
@@ -271,7 +282,7 @@ static void imp_run_kv_putenv (struct kv *kv, const cf_t *allowed_env)
                  *   with IMP_RUN_ENV_ prepended so the environment variable
                  *   list can be split out by parent with kv_split()
                  */
-                if (run_env_var_allowed (allowed_env, name)) {
+                if (run_env_var_allowed (name, filter)) {
                     /*  We know name is <= 128 characters, add length
                      *   of string "IMP_RUN_ENV_" to `var` to ensure there
                      *   is space for the prepended kv key. Then it is
@@ -287,12 +298,11 @@ static void imp_run_kv_putenv (struct kv *kv, const cf_t *allowed_env)
     }
 }
 
-static void imp_run_put_kv (const char *name,
+static void imp_run_put_kv (struct imp_state *imp,
+                            const char *name,
                             const cf_t *cf_run,
                             struct kv *kv)
 {
-    const cf_t *allowed_env;
-
     /*  Send command to parent
      */
     if (kv_put (kv, "command", KV_STRING, name) < 0)
@@ -300,8 +310,8 @@ static void imp_run_put_kv (const char *name,
 
     /*  Pass allowed current environment as IMP_RUN_ENV_*
      */
-    if ((allowed_env = cf_get_in (cf_run, "allowed-environment")))
-        imp_run_kv_putenv (kv, allowed_env);
+    if (cf_get_in (cf_run, "allowed-environment"))
+        imp_run_kv_putenv (kv, run_env_filter (imp, name));
 }
 
 int imp_run_unprivileged (struct imp_state *imp, struct kv *kv)
@@ -319,7 +329,7 @@ int imp_run_unprivileged (struct imp_state *imp, struct kv *kv)
 
     cf_run = imp_run_lookup (imp, imp->argv[2]);
 
-    imp_run_put_kv (name, cf_run, kv);
+    imp_run_put_kv (imp, name, cf_run, kv);
 
     if (imp->ps) {
         if (privsep_write_kv (imp->ps, kv) < 0)
@@ -335,7 +345,7 @@ int imp_run_unprivileged (struct imp_state *imp, struct kv *kv)
     if (!run_user_allowed (cf_run))
         imp_die (1, "run: permission denied");
 
-    kv_env = get_run_env (kv, cf_get_in (cf_run, "allowed-environment"));
+    kv_env = get_run_env (kv, run_env_filter (imp, name));
     imp_run (imp->argv[2], cf_run, kv_env);
 
     return 0;
@@ -0,0 +1,1198 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* flux-imp server - serve IMP commands from a long-running root process
+ *
+ * PURPOSE:
+ *
+ *  Avoid the cost of starting a setuid flux-imp for every command
+ *  (loading and validating configuration, compiling allow-lists, creating
+ *  a security context) by keeping that state in a long-running process.
+ *
+ * OPERATION:
+ *
+ *  'flux-imp server', run as root, listens on the Unix domain socket
+ *  built into flux-imp.  A flux-imp invoked with a privileged command
+ *  connects to the socket before reading any configuration and, if the
+ *  server is running as root, sends its arguments, environment and
+ *  standard file descriptors to the server instead of running the
+ *  command itself.
+ *
+ *  For each connection the server obtains the credentials of the client
+ *  with SO_PEERCRED.  Connections from root, from users not in
+ *  exec.allowed-users, or beyond the configured number of concurrent
+ *  handlers (globally or for the user) are closed without further work,
+ *  and the client then runs the command itself.  Otherwise the server
+ *  forks a handler, which receives the request with a timeout and forks
+ *  a worker into the cgroup of the client.  The worker takes on the
+ *  client's stdio, arguments, working directory, umask and resource
+ *  limits, and sets its real uid and gid to those of the client while
+ *  keeping an effective uid of 0, i.e. the credentials of a setuid
+ *  flux-imp run by the client.  It then runs the command through the
+ *  usual privilege separation path, so all checks are the same as for a
+ *  setuid flux-imp.
+ *
+ *  The cgroup and resource limits are read by the handler from the
+ *  client process itself (the SO_PEERCRED pid), not from the request,
+ *  which the client could forge.  A pidfd held while they are read
+ *  ensures they did not come from another process reusing the pid.
+ *  The worker starts a new session, so unlike a setuid flux-imp it has
+ *  no controlling terminal, and it keeps the namespaces and audit
+ *  session of the server.
+ *
+ *  The handler forwards signals received by the client to the worker
+ *  and sends the worker's wait status back to the client, which exits
+ *  with the same status.
+ *
+ *  Configuration, compiled allow-lists, and the security context used
+ *  to verify J are inherited by each worker from the server.  The server
+ *  must be restarted to pick up configuration changes.
+ *
+ * PROTOCOL:
+ *
+ *  server -> client: int 0, once a handler has accepted the connection.
+ *  client -> server: int length, followed by an encoded kv with the
+ *    client's command line under "argv", environment under "env" and
+ *    umask under "umask".  The client's stdin, stdout and stderr, and
+ *    its working directory opened with O_PATH, are attached to the
+ *    length with SCM_RIGHTS.
+ *  client -> server: int signal number, for each forwarded signal.
+ *  server -> client: int wait status of the worker.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pwd.h>
+#include <grp.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+
+#include "src/libutil/kv.h"
+#include "src/lib/context.h"
+
+#include "imp_log.h"
+#include "imp_state.h"
+#include "impcmd.h"
+#include "privsep.h"
+#include "passwd.h"
+#include "pidinfo.h"
+#include "pidfd.h"
+#include "cgroup.h"
+#include "server.h"
+
+/*  Max size of an encoded request, the same as a privsep kv */
+#define SERVER_MAX_REQUEST 1024*1024*4
+
+#define SERVER_BACKLOG 128
+
+/*  File descriptors sent with a request: stdin, stdout, stderr and
+ *   the working directory of the client.
+ */
+#define SERVER_NFDS 4
+#define SERVER_CWD_FD 3
+
+/*  Seconds a handler waits for the client to send its request */
+#define SERVER_RECV_TIMEOUT 10
+
+/*  Default limits on concurrent handlers, overridden by
+ *   server.max-handlers and server.max-handlers-per-user.
+ */
+#define SERVER_MAX_HANDLERS 1024
+#define SERVER_MAX_HANDLERS_PER_USER 256
+
+struct server_handler {
+    pid_t pid;
+    uid_t uid;
+};
+
+/*  Attributes of the client process which a setuid flux-imp would have
+ *   inherited from it, read by the handler from the process itself.
+ */
+struct client_proc {
+    int cgroup_fd;
+    struct rlimit rlim[RLIM_NLIMITS];
+};
+
+struct server {
+    int sfd;                /* signalfd for SIGCHLD */
+    struct server_handler *handlers;
+    int count;
+    int max_handlers;
+    int max_handlers_per_user;
+};
+
+extern char **environ;
+
+extern const char *imp_get_security_config_pattern (void);
+extern const char *imp_get_server_socket_path (void);
+extern int imp_get_security_flags (void);
+
+/*  Signals forwarded from client to worker, the same set that
+ *   'flux-imp exec' forwards to the job shell.
+ */
+static const int forward_signals[] = {
+    SIGTERM,
+    SIGINT,
+    SIGHUP,
+    SIGCONT,
+    SIGALRM,
+    SIGWINCH,
+    SIGTTIN,
+    SIGTTOU,
+};
+static const int nforward_signals =
+    sizeof (forward_signals) / sizeof (forward_signals[0]);
+
+/*  Variables that ld.so removes from the environment of a setuid
+ *   program (UNSECURE_ENVVARS in glibc).  They are removed from the
+ *   client environment as well, so commands see the same environment
+ *   as under a setuid flux-imp.  All LD_ variables are removed.
+ */
+static const char *unsecure_env[] = {
+    "GCONV_PATH",
+    "GETCONF_DIR",
+    "GLIBC_TUNABLES",
+    "HOSTALIASES",
+    "LOCALDOMAIN",
+    "LOCPATH",
+    "MALLOC_TRACE",
+    "NIS_PATH",
+    "NLSPATH",
+    "RESOLV_HOST_CONF",
+    "RES_OPTIONS",
+    "TMPDIR",
+    "TZDIR",
+    NULL,
+};
+
+static bool signal_is_forwarded (int signum)
+{
+    int i;
+    for (i = 0; i < nforward_signals; i++) {
+        if (forward_signals[i] == signum)
+            return true;
+    }
+    return false;
+}
+
+static ssize_t fd_write_all (int fd, const void *buf, size_t count)
+{
+    const char *p = buf;
+    size_t nleft = count;
+
+    while (nleft > 0) {
+        ssize_t n = write (fd, p, nleft);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        nleft -= n;
+        p += n;
+    }
+    return (count);
+}
+
+static ssize_t fd_read_all (int fd, void *buf, size_t count)
+{
+    char *p = buf;
+    size_t nleft = count;
+
+    while (nleft > 0) {
+        ssize_t n = read (fd, p, nleft);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        else if (n == 0)
+            break;
+        nleft -= n;
+        p += n;
+    }
+    return (count - nleft);
+}
+
+static int peer_cred (int fd, struct ucred *cred)
+{
+    socklen_t len = sizeof (*cred);
+
+    if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, cred, &len) < 0)
+        return (-1);
+    if (len != sizeof (*cred)) {
+        errno = EPROTO;
+        return (-1);
+    }
+    return (0);
+}
+
+/*  Return the supplementary groups of the peer on 'fd' in an array the
+ *   caller must free, with the count in 'ngroups'.  These are the groups
+ *   a setuid flux-imp run by the client would have inherited.  Returns
+ *   NULL with errno set to ENOPROTOOPT if SO_PEERGROUPS is unsupported.
+ */
+static gid_t *peer_groups (int fd, int *ngroups)
+{
+#ifdef SO_PEERGROUPS
+    socklen_t len = 32 * sizeof (gid_t);
+    gid_t *groups = NULL;
+
+    for (;;) {
+        gid_t *new;
+        if (!(new = realloc (groups, len))) {
+            free (groups);
+            return NULL;
+        }
+        groups = new;
+        if (getsockopt (fd, SOL_SOCKET, SO_PEERGROUPS, groups, &len) == 0)
+            break;
+        if (errno != ERANGE) {
+            int saved_errno = errno;
+            free (groups);
+            errno = saved_errno;
+            return NULL;
+        }
+        /*  On ERANGE 'len' is set to the size required.
+         */
+    }
+    *ngroups = len / sizeof (gid_t);
+    return groups;
+#else
+    errno = ENOPROTOOPT;
+    return NULL;
+#endif
+}
+
+/*  Send encoded request 'kv' over 'fd', with stdin, stdout and stderr
+ *   of this process and 'cwd_fd' attached.
+ */
+static int send_request (int fd, struct kv *kv, int cwd_fd)
+{
+    int fds[SERVER_NFDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO,
+                             cwd_fd };
+    char cbuf[CMSG_SPACE (sizeof (fds))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    const char *buf;
+    int len;
+
+    if (kv_encode (kv, &buf, &len) < 0)
+        return (-1);
+    if (len <= 0 || len > SERVER_MAX_REQUEST) {
+        errno = E2BIG;
+        return (-1);
+    }
+
+    memset (&msg, 0, sizeof (msg));
+    memset (cbuf, 0, sizeof (cbuf));
+    iov.iov_base = &len;
+    iov.iov_len = sizeof (len);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof (cbuf);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (fds));
+    memcpy (CMSG_DATA (cmsg), fds, sizeof (fds));
+
+    while (sendmsg (fd, &msg, 0) != sizeof (len)) {
+        if (errno != EINTR)
+            return (-1);
+    }
+    if (fd_write_all (fd, buf, len) != len)
+        return (-1);
+    return (0);
+}
+
+static void close_fds (int fds[SERVER_NFDS])
+{
+    int i;
+    for (i = 0; i < SERVER_NFDS; i++)
+        close (fds[i]);
+}
+
+/*  Receive a request sent by send_request(), placing the attached
+ *   file descriptors in 'fds'.  Returns request on success, NULL on
+ *   failure with errno set.
+ */
+static struct kv *recv_request (int fd, int fds[SERVER_NFDS])
+{
+    char cbuf[CMSG_SPACE (SERVER_NFDS * sizeof (int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    struct kv *kv;
+    char *buf;
+    int len;
+    ssize_t n;
+    int saved_errno;
+
+    memset (&msg, 0, sizeof (msg));
+    iov.iov_base = &len;
+    iov.iov_len = sizeof (len);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof (cbuf);
+
+    while ((n = recvmsg (fd, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+        if (errno != EINTR)
+            return (NULL);
+    }
+    cmsg = CMSG_FIRSTHDR (&msg);
+    if ((msg.msg_flags & MSG_CTRUNC)
+        || !cmsg
+        || cmsg->cmsg_level != SOL_SOCKET
+        || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN (SERVER_NFDS * sizeof (int))) {
+        errno = EPROTO;
+        return (NULL);
+    }
+    memcpy (fds, CMSG_DATA (cmsg), SERVER_NFDS * sizeof (int));
+
+    /*  A short read of the length is possible on a stream socket */
+    if (n < (ssize_t) sizeof (len)
+        && fd_read_all (fd, (char *) &len + n, sizeof (len) - n)
+           != (ssize_t) sizeof (len) - n)
+        goto error_proto;
+    if (len <= 0 || len > SERVER_MAX_REQUEST) {
+        errno = E2BIG;
+        goto error;
+    }
+    if (!(buf = malloc (len)))
+        goto error;
+    if (fd_read_all (fd, buf, len) != len) {
+        free (buf);
+        goto error_proto;
+    }
+    kv = kv_decode (buf, len);
+    saved_errno = errno;
+    free (buf);
+    errno = saved_errno;
+    if (!kv)
+        goto error;
+    return (kv);
+error_proto:
+    errno = EPROTO;
+error:
+    saved_errno = errno;
+    close_fds (fds);
+    errno = saved_errno;
+    return (NULL);
+}
+
+/*  Expand the argv array stored under 'prefix' in 'kv'.
+ */
+static char **request_expand (struct kv *kv, const char *prefix)
+{
+    struct kv *args;
+    char **argv = NULL;
+
+    if (!(args = kv_split (kv, prefix)))
+        return (NULL);
+    if (kv_expand_argv (args, &argv) < 0)
+        argv = NULL;
+    kv_destroy (args);
+    return (argv);
+}
+
+static bool env_is_unsecure (const char *entry)
+{
+    size_t len = strcspn (entry, "=");
+    int i;
+
+    if (strncmp (entry, "LD_", 3) == 0)
+        return true;
+    for (i = 0; unsecure_env[i] != NULL; i++) {
+        if (strlen (unsecure_env[i]) == len
+            && strncmp (entry, unsecure_env[i], len) == 0)
+            return true;
+    }
+    return false;
+}
+
+/*  Remove unsecure variables from 'env' in place.
+ */
+static void env_sanitize (char **env)
+{
+    char **dst = env;
+    char **src;
+
+    for (src = env; *src != NULL; src++) {
+        if (env_is_unsecure (*src))
+            free (*src);
+        else
+            *dst++ = *src;
+    }
+    *dst = NULL;
+}
+
+/*  Make file descriptors 'fds' the stdin, stdout and stderr of this
+ *   process.  They are moved out of the way first in case any of them
+ *   already occupy 0-2.
+ */
+static void stdio_replace (int fds[3])
+{
+    int tmp[3];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if ((tmp[i] = fcntl (fds[i], F_DUPFD_CLOEXEC, 3)) < 0)
+            imp_die (1, "server: dup: %s", strerror (errno));
+        close (fds[i]);
+    }
+    for (i = 0; i < 3; i++) {
+        if (dup2 (tmp[i], i) < 0)
+            imp_die (1, "server: dup2: %s", strerror (errno));
+        close (tmp[i]);
+    }
+}
+
+/*  Worker: take on the identity, stdio, arguments, working directory,
+ *   umask and resource limits of the client, then run the requested
+ *   command as a setuid flux-imp would.  The worker has already been
+ *   started in the cgroup of the client by the handler.
+ *
+ *  The supplementary groups are those of the client from SO_PEERGROUPS.
+ *   Where that is unavailable ('groups' is NULL) they are looked up from
+ *   the group database instead, which may differ from the groups of the
+ *   client process, e.g. after newgrp(1) or a group database change.
+ *
+ *  The client environment is never adopted here.  The worker keeps an
+ *   effective uid of 0 without an exec, so AT_SECURE is not set, and
+ *   secure_getenv(3) and the libraries behind NSS, PAM and iconv would
+ *   trust variables such as GCONV_PATH or RES_OPTIONS set by the client.
+ *   It is instead stored in imp->client_env for the processes that run
+ *   with the privileges of the client.
+ */
+static void __attribute__((noreturn))
+server_worker (struct imp_state *imp,
+               const struct ucred *cred,
+               const gid_t *groups,
+               int ngroups,
+               const struct client_proc *proc,
+               struct kv *req,
+               int fds[SERVER_NFDS],
+               imp_server_f fn)
+{
+    const struct passwd *pwd;
+    int rc;
+    sigset_t mask;
+    char **argv;
+    char **env;
+    int argc;
+    int64_t cmask;
+    int i;
+
+    sigemptyset (&mask);
+    if (sigprocmask (SIG_SETMASK, &mask, NULL) < 0)
+        imp_die (1, "server: failed to unblock signals: %s", strerror (errno));
+
+    /*  Leave the session and process group of the server, so that
+     *   signals sent to those do not reach the command.
+     */
+    if (setsid () < 0)
+        imp_die (1, "server: setsid: %s", strerror (errno));
+
+    if (fchdir (fds[SERVER_CWD_FD]) < 0)
+        imp_die (1, "server: failed to change to client working directory: %s",
+                 strerror (errno));
+    close (fds[SERVER_CWD_FD]);
+    stdio_replace (fds);
+
+    if (!(argv = request_expand (req, "argv"))
+        || !(env = request_expand (req, "env"))
+        || kv_get (req, "umask", KV_INT64, &cmask) < 0)
+        imp_die (1, "server: failed to decode request");
+    for (argc = 0; argv[argc] != NULL; argc++)
+        ;
+    kv_destroy (req);
+    umask ((mode_t) cmask & 0777);
+
+    if (!(pwd = passwd_lookup (cred->uid)))
+        imp_die (1, "server: unknown uid %ju", (uintmax_t) cred->uid);
+    if (groups)
+        rc = setgroups (ngroups, groups);
+    else
+        rc = passwd_initgroups (pwd, cred->gid);
+    if (rc < 0
+        || setresgid (cred->gid, cred->gid, cred->gid) < 0
+        || setresuid (cred->uid, 0, 0) < 0)
+        imp_die (1, "server: failed to set credentials for uid %ju: %s",
+                 (uintmax_t) cred->uid,
+                 strerror (errno));
+
+    /*  Set limits while the effective uid is still 0, since the hard
+     *   limits of the client may be above those of the server.
+     */
+    for (i = 0; i < RLIM_NLIMITS; i++) {
+        if (setrlimit (i, &proc->rlim[i]) < 0)
+            imp_die (1, "server: failed to set resource limit %d: %s",
+                     i,
+                     strerror (errno));
+    }
+
+    env_sanitize (env);
+    imp->client_env = env;
+    imp->argc = argc;
+    imp->argv = argv;
+
+    exit ((*fn) (imp));
+}
+
+/*  Handler: forward signals from the client on 'cfd' to worker 'pid'
+ *   until it exits, then return its wait status.  Signals are read
+ *   from 'sfd', a signalfd for SIGCHLD.
+ */
+static int server_supervise (int cfd, int sfd, pid_t pid)
+{
+    struct pollfd pfd[2];
+    int npfd = 2;
+    int status;
+
+    pfd[0].fd = sfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = cfd;
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        if (poll (pfd, npfd, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            imp_die (1, "server: poll: %s", strerror (errno));
+        }
+        if (pfd[0].revents) {
+            struct signalfd_siginfo si;
+            if (read (sfd, &si, sizeof (si)) < 0 && errno != EAGAIN)
+                imp_die (1, "server: signalfd: %s", strerror (errno));
+            if (waitpid (pid, &status, WNOHANG) == pid)
+                return (status);
+        }
+        if (npfd > 1 && pfd[1].revents) {
+            int signum;
+
+            /*  If the client goes away, keep waiting for the worker,
+             *   as a setuid flux-imp would continue if its caller exited.
+             */
+            if (fd_read_all (cfd, &signum, sizeof (signum)) != sizeof (signum))
+                npfd = 1;
+            else if (signal_is_forwarded (signum))
+                kill (pid, signum);
+        }
+    }
+}
+
+static int parse_rlim (const char *s, rlim_t *valp)
+{
+    unsigned long long val;
+    char *endptr;
+
+    if (strcmp (s, "unlimited") == 0) {
+        *valp = RLIM_INFINITY;
+        return (0);
+    }
+    errno = 0;
+    val = strtoull (s, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || endptr == s) {
+        errno = EINVAL;
+        return (-1);
+    }
+    *valp = val;
+    return (0);
+}
+
+/*  Read the resource limits of process 'pid' from /proc/PID/limits,
+ *   which lists them in order of resource number after a header line.
+ *   Unlike prlimit(2), this does not require CAP_SYS_RESOURCE.
+ */
+static int proc_rlimits (pid_t pid, struct rlimit rlim[RLIM_NLIMITS])
+{
+    char path[64];
+    char *line = NULL;
+    size_t size = 0;
+    FILE *fp;
+    int n = 0;
+    int rc = -1;
+    int saved_errno;
+
+    (void) snprintf (path, sizeof (path), "/proc/%ju/limits", (uintmax_t) pid);
+    if (!(fp = fopen (path, "r")))
+        return (-1);
+    if (getline (&line, &size, fp) < 0)
+        goto out;
+    while (n < RLIM_NLIMITS && getline (&line, &size, fp) >= 0) {
+        char soft[32];
+        char hard[32];
+
+        /*  The limit name occupies the first 26 columns
+         */
+        if (strlen (line) < 26
+            || sscanf (line + 26, "%31s %31s", soft, hard) != 2
+            || parse_rlim (soft, &rlim[n].rlim_cur) < 0
+            || parse_rlim (hard, &rlim[n].rlim_max) < 0)
+            break;
+        n++;
+    }
+    if (n == RLIM_NLIMITS)
+        rc = 0;
+    else
+        errno = EINVAL;
+out:
+    saved_errno = errno;
+    free (line);
+    fclose (fp);
+    errno = saved_errno;
+    return (rc);
+}
+
+/*  Read the cgroup and resource limits of client process 'pid' into
+ *   'proc'.  A pidfd is opened first and checked afterwards, so that
+ *   if the client has exited in between, the attributes of a process
+ *   reusing its pid are not used.  Without pidfd support the client is
+ *   assumed to be alive, since it holds its end of the connection.
+ */
+static void client_proc_read (pid_t pid, struct client_proc *proc)
+{
+    struct pid_info *pi;
+    int pidfd;
+
+    if ((pidfd = imp_pidfd_open (pid)) < 0 && errno != ENOSYS)
+        imp_die (1, "server: pidfd_open %jd: %s",
+                 (intmax_t) pid,
+                 strerror (errno));
+    if (!(pi = pid_info_create (pid)))
+        imp_die (1, "server: failed to get cgroup of pid %jd: %s",
+                 (intmax_t) pid,
+                 strerror (errno));
+    if ((proc->cgroup_fd = open (pi->cg_path,
+                                 O_PATH | O_DIRECTORY | O_CLOEXEC)) < 0)
+        imp_die (1, "server: %s: %s", pi->cg_path, strerror (errno));
+    pid_info_destroy (pi);
+    if (proc_rlimits (pid, proc->rlim) < 0)
+        imp_die (1, "server: failed to get resource limits of pid %jd: %s",
+                 (intmax_t) pid,
+                 strerror (errno));
+    if (pidfd >= 0) {
+        if (imp_pidfd_send_signal (pidfd, 0) < 0)
+            imp_die (1, "server: client pid %jd exited", (intmax_t) pid);
+        close (pidfd);
+    }
+}
+
+/*  Set the receive timeout of 'fd' to 'sec' seconds, 0 for none.
+ */
+static int set_recv_timeout (int fd, int sec)
+{
+    struct timeval tv = { .tv_sec = sec, .tv_usec = 0 };
+    return setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+}
+
+static void __attribute__((noreturn))
+server_handle (struct imp_state *imp,
+               int cfd,
+               const struct ucred *credp,
+               imp_server_f fn)
+{
+    struct ucred cred = *credp;
+    struct client_proc proc;
+    struct kv *req;
+    gid_t *groups;
+    int ngroups = 0;
+    int fds[SERVER_NFDS];
+    int ack = 0;
+    sigset_t mask;
+    int sfd;
+    pid_t pid;
+    int status;
+
+    /*  Cached passwd entries must not outlive a request.
+     */
+    passwd_cache_clear ();
+
+    if (fd_write_all (cfd, &ack, sizeof (ack)) != sizeof (ack))
+        imp_die (1, "server: failed to accept request from pid %jd: %s",
+                 (intmax_t) cred.pid,
+                 strerror (errno));
+
+    /*  A client that connects and sends nothing must not hold a
+     *   handler indefinitely.
+     */
+    if (set_recv_timeout (cfd, SERVER_RECV_TIMEOUT) < 0
+        || !(req = recv_request (cfd, fds))
+        || set_recv_timeout (cfd, 0) < 0)
+        imp_die (1, "server: failed to read request from pid %jd: %s",
+                 (intmax_t) cred.pid,
+                 strerror (errno));
+    if (!(groups = peer_groups (cfd, &ngroups)) && errno != ENOPROTOOPT)
+        imp_die (1, "server: SO_PEERGROUPS: %s", strerror (errno));
+    client_proc_read (cred.pid, &proc);
+
+    /*  Block SIGCHLD before forking so the exit of the worker is
+     *   delivered to the signalfd.
+     */
+    sigemptyset (&mask);
+    sigaddset (&mask, SIGCHLD);
+    if (sigprocmask (SIG_BLOCK, &mask, NULL) < 0
+        || (sfd = signalfd (-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0)
+        imp_die (1, "server: signalfd: %s", strerror (errno));
+
+    if ((pid = cgroup_fork (proc.cgroup_fd)) < 0)
+        imp_die (1, "server: fork: %s", strerror (errno));
+    if (pid == 0) {
+        close (sfd);
+        close (cfd);
+        close (proc.cgroup_fd);
+        server_worker (imp, &cred, groups, ngroups, &proc, req, fds, fn);
+    }
+    free (groups);
+    close (proc.cgroup_fd);
+    close_fds (fds);
+    kv_destroy (req);
+
+    status = server_supervise (cfd, sfd, pid);
+    if (fd_write_all (cfd, &status, sizeof (status)) != sizeof (status))
+        imp_warn ("server: failed to return status to pid %jd: %s",
+                  (intmax_t) cred.pid,
+                  strerror (errno));
+    exit (0);
+}
+
+/*  Bind a listening socket to 'path', replacing any stale socket.
+ */
+static int server_listen (const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    mode_t mask;
+    int fd;
+    int rc;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen (path) >= sizeof (addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+    strcpy (addr.sun_path, path);
+
+    if (lstat (path, &st) == 0) {
+        if (!S_ISSOCK (st.st_mode)) {
+            errno = EEXIST;
+            return (-1);
+        }
+        if (unlink (path) < 0)
+            return (-1);
+    }
+    if ((fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        return (-1);
+
+    /*  Any user may connect.  Access is checked per request, as for
+     *   a setuid flux-imp, against the credentials of the client.
+     */
+    mask = umask (0111);
+    rc = bind (fd, (struct sockaddr *) &addr, sizeof (addr));
+    umask (mask);
+    if (rc < 0 || listen (fd, SERVER_BACKLOG) < 0) {
+        int saved_errno = errno;
+        close (fd);
+        errno = saved_errno;
+        return (-1);
+    }
+    return (fd);
+}
+
+/*  Create the security context shared by all workers.  Failure is not
+ *   fatal here, it will be reported by the commands that need it.
+ */
+static void server_sec_init (struct imp_state *imp)
+{
+    flux_security_t *sec;
+
+    if (!(sec = flux_security_create (imp_get_security_flags ()))
+        || flux_security_configure (sec,
+                                    imp_get_security_config_pattern ()) < 0) {
+        imp_warn ("server: security context: %s",
+                  sec ? flux_security_last_error (sec) : strerror (errno));
+        flux_security_destroy (sec);
+        return;
+    }
+    imp->sec = sec;
+}
+
+/*  Read a handler limit 'key' from the [server] table, or 'def' if unset.
+ */
+static int server_limit (struct imp_state *imp, const char *key, int def)
+{
+    const cf_t *cf = cf_get_in (cf_get_in (imp->conf, "server"), key);
+    int64_t val;
+
+    if (!cf)
+        return def;
+    if (cf_typeof (cf) != CF_INT64
+        || (val = cf_int64 (cf)) <= 0
+        || val > INT_MAX)
+        imp_die (1, "server: server.%s must be a positive integer", key);
+    return val;
+}
+
+static int server_user_count (struct server *srv, uid_t uid)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < srv->count; i++) {
+        if (srv->handlers[i].uid == uid)
+            count++;
+    }
+    return count;
+}
+
+/*  Return true if a handler may be started for client 'cred'.  This is
+ *   checked before forking so that a connection which will be refused
+ *   costs no more than an accept(2).  The passwd entry is looked up
+ *   directly, since the passwd cache is not used in this long-running
+ *   process.
+ */
+static bool server_user_allowed (struct imp_state *imp,
+                                 struct server *srv,
+                                 const struct ucred *cred)
+{
+    struct passwd *pwd;
+
+    if (cred->uid == 0) {
+        imp_warn ("server: refusing request from root (pid %jd)",
+                  (intmax_t) cred->pid);
+        return false;
+    }
+    if (srv->count >= srv->max_handlers) {
+        imp_warn ("server: refusing request from uid %ju:"
+                  " %d handlers running",
+                  (uintmax_t) cred->uid,
+                  srv->count);
+        return false;
+    }
+    if (server_user_count (srv, cred->uid) >= srv->max_handlers_per_user) {
+        imp_warn ("server: refusing request from uid %ju:"
+                  " %d handlers running for user",
+                  (uintmax_t) cred->uid,
+                  srv->max_handlers_per_user);
+        return false;
+    }
+    if (!(pwd = getpwuid (cred->uid))
+        || !cf_set_contains (imp->exec_users, pwd->pw_name)) {
+        imp_debug ("server: uid %ju is not in exec.allowed-users",
+                   (uintmax_t) cred->uid);
+        return false;
+    }
+    return true;
+}
+
+/*  Reap exited handlers and remove them from the handler table.
+ */
+static void server_reap (struct server *srv)
+{
+    struct signalfd_siginfo si;
+    pid_t pid;
+
+    while (read (srv->sfd, &si, sizeof (si)) == sizeof (si))
+        ;
+    while ((pid = waitpid (-1, NULL, WNOHANG)) > 0) {
+        int i;
+        for (i = 0; i < srv->count; i++) {
+            if (srv->handlers[i].pid == pid) {
+                srv->handlers[i] = srv->handlers[--srv->count];
+                break;
+            }
+        }
+    }
+}
+
+/*  Accept a connection on 'fd' and, if allowed, fork a handler for it.
+ *   A refused connection is closed before it is acknowledged.
+ */
+static void server_accept (struct imp_state *imp,
+                           struct server *srv,
+                           int fd,
+                           imp_server_f fn)
+{
+    struct ucred cred;
+    int cfd;
+    pid_t pid;
+
+    if ((cfd = accept4 (fd, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+        if (errno != EINTR && errno != ECONNABORTED)
+            imp_warn ("server: accept: %s", strerror (errno));
+        return;
+    }
+    if (peer_cred (cfd, &cred) < 0) {
+        imp_warn ("server: SO_PEERCRED: %s", strerror (errno));
+        goto out;
+    }
+    if (!server_user_allowed (imp, srv, &cred))
+        goto out;
+    if ((pid = fork ()) < 0)
+        imp_warn ("server: fork: %s", strerror (errno));
+    else if (pid == 0) {
+        close (fd);
+        close (srv->sfd);
+        server_handle (imp, cfd, &cred, fn);
+    }
+    else {
+        srv->handlers[srv->count].pid = pid;
+        srv->handlers[srv->count].uid = cred.uid;
+        srv->count++;
+    }
+out:
+    close (cfd);
+}
+
+void imp_server (struct imp_state *imp, imp_server_f fn)
+{
+    struct server srv;
+    struct pollfd pfd[2];
+    sigset_t mask;
+    const char *path;
+    int fd;
+
+    if (getuid () != 0 || geteuid () != 0)
+        imp_die (1, "server: must be run as root");
+    if (!(path = imp_get_server_socket_path ()))
+        imp_die (1, "server: no socket path is configured");
+
+    memset (&srv, 0, sizeof (srv));
+    srv.max_handlers = server_limit (imp,
+                                     "max-handlers",
+                                     SERVER_MAX_HANDLERS);
+    srv.max_handlers_per_user = server_limit (imp,
+                                              "max-handlers-per-user",
+                                              SERVER_MAX_HANDLERS_PER_USER);
+    if (!(srv.handlers = calloc (srv.max_handlers, sizeof (*srv.handlers))))
+        imp_die (1, "server: out of memory");
+
+    server_sec_init (imp);
+
+    /*  Handlers are reaped when SIGCHLD is read from a signalfd, so
+     *   that the number running is known.
+     */
+    sigemptyset (&mask);
+    sigaddset (&mask, SIGCHLD);
+    if (sigprocmask (SIG_BLOCK, &mask, NULL) < 0
+        || (srv.sfd = signalfd (-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0)
+        imp_die (1, "server: signalfd: %s", strerror (errno));
+
+    if ((fd = server_listen (path)) < 0)
+        imp_die (1, "server: %s: %s", path, strerror (errno));
+    imp_say ("server: listening on %s", path);
+
+    pfd[0].fd = srv.sfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = fd;
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        if (poll (pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            imp_die (1, "server: poll: %s", strerror (errno));
+        }
+        if (pfd[0].revents)
+            server_reap (&srv);
+        if (pfd[1].revents)
+            server_accept (imp, &srv, fd, fn);
+    }
+}
+
+/*  Connect to the server at 'path'.  Returns -1 if no server is
+ *   listening or the server refused the connection.  It is fatal if
+ *   the server is not running as root.
+ */
+static int server_connect (const char *path)
+{
+    struct sockaddr_un addr;
+    struct ucred cred;
+    int ack;
+    int fd;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen (path) >= sizeof (addr.sun_path))
+        return (-1);
+    strcpy (addr.sun_path, path);
+
+    if ((fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        return (-1);
+    if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+        close (fd);
+        return (-1);
+    }
+    if (peer_cred (fd, &cred) < 0)
+        imp_die (1, "server: SO_PEERCRED: %s", strerror (errno));
+    if (cred.uid != 0)
+        imp_die (1, "server: %s is not served by root", path);
+
+    /*  The server closes the connection without acknowledgement if it
+     *   will not handle the request, e.g. for a user not in
+     *   exec.allowed-users or when too many handlers are running.
+     */
+    if (fd_read_all (fd, &ack, sizeof (ack)) != sizeof (ack) || ack != 0) {
+        close (fd);
+        return (-1);
+    }
+    return (fd);
+}
+
+static struct kv *request_create (struct imp_state *imp)
+{
+    struct kv *kv;
+    struct kv *argv = NULL;
+    struct kv *env = NULL;
+    mode_t mask = umask (0);
+
+    umask (mask);
+    if (!(kv = kv_create ())
+        || !(argv = kv_encode_argv ((const char **) imp->argv))
+        || !(env = kv_encode_argv ((const char **) environ))
+        || kv_join (kv, argv, "argv") < 0
+        || kv_join (kv, env, "env") < 0
+        || kv_put (kv, "umask", KV_INT64, (int64_t) mask) < 0) {
+        kv_destroy (kv);
+        kv = NULL;
+    }
+    kv_destroy (argv);
+    kv_destroy (env);
+    return (kv);
+}
+
+/*  Send the request to the server on 'fd', with working directory
+ *   'cwd_fd', then forward signals to the server until it returns the
+ *   wait status of the worker.
+ */
+static int server_client (struct imp_state *imp, int fd, int cwd_fd)
+{
+    struct pollfd pfd[2];
+    struct kv *req;
+    sigset_t mask;
+    int sfd;
+    int status;
+    int i;
+
+    if (!(req = request_create (imp)))
+        imp_die (1, "server: failed to encode request: %s", strerror (errno));
+    if (send_request (fd, req, cwd_fd) < 0)
+        imp_die (1, "server: failed to send request: %s", strerror (errno));
+    kv_destroy (req);
+    close (cwd_fd);
+
+    sigemptyset (&mask);
+    for (i = 0; i < nforward_signals; i++)
+        sigaddset (&mask, forward_signals[i]);
+    if (sigprocmask (SIG_BLOCK, &mask, NULL) < 0
+        || (sfd = signalfd (-1, &mask, SFD_CLOEXEC)) < 0)
+        imp_die (1, "server: signalfd: %s", strerror (errno));
+
+    pfd[0].fd = fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = sfd;
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+        if (poll (pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            imp_die (1, "server: poll: %s", strerror (errno));
+        }
+        if (pfd[0].revents)
+            break;
+        if (pfd[1].revents) {
+            struct signalfd_siginfo si;
+            int signum;
+
+            if (read (sfd, &si, sizeof (si)) != sizeof (si))
+                imp_die (1, "server: signalfd: %s", strerror (errno));
+            signum = si.ssi_signo;
+            if (fd_write_all (fd, &signum, sizeof (signum))
+                != sizeof (signum))
+                imp_die (1, "server: failed to forward signal %d: %s",
+                         signum,
+                         strerror (errno));
+        }
+    }
+    if (fd_read_all (fd, &status, sizeof (status)) != sizeof (status))
+        imp_die (1, "server: connection closed before command completed");
+    close (sfd);
+    close (fd);
+
+    if (WIFEXITED (status))
+        return (WEXITSTATUS (status));
+    else if (WIFSIGNALED (status))
+        return (WTERMSIG (status) + 128);
+    return (1);
+}
+
+void imp_server_forward (struct imp_state *imp)
+{
+    const char *path;
+    uid_t euid = geteuid ();
+    int cwd_fd;
+    int fd;
+
+    /*  Only commands with a privileged half are forwarded.  Root has no
+     *   use for the server, and would be refused by it.
+     */
+    if (imp->argc < 2
+        || !imp_cmd_find_parent (imp->argv[1])
+        || getuid () == 0
+        || !(path = imp_get_server_socket_path ()))
+        return;
+
+    /*  If setuid, connect with the real uid so the server sees the
+     *   credentials of the caller.  Privileges are dropped permanently
+     *   only once the server has accepted the connection, so that
+     *   the command may still run locally if there is no server.
+     */
+    if (euid == 0 && seteuid (getuid ()) < 0)
+        imp_die (1, "server: seteuid: %s", strerror (errno));
+    if ((cwd_fd = open (".", O_PATH | O_DIRECTORY | O_CLOEXEC)) < 0
+        || (fd = server_connect (path)) < 0) {
+        if (cwd_fd >= 0)
+            close (cwd_fd);
+        if (euid == 0 && seteuid (0) < 0)
+            imp_die (1, "server: failed to restore privilege");
+        return;
+    }
+    if (euid == 0)
+        drop_privileges ();
+
+    exit (server_client (imp, fd, cwd_fd));
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,36 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef HAVE_IMP_SERVER_H
+#define HAVE_IMP_SERVER_H 1
+
+#include "imp_state.h"
+
+/*  Function run by a server worker to execute the command in imp->argv
+ *   with privilege separation.  Returns the exit code for the worker.
+ */
+typedef int (*imp_server_f) (struct imp_state *imp);
+
+/*  Run 'flux-imp server': listen on the built-in socket path
+ *   and run each request in a worker forked from this process with the
+ *   credentials of the requestor.  Must be run as root.  Does not return.
+ */
+void __attribute__((noreturn)) imp_server (struct imp_state *imp,
+                                           imp_server_f fn);
+
+/*  If a server is listening on the built-in socket path and is served
+ *   by root, forward the privileged command in imp->argv to the server
+ *   and exit with its result.  Otherwise return so the command is run
+ *   locally.  Only imp->argv is used, so this may be called before
+ *   configuration is loaded.
+ */
+void imp_server_forward (struct imp_state *imp);
+
+#endif /* !HAVE_IMP_SERVER_H */
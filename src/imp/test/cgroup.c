@@ -0,0 +1,144 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <wait.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+
+#include "cgroup.h"
+
+#include "src/libtap/tap.h"
+
+static void test_invalid (void)
+{
+    const char *paths[] = {
+        "",
+        "foo",
+        "foo/bar",
+        "/..",
+        "/foo/../bar",
+        "/foo/./bar",
+        "/foo/..",
+        "/foo//.",
+        NULL,
+    };
+    int i;
+
+    errno = 0;
+    ok (cgroup_open (NULL, (uid_t) -1) < 0 && errno == EINVAL,
+        "cgroup_open (NULL) fails with EINVAL");
+    for (i = 0; paths[i] != NULL; i++) {
+        errno = 0;
+        ok (cgroup_open (paths[i], (uid_t) -1) < 0 && errno == EINVAL,
+            "cgroup_open (\"%s\") fails with EINVAL", paths[i]);
+    }
+}
+
+/*  Return 0 if the cgroup2 path of the calling process is 'path'
+ */
+static int check_cgroup (const char *path)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t size = 0;
+    int rc = -1;
+
+    if (!(fp = fopen ("/proc/self/cgroup", "r")))
+        return -1;
+    while (getline (&line, &size, fp) >= 0) {
+        if (strncmp (line, "0::", 3) == 0) {
+            line[strcspn (line, "\n")] = '\0';
+            if (strcmp (line + 3, path) == 0)
+                rc = 0;
+            break;
+        }
+    }
+    free (line);
+    fclose (fp);
+    return rc;
+}
+
+static void test_fork (void)
+{
+    int fd;
+    pid_t pid;
+    int status;
+
+    if ((fd = cgroup_open ("/", (uid_t) -1)) < 0) {
+        ok (errno == ENOTSUP, "cgroup_open (\"/\") fails with ENOTSUP");
+        skip (1, 4, "no cgroup2 hierarchy found");
+        end_skip;
+        return;
+    }
+    pass ("cgroup_open (\"/\") works");
+
+    ok (cgroup_open ("/", getuid () + 1) < 0 && errno == EPERM,
+        "cgroup_open (\"/\") fails with EPERM for wrong owner");
+
+    skip (geteuid () != 0, 3, "moving to root cgroup requires root");
+    ok ((pid = cgroup_fork (fd)) >= 0,
+        "cgroup_fork works");
+    if (pid == 0)
+        _exit (check_cgroup ("/") < 0 ? 1 : 0);
+    ok (waitpid (pid, &status, 0) == pid,
+        "waitpid works");
+    ok (WIFEXITED (status) && WEXITSTATUS (status) == 0,
+        "child was started in cgroup");
+    end_skip;
+
+    close (fd);
+}
+
+static void test_fork_no_cgroup (void)
+{
+    pid_t pid;
+    int status;
+
+    ok ((pid = cgroup_fork (-1)) >= 0,
+        "cgroup_fork (-1) works");
+    if (pid == 0)
+        _exit (0);
+    ok (waitpid (pid, &status, 0) == pid && status == 0,
+        "cgroup_fork (-1) child exited normally");
+}
+
+static void test_kill_invalid (void)
+{
+    errno = 0;
+    ok (cgroup_kill (NULL, SIGTERM) < 0 && errno == EINVAL,
+        "cgroup_kill (NULL) fails with EINVAL");
+    errno = 0;
+    ok (cgroup_kill ("/sys/fs/cgroup", -1) < 0 && errno == EINVAL,
+        "cgroup_kill with invalid signal fails with EINVAL");
+    errno = 0;
+    ok (cgroup_kill ("/nonexistent/cgroup", SIGTERM) < 0 && errno == ENOENT,
+        "cgroup_kill of nonexistent cgroup fails with ENOENT");
+}
+
+int main (void)
+{
+    plan (NO_PLAN);
+
+    test_invalid ();
+    test_fork ();
+    test_fork_no_cgroup ();
+    test_kill_invalid ();
+
+    done_testing ();
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
@@ -76,6 +76,8 @@ int main (void)
     reset_logbuf ();
     imp_debug ("Interesting Thing.");
     is (testbuf, "", "imp_debug: by default no debug output");
+    ok (imp_log_enabled (IMP_LOG_INFO) && !imp_log_enabled (IMP_LOG_DEBUG),
+        "imp_log_enabled: debug is disabled by default");
 
     ok (imp_log_set_level (NULL, 9999) < 0 && errno == EINVAL,
         "imp_log_set_level: returns EINVAL for invalid level");
@@ -86,6 +88,8 @@ int main (void)
     imp_debug ("Interesting Thing.");
     is (testbuf, "Debug: Interesting Thing.",
         "imp_debug: works");
+    ok (imp_log_enabled (IMP_LOG_DEBUG),
+        "imp_log_enabled: debug is enabled after imp_log_set_level");
 
     ok (imp_log_set_level ("test", IMP_LOG_INFO) >= 0,
         "imp_log_set_level: decrease level for test logger");
@@ -93,6 +97,8 @@ int main (void)
     reset_logbuf ();
     imp_debug ("debug message");
     is (testbuf, "", "test log ignores messages above its set level");
+    ok (!imp_log_enabled (IMP_LOG_DEBUG),
+        "imp_log_enabled: debug is disabled when no output accepts it");
 
     /*  Test log output truncation */
     char buf [8192];
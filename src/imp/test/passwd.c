@@ -14,6 +14,66 @@
 
 #include "src/libtap/tap.h"
 
+static void test_cache (void)
+{
+    const struct passwd *pwd;
+    const struct passwd *pwd2;
+    struct passwd *copy;
+    const gid_t *groups;
+    const gid_t *groups2;
+    int n;
+    int i;
+
+    if (!(pwd = passwd_lookup (0)))
+        BAIL_OUT ("passwd_lookup (0) failed");
+    is (pwd->pw_name, "root",
+        "passwd_lookup() returned correct entry for root");
+    ok (passwd_lookup (0) == pwd,
+        "passwd_lookup() returns cached entry on second call");
+
+    errno = 0;
+    ok (passwd_lookup (-1) == NULL && errno != 0,
+        "passwd_lookup() fails on invalid uid");
+    errno = 0;
+    ok (passwd_lookup (-1) == NULL && errno != 0,
+        "passwd_lookup() failure is cached with errno");
+
+    ok ((n = passwd_groups (pwd, 0, &groups)) >= 1,
+        "passwd_groups() works for root");
+    for (i = 0; i < n; i++)
+        if (groups[i] == 0)
+            break;
+    ok (i < n,
+        "passwd_groups() list includes primary gid");
+    ok (passwd_groups (pwd, 0, &groups2) == n && groups2 == groups,
+        "passwd_groups() returns cached list on second call");
+
+    if (!(copy = passwd_from_uid (0)))
+        BAIL_OUT ("passwd_from_uid() failed");
+    errno = 0;
+    ok (passwd_groups (copy, 0, &groups) < 0 && errno == EINVAL,
+        "passwd_groups() fails with EINVAL for uncached entry");
+    passwd_destroy (copy);
+
+    errno = 0;
+    ok (passwd_groups (NULL, 0, &groups) < 0 && errno == EINVAL,
+        "passwd_groups (NULL) fails with EINVAL");
+
+    pwd2 = passwd_lookup (0);
+    ok (pwd2 == pwd,
+        "cached entry is unchanged by passwd_from_uid()");
+
+    lives_ok ({passwd_cache_clear ();},
+        "passwd_cache_clear() works");
+    ok ((pwd = passwd_lookup (0)) != NULL && pwd->pw_uid == 0,
+        "passwd_lookup() works after passwd_cache_clear()");
+    ok (passwd_groups (pwd, 0, &groups) >= 1,
+        "passwd_groups() works after passwd_cache_clear()");
+    passwd_cache_clear ();
+    lives_ok ({passwd_cache_clear ();},
+        "passwd_cache_clear() on empty cache works");
+}
+
 int main (void)
 {
     struct passwd *pwd;
@@ -33,6 +93,8 @@ int main (void)
 
     ok (!(pwd = passwd_from_uid (-1)),
         "passwd_from_uid() fails on invalid uid");
+
+    test_cache ();
     done_testing ();
 }
 
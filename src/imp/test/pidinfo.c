@@ -147,6 +147,46 @@ static void pid_kill_tests (void)
 
 }
 
+static void pid_snapshot_tests (void)
+{
+    struct pid_snapshot *ps;
+    const pid_t *pids;
+    pid_t pid;
+    int status;
+
+    errno = 0;
+    ok (pid_snapshot_children (NULL, 1, &pids) < 0 && errno == EINVAL,
+        "pid_snapshot_children (NULL) returns EINVAL");
+    errno = 0;
+    ok (pid_snapshot_kill_children (NULL, 1, 0) < 0 && errno == EINVAL,
+        "pid_snapshot_kill_children (NULL) returns EINVAL");
+
+    if ((pid = testchild_create (3)) < 0)
+        BAIL_OUT ("testchild_create failed!");
+
+    ok ((ps = pid_snapshot_create ()) != NULL,
+        "pid_snapshot_create works");
+    ok (pid_snapshot_children (ps, getpid (), &pids) >= 1,
+        "pid_snapshot_children finds children of self");
+    ok (pid_snapshot_children (ps, pid, &pids) == 3,
+        "pid_snapshot_children (%d) returned 3", (int) pid);
+    ok (pid_snapshot_children (ps, 0x7ffffffe, &pids) == 0,
+        "pid_snapshot_children of nonexistent pid returned 0");
+    errno = 0;
+    ok (pid_snapshot_kill_children (ps, -1, 0) < 0 && errno == EINVAL,
+        "pid_snapshot_kill_children with invalid args returns EINVAL");
+    ok (pid_snapshot_kill_children (ps, pid, SIGTERM) == 3,
+        "pid_snapshot_kill_children (%d) returned 3", (int) pid);
+    ok (waitpid (pid, &status, 0) == pid,
+        "waitpid returned %d",
+        pid);
+    ok (WIFEXITED (status) && WEXITSTATUS (status) == SIGTERM + 128,
+        "child exited with 128 + SIGTERM");
+    ok (pid_snapshot_kill_children (ps, pid, SIGTERM) == 0,
+        "pid_snapshot_kill_children skips exited children");
+    pid_snapshot_destroy (ps);
+}
+
 int main (void)
 {
     struct pid_info *p;
@@ -175,6 +215,7 @@ int main (void)
     pid_info_destroy (p);
 
     pid_kill_tests ();
+    pid_snapshot_tests ();
 
     done_testing ();
 }
@@ -8,12 +8,17 @@
  * SPDX-License-Identifier: LGPL-3.0
 \************************************************************/
 
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
 
 #include "imp_log.h"
 #include "sudosim.h"
@@ -183,8 +188,6 @@ static struct kv *create_yuuuuuge_kv (void)
     memset (largeval, 'x', sizeof (largeval) - 1);
     largeval [4095] = '\0';
 
-    ok (strlen (largeval) == 4095, "Create huge value for oversized kv");
-
     for (i = 0; i < 1024; i++) {
         char key [5];
         if (sprintf (key, "%04d", i) != 4) {
@@ -202,6 +205,101 @@ fail:
     return (NULL);
 }
 
+static void child_write_huge_kv (privsep_t *ps,
+                                 void *arg __attribute__ ((unused)))
+{
+    struct kv *kv;
+
+    if (!(kv = create_yuuuuuge_kv ()))
+        imp_die (1, "failed to create huge kv");
+    if (privsep_write_kv (ps, kv) < 0)
+        imp_die (1, "privsep_write_kv: %s", strerror (errno));
+    kv_destroy (kv);
+}
+
+static void test_privsep_kv_huge (void)
+{
+    privsep_t *ps;
+    struct kv *kv;
+    const char *s;
+
+    ok ((ps = privsep_init (child_write_huge_kv, NULL)) != NULL,
+        "privsep_init");
+    if (ps == NULL)
+        BAIL_OUT ("privsep_init failed");
+
+    ok ((kv = privsep_read_kv (ps)) != NULL,
+        "privsep_read_kv of kv larger than inline limit works");
+    ok (kv && kv_get (kv, "1023", KV_STRING, &s) == 0 && strlen (s) == 4095,
+        "last entry of huge kv has correct value");
+    ok (kv && kv_put (kv, "foo", KV_STRING, "bar") < 0 && errno == EROFS,
+        "huge kv is a read-only view");
+    kv_destroy (kv);
+
+    ok (privsep_wait (ps) == 0, "privsep child exited normally");
+    privsep_destroy (ps);
+}
+
+/*  Send an unsealed memfd to the parent in place of a large kv
+ */
+static void child_write_unsealed_memfd (privsep_t *ps __attribute__ ((unused)),
+                                        void *arg __attribute__ ((unused)))
+{
+    int fd = *(int *) arg;
+    int len = 4096;
+    char cbuf[CMSG_SPACE (sizeof (int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    bool sent = false;
+    int i;
+
+    memset (&msg, 0, sizeof (msg));
+    memset (cbuf, 0, sizeof (cbuf));
+    iov.iov_base = &len;
+    iov.iov_len = sizeof (len);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof (cbuf);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+    memcpy (CMSG_DATA (cmsg), &fd, sizeof (int));
+
+    /*  The privsep write fd is not exported, so send on every socket
+     *   open in the child.  The parent only reads from one of them.
+     */
+    for (i = 3; i < 1024; i++) {
+        if (i != fd && sendmsg (i, &msg, MSG_NOSIGNAL) == sizeof (len))
+            sent = true;
+    }
+    if (!sent)
+        imp_die (1, "failed to send memfd to parent");
+}
+
+static void test_privsep_kv_unsealed (void)
+{
+    privsep_t *ps;
+    int fd;
+
+    if ((fd = memfd_create ("test", 0)) < 0 || ftruncate (fd, 4096) < 0)
+        BAIL_OUT ("memfd_create: %s", strerror (errno));
+
+    ok ((ps = privsep_init (child_write_unsealed_memfd, &fd)) != NULL,
+        "privsep_init");
+    if (ps == NULL)
+        BAIL_OUT ("privsep_init failed");
+    close (fd);
+
+    ok (privsep_read_kv (ps) == NULL && errno == EPROTO,
+        "privsep_read_kv fails with EPROTO on unsealed memfd");
+
+    ok (privsep_wait (ps) == 0, "privsep child exited normally");
+    privsep_destroy (ps);
+}
+
 static void test_privsep_kv_bad_input (void)
 {
     struct kv *kv;
@@ -221,13 +319,6 @@ static void test_privsep_kv_bad_input (void)
     ok ((kv = privsep_read_kv (ps)) == NULL && errno == E2BIG,
         "privsep_read fails with invalid size (< 0)");
 
-    ok ((kv = create_yuuuuuge_kv ()) != NULL,
-        "created kv of unusual size");
-    ok ((privsep_write_kv (ps, kv) < 0) && errno == E2BIG,
-        "privsep_write_kv returns E2BIG on very large kv");
-
-    kv_destroy (kv);
-
     privsep_destroy (ps);
 }
 
@@ -258,6 +349,8 @@ int main (void)
     test_privsep_basic ();
     test_privsep_kv ();
     test_privsep_kv_bad_input ();
+    test_privsep_kv_huge ();
+    test_privsep_kv_unsealed ();
 
     imp_closelog ();
     done_testing ();
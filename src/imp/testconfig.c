@@ -57,6 +57,14 @@ const char * imp_get_security_config_pattern (void)
     return imp_get_config_pattern ();
 }
 
+/*  For build-tree/test IMP only!  Return the server socket path from
+ *   FLUX_IMP_SERVER_SOCKET, or NULL so that no server is used.
+ */
+const char * imp_get_server_socket_path (void)
+{
+    return getenv ("FLUX_IMP_SERVER_SOCKET");
+}
+
 int imp_get_security_flags (void)
 {
     if (!getenv ("FLUX_TEST_IMP_PATH_PARANOIA"))
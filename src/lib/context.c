@@ -16,6 +16,8 @@
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
 
 #include "src/libutil/cf.h"
 #include "src/libutil/aux.h"
@@ -23,10 +25,27 @@
 #include "context.h"
 #include "context_private.h"
 
-struct flux_security {
+/* Configuration and preloaded credentials.  Once shared with
+ * flux_security_config_get(), the object is never modified again,
+ * so it may be attached to contexts used by different threads.
+ */
+struct flux_security_config {
+    int refcount;
+    bool shared;
     cf_t *config;
+    struct aux_item *cred;
+};
+
+struct security_slot_item {
+    void *data;
+    flux_security_free_f freefun;
+};
+
+struct flux_security {
+    flux_security_config_t *cfg;
     int flags;
     struct aux_item *aux;
+    struct security_slot_item slot[SECURITY_SLOT_COUNT];
     char error[200];
     int errnum;
 };
@@ -51,6 +70,43 @@ void security_error (flux_security_t *ctx, const char *fmt, ...)
     }
 }
 
+static flux_security_config_t *config_create (cf_t *cf)
+{
+    flux_security_config_t *cfg;
+
+    if (!(cfg = calloc (1, sizeof (*cfg))))
+        return NULL;
+    cfg->refcount = 1;
+    cfg->config = cf;
+    return cfg;
+}
+
+flux_security_config_t *flux_security_config_incref (flux_security_config_t *cfg)
+{
+    if (cfg)
+        __atomic_add_fetch (&cfg->refcount, 1, __ATOMIC_RELAXED);
+    return cfg;
+}
+
+void flux_security_config_decref (flux_security_config_t *cfg)
+{
+    if (cfg && __atomic_sub_fetch (&cfg->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        int saved_errno = errno;
+        aux_destroy (&cfg->cred);
+        cf_destroy (cfg->config);
+        free (cfg);
+        errno = saved_errno;
+    }
+}
+
+/* Replace the configuration of 'ctx' with 'cfg', consuming a reference.
+ */
+static void config_replace (flux_security_t *ctx, flux_security_config_t *cfg)
+{
+    flux_security_config_decref (ctx->cfg);
+    ctx->cfg = cfg;
+}
+
 static bool valid_flags (int flags)
 {
     /*  Currently valid flags:
@@ -79,11 +135,25 @@ flux_security_t *flux_security_create (int flags)
     return ctx;
 }
 
+static void slot_clear (struct security_slot_item *item)
+{
+    if (item->data && item->freefun) {
+        int saved_errno = errno;
+        item->freefun (item->data);
+        errno = saved_errno;
+    }
+    item->data = NULL;
+    item->freefun = NULL;
+}
+
 void flux_security_destroy (flux_security_t *ctx)
 {
     if (ctx) {
+        int i;
+        for (i = SECURITY_SLOT_COUNT - 1; i >= 0; i--)
+            slot_clear (&ctx->slot[i]);
         aux_destroy (&ctx->aux);
-        cf_destroy (ctx->config);
+        flux_security_config_decref (ctx->cfg);
         free (ctx);
     }
 }
@@ -103,13 +173,22 @@ int flux_security_configure (flux_security_t *ctx, const char *pattern)
     struct cf_error cfe;
     int n;
     cf_t *cf = NULL;
+    flux_security_config_t *cfg;
+    char cachepath[PATH_MAX + 1];
+    const char *cache = NULL;
 
     if (!ctx) {
         errno = EINVAL;
         return -1;
     }
-    if (!pattern)
+    /* The installed configuration may be loaded from a compiled cache,
+     * which is only recompiled when the real user is root.
+     */
+    if (!pattern) {
         pattern = INSTALLED_CF_PATTERN;
+        if (cf_cache_path (pattern, cachepath, sizeof (cachepath)) == 0)
+            cache = cachepath;
+    }
     if (!(cf = cf_create ())) {
         security_error (ctx, NULL);
         return -1;
@@ -131,7 +210,11 @@ int flux_security_configure (flux_security_t *ctx, const char *pattern)
         goto error;
 
     }
-    if ((n = cf_update_glob (cf, pattern, &cfe)) < 0) {
+    if ((n = cf_update_glob_cached (cf,
+                                    pattern,
+                                    cache,
+                                    getuid () == 0 ? CF_CACHE_UPDATE : 0,
+                                    &cfe)) < 0) {
         security_error (ctx, "%s::%d: %s",
                         cfe.filename, cfe.lineno, cfe.errbuf);
         goto error;
@@ -141,8 +224,11 @@ int flux_security_configure (flux_security_t *ctx, const char *pattern)
         security_error (ctx, "pattern %s matched nothing", pattern);
         goto error;
     }
-    cf_destroy (ctx->config);
-    ctx->config = cf;
+    if (!(cfg = config_create (cf))) {
+        security_error (ctx, NULL);
+        goto error;
+    }
+    config_replace (ctx, cfg);
     return 0;
 error:
     cf_destroy (cf);
@@ -150,6 +236,46 @@ error:
     return -1;
 }
 
+flux_security_config_t *flux_security_config_get (flux_security_t *ctx)
+{
+    if (!ctx) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!ctx->cfg) {
+        errno = EINVAL;
+        security_error (ctx, "configuration has not been loaded");
+        return NULL;
+    }
+    /* Load credentials while this context holds the only reference,
+     * then freeze the object.  Preload failures are not reported here,
+     * so restore the context error they may have overwritten.
+     */
+    if (!ctx->cfg->shared) {
+        char error[sizeof (ctx->error)];
+        int errnum = ctx->errnum;
+
+        memcpy (error, ctx->error, sizeof (error));
+        sign_preload (ctx);
+        memcpy (ctx->error, error, sizeof (error));
+        ctx->errnum = errnum;
+        ctx->cfg->shared = true;
+    }
+    return flux_security_config_incref (ctx->cfg);
+}
+
+int flux_security_config_attach (flux_security_t *ctx,
+                                 flux_security_config_t *cfg)
+{
+    if (!ctx || !cfg || !cfg->shared) {
+        errno = EINVAL;
+        security_error (ctx, NULL);
+        return -1;
+    }
+    config_replace (ctx, flux_security_config_incref (cfg));
+    return 0;
+}
+
 int flux_security_aux_set (flux_security_t *ctx, const char *name,
                            void *data, flux_security_free_f freefun)
 {
@@ -190,14 +316,14 @@ const cf_t *security_get_config (flux_security_t *ctx, const char *key)
         security_error (ctx, NULL);
         return NULL;
     }
-    if (!ctx->config) {
+    if (!ctx->cfg) {
         errno = EINVAL;
         security_error (ctx, "configuration has not been loaded");
         return NULL;
     }
     if (key == NULL)
-        cf = ctx->config;
-    else if (!(cf = cf_get_in (ctx->config, key))) {
+        cf = ctx->cfg->config;
+    else if (!(cf = cf_get_in (ctx->cfg->config, key))) {
         security_error (ctx, "configuration object '%s' not found", key);
         return NULL;
     }
@@ -208,21 +334,57 @@ const cf_t *security_get_config (flux_security_t *ctx, const char *key)
 int security_set_config (flux_security_t *ctx, const cf_t *cf)
 {
     cf_t *new;
+    flux_security_config_t *cfg;
     if (!ctx || !cf) {
         errno = EINVAL;
         security_error (ctx, NULL);
         return (-1);
     }
-    if (!(new = cf_copy (cf))) {
+    if (!(new = cf_copy (cf)) || !(cfg = config_create (new))) {
+        cf_destroy (new);
         errno = ENOMEM;
         security_error (ctx, "Failed to copy config object");
         return (-1);
     }
-    cf_destroy (ctx->config);
-    ctx->config = new;
+    config_replace (ctx, cfg);
     return (0);
 }
 
+int security_set_cred (flux_security_t *ctx, const char *name,
+                       void *data, flux_security_free_f freefun)
+{
+    if (!ctx || !ctx->cfg || ctx->cfg->shared || !name) {
+        errno = EINVAL;
+        goto error;
+    }
+    if (aux_set (&ctx->cfg->cred, name, data, freefun) < 0)
+        goto error;
+    return 0;
+error:
+    security_error (ctx, NULL);
+    return -1;
+}
+
+const void *security_get_cred (flux_security_t *ctx, const char *name)
+{
+    if (!ctx || !ctx->cfg || !name)
+        return NULL;
+    return aux_get (ctx->cfg->cred, name);
+}
+
+void security_slot_set (flux_security_t *ctx, enum security_slot slot,
+                        void *data, flux_security_free_f freefun)
+{
+    slot_clear (&ctx->slot[slot]);
+    ctx->slot[slot].data = data;
+    ctx->slot[slot].freefun = freefun;
+}
+
+void *security_slot_get (flux_security_t *ctx, enum security_slot slot)
+{
+    return ctx->slot[slot].data;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -22,6 +22,8 @@ enum {
 
 typedef struct flux_security flux_security_t;
 
+typedef struct flux_security_config flux_security_config_t;
+
 typedef void (*flux_security_free_f)(void *arg);
 
 flux_security_t *flux_security_create (int flags);
@@ -37,6 +39,21 @@ int flux_security_aux_set (flux_security_t *ctx, const char *name,
 
 void *flux_security_aux_get (flux_security_t *ctx, const char *name);
 
+/* Return a reference to the configuration of 'ctx', after loading the
+ * signing credentials it names.  The object is immutable from then on,
+ * and may be attached to other contexts, including those used by other
+ * threads, with flux_security_config_attach(), in place of
+ * flux_security_configure().  Release with flux_security_config_decref().
+ * On error, NULL is returned and context error state is updated.
+ */
+flux_security_config_t *flux_security_config_get (flux_security_t *ctx);
+
+int flux_security_config_attach (flux_security_t *ctx,
+                                 flux_security_config_t *cfg);
+
+flux_security_config_t *flux_security_config_incref (flux_security_config_t *cfg);
+void flux_security_config_decref (flux_security_config_t *cfg);
+
 #ifdef __cplusplus
 }
 #endif
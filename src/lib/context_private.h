@@ -29,4 +29,41 @@ const cf_t *security_get_config (flux_security_t *ctx, const char *key);
  */
 int security_set_config (flux_security_t *ctx, const cf_t *cf);
 
+/* Store credential 'data' under 'name' in the configuration object, so it
+ * is shared by all contexts that attach it.  Only allowed until the object
+ * is shared by flux_security_config_get().  'data' must not be modified
+ * once stored.
+ */
+int security_set_cred (flux_security_t *ctx, const char *name,
+                       void *data, flux_security_free_f freefun);
+
+/* Retrieve credential stored under 'name', or NULL if none.
+ */
+const void *security_get_cred (flux_security_t *ctx, const char *name);
+
+/* Fixed per-context slots for library component state, so that the
+ * per-message path need not look it up by name with flux_security_aux_get().
+ */
+enum security_slot {
+    SECURITY_SLOT_SIGN,
+    SECURITY_SLOT_SIGN_MUNGE,
+    SECURITY_SLOT_SIGN_CURVE,
+    SECURITY_SLOT_COUNT,
+};
+
+/* Store 'data' in 'slot', destroying any previous value.
+ * 'freefun', if non-NULL, is called on 'data' when the context is destroyed.
+ */
+void security_slot_set (flux_security_t *ctx, enum security_slot slot,
+                        void *data, flux_security_free_f freefun);
+
+/* Retrieve the value stored in 'slot', or NULL if none.
+ */
+void *security_slot_get (flux_security_t *ctx, enum security_slot slot);
+
+/* Load credentials for the configured signing mechanisms (sign.c).
+ * Failures are not fatal; they are reported when the mechanism is used.
+ */
+void sign_preload (flux_security_t *ctx);
+
 #endif /* !_FLUX_SECURITY_CONTEXT_PRIVATE_H */
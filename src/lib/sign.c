@@ -15,24 +15,51 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sodium.h>
 
 #include "src/libutil/cf.h"
 #include "src/libutil/kv.h"
 #include "src/libutil/macros.h"
+#include "src/libutil/merkle.h"
+#include "src/libutil/sha256.h"
 
 #include "context.h"
 #include "context_private.h"
 #include "sign.h"
 #include "sign_mech.h"
 
+/* Length of a base64-encoded SHA256 digest (Merkle node or template),
+ * without NUL terminator, and the maximum number of digests in a proof
+ * for an int item count.
+ */
+#define DIGEST_B64LEN \
+    (sodium_base64_ENCODED_LEN (SHA256_BLOCK_SIZE, \
+                                sodium_base64_VARIANT_ORIGINAL) - 1)
+#define MERKLE_PROOF_MAX 32
+
 struct sign {
     const cf_t *config;
+    /* [sign] policy, compiled by sign_create().  Mechanisms are identified
+     * by their index in mech_table[].
+     */
+    int default_mech;
+    unsigned int allowed_mechs;
+    unsigned int ready_mechs;   // mechanisms whose init has succeeded
     void *wrapbuf;
     int wrapbufsz;
+    char **batch;
     void *unwrapbuf;
     int unwrapbufsz;
+    /* Most recently unwrapped delta template, see flux_sign_unwrap_delta().
+     */
+    char tmpl_digest[DIGEST_B64LEN + 1];
+    bool tmpl_verified;
+    int64_t tmpl_userid;
+    void *tmplbuf;
+    int tmplbufsz;
+    int tmpllen;
 };
 
 static const int64_t sign_version = 1;
@@ -44,15 +71,41 @@ static const struct cf_option sign_opts[] = {
     CF_OPTIONS_TABLE_END,
 };
 
-static const struct sign_mech *lookup_mech (const char *name)
+static const struct sign_mech *mech_table[] = {
+    &sign_mech_none,
+    &sign_mech_munge,
+    &sign_mech_curve,
+};
+#define MECH_COUNT ((int)(sizeof (mech_table) / sizeof (mech_table[0])))
+
+/* Return the mech_table[] index of mechanism 'name', or -1 if unknown.
+ */
+static int lookup_mech (const char *name)
 {
-    if (!strcmp (name, "none"))
-        return &sign_mech_none;
-    if (!strcmp (name, "munge"))
-        return &sign_mech_munge;
-    if (!strcmp (name, "curve"))
-        return &sign_mech_curve;
-    return NULL;
+    int i;
+
+    for (i = 0; i < MECH_COUNT; i++) {
+        if (!strcmp (name, mech_table[i]->name))
+            return i;
+    }
+    return -1;
+}
+
+/* Initialize mechanism 'index' once per sign context.
+ * Return mech on success, NULL on failure with error in ctx.
+ */
+static const struct sign_mech *mech_init (flux_security_t *ctx,
+                                          struct sign *sign,
+                                          int index)
+{
+    const struct sign_mech *mech = mech_table[index];
+
+    if (!(sign->ready_mechs & (1U << index))) {
+        if (mech->init && mech->init (ctx, sign->config) < 0)
+            return NULL;
+        sign->ready_mechs |= 1U << index;
+    }
+    return mech;
 }
 
 /* Grow *buf to newsz if *bufsz is less than that.
@@ -70,33 +123,55 @@ static int grow_buf (void **buf, int *bufsz, int newsz)
     return 0;
 }
 
+static void batch_destroy (char **batch)
+{
+    if (batch) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; batch[i] != NULL; i++)
+            free (batch[i]);
+        free (batch);
+        errno = saved_errno;
+    }
+}
+
 static void sign_destroy (struct sign *sign)
 {
     if (sign) {
         int saved_errno = errno;
         free (sign->wrapbuf);
+        batch_destroy (sign->batch);
+        free (sign->tmplbuf);
         free (sign->unwrapbuf);
         free (sign);
         errno = saved_errno;
     }
 }
 
-static bool validate_mech_array (flux_security_t *ctx, const cf_t *mechs)
+/* Convert the allowed-types array to a bitmap of mech_table[] indices.
+ * Return true on success, false on failure with error in ctx.
+ */
+static bool compile_mech_array (flux_security_t *ctx,
+                                const cf_t *mechs,
+                                unsigned int *bitmap)
 {
     int i;
     const cf_t *el;
+    int index;
 
+    *bitmap = 0;
     for (i = 0; (el = cf_get_at (mechs, i)) != NULL; i++) {
         if (cf_typeof (el) != CF_STRING) {
             errno = EINVAL;
             security_error (ctx, "sign: allowed-types[%d] not a string", i);
             return false;
         }
-        if (!lookup_mech (cf_string (el))) {
+        if ((index = lookup_mech (cf_string (el))) < 0) {
             errno = EINVAL;
             security_error (ctx, "sign: unknown mechanism=%s", cf_string (el));
             return false;
         }
+        *bitmap |= 1U << index;
     }
     if (i == 0) {
         errno = EINVAL;
@@ -134,11 +209,14 @@ static struct sign *sign_create (flux_security_t *ctx)
         goto error;
     }
     allowed_types = cf_get_in (sign->config, "allowed-types");
-    if (!validate_mech_array (ctx, allowed_types))
+    if (!compile_mech_array (ctx, allowed_types, &sign->allowed_mechs))
         goto error;
     default_type = cf_string (cf_get_in (sign->config, "default-type"));
-    if (!lookup_mech (default_type))
+    if ((sign->default_mech = lookup_mech (default_type)) < 0) {
+        errno = EINVAL;
+        security_error (ctx, "sign: unknown default-type=%s", default_type);
         goto error;
+    }
     return sign;
 error:
     sign_destroy (sign);
@@ -147,22 +225,34 @@ error:
 
 static struct sign *sign_init (flux_security_t *ctx)
 {
-    const char *auxname = "flux::sign";
-    struct sign *sign = flux_security_aux_get (ctx, auxname);
+    struct sign *sign = security_slot_get (ctx, SECURITY_SLOT_SIGN);
 
     if (!sign) {
         if (!(sign = sign_create (ctx)))
-            goto error_nomsg;
-        if (flux_security_aux_set (ctx, auxname, sign,
-                                   (flux_security_free_f)sign_destroy) < 0)
-            goto error;
+            return NULL;
+        security_slot_set (ctx,
+                           SECURITY_SLOT_SIGN,
+                           sign,
+                           (flux_security_free_f)sign_destroy);
     }
     return sign;
-error:
-    security_error (ctx, NULL);
-error_nomsg:
-    sign_destroy (sign);
-    return NULL;
+}
+
+void sign_preload (flux_security_t *ctx)
+{
+    struct sign *sign;
+    const struct sign_mech *mech;
+    int i;
+
+    if (!security_get_config (ctx, "sign") || !(sign = sign_init (ctx)))
+        return;
+    for (i = 0; i < MECH_COUNT; i++) {
+        if (!(sign->allowed_mechs & (1U << i))
+            || !mech_table[i]->preload
+            || !(mech = mech_init (ctx, sign, i)))
+            continue;
+        mech->preload (ctx);
+    }
 }
 
 /* Convert header to base64, storing in buf/bufsz, growing as needed.
@@ -212,6 +302,70 @@ static int payload_encode_cat (const void *pay, int paysz,
     return 0;
 }
 
+/* Append pre-encoded payload with "." prefix to buf/bufsz,
+ * growing as needed.  Result is NULL-terminated.
+ * This must be called after header_encode_cpy().
+ * Return 0 on success, -1 on failure with errno set.
+ */
+static int payload_cat (const char *pay, int paysz, void **buf, int *bufsz)
+{
+    int len = strlen (*buf);
+    char *dst;
+
+    if (grow_buf (buf, bufsz, paysz + len + 2) < 0)
+        return -1;
+    dst = (char *)*buf + len;
+    *dst++ = '.';
+    memcpy (dst, pay, paysz);
+    dst[paysz] = '\0';
+    return 0;
+}
+
+/* Return the value of base64 character 'c', or -1 if not in the alphabet.
+ */
+static int base64_value (char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+/* Check that 'src' of length 'srclen' is base64 that sodium_base642bin()
+ * would accept with sodium_base64_VARIANT_ORIGINAL, without decoding it:
+ * a multiple of 4 characters, at most two '=' padding characters at the
+ * end, and no bits set in the discarded part of the final character.
+ * Return decoded length on success, -1 on failure with errno set.
+ */
+static int payload_check_encoded (const char *src, size_t srclen)
+{
+    size_t pad = 0;
+    size_t i;
+    int v = 0;
+
+    if (srclen % 4 != 0 || srclen > INT_MAX)
+        goto inval;
+    while (pad < 2 && pad < srclen && src[srclen - pad - 1] == '=')
+        pad++;
+    for (i = 0; i < srclen - pad; i++) {
+        if ((v = base64_value (src[i])) < 0)
+            goto inval;
+    }
+    if ((pad == 1 && (v & 0x3)) || (pad == 2 && (v & 0xf)))
+        goto inval;
+    return srclen / 4 * 3 - pad;
+inval:
+    errno = EINVAL;
+    return -1;
+}
+
 /* Append pre-encoded (string) signature with "." prefix to buf/bufsz,
  * growing as needed.  Result is NULL-terminated.
  * This must be called after payload_encode_cat().
@@ -233,39 +387,35 @@ static int signature_cat (const char *sig, void **buf, int *bufsz)
     return 0;
 }
 
-const char *flux_sign_wrap_as (flux_security_t *ctx,
-                               int64_t userid,
-                               const void *pay, int paysz,
-                               const char *mech_type, int flags)
+/* Look up mechanism 'mech_type' (default if NULL) and initialize it.
+ * Return mech on success, NULL on failure with error in ctx.
+ */
+static const struct sign_mech *wrap_mech_init (flux_security_t *ctx,
+                                               struct sign *sign,
+                                               const char *mech_type)
 {
-    struct sign *sign;
-    struct kv *header = NULL;
-    char *sig = NULL;
-    const struct sign_mech *mech;
-    int saved_errno;
+    int index;
 
-    if (!ctx || userid < 0 || flags != 0
-        || paysz < 0 || (paysz > 0 && pay == NULL)) {
-        errno = EINVAL;
-        security_error (ctx, NULL);
-        return NULL;
-    }
-    if (!(sign = sign_init (ctx)))
-        return NULL;
     if (!mech_type)
-        mech_type = cf_string (cf_get_in (sign->config, "default-type"));
-    if (!(mech = lookup_mech (mech_type))) {
+        index = sign->default_mech;
+    else if ((index = lookup_mech (mech_type)) < 0) {
         errno = EINVAL;
         security_error (ctx, "sign-wrap: unknown mechanism: %s", mech_type);
         return NULL;
     }
-    if (mech->init) {
-        if (mech->init (ctx, sign->config) < 0)
-            return NULL;
-    }
+    return mech_init (ctx, sign, index);
+}
+
+/* Create security header, including mechanism-specific data, if any.
+ * Return header on success, NULL on failure with error in ctx.
+ */
+static struct kv *wrap_header_create (flux_security_t *ctx,
+                                      const struct sign_mech *mech,
+                                      int64_t userid,
+                                      int flags)
+{
+    struct kv *header;
 
-    /* Create security header.
-     */
     if (!(header = kv_create ()))
         goto error;
     if (kv_put (header, "version", KV_INT64, sign_version) < 0)
@@ -280,11 +430,61 @@ const char *flux_sign_wrap_as (flux_security_t *ctx,
         if (mech->prep (ctx, header, flags) < 0)
             goto error_msg;
     }
+    return header;
+error:
+    security_error (ctx, NULL);
+error_msg:
+    kv_destroy (header);
+    return NULL;
+}
+
+/* Serialize header and payload to HEADER.PAYLOAD in buf/bufsz.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+static int wrap_encode_cpy (struct kv *header,
+                            const void *pay, int paysz,
+                            int flags,
+                            void **buf, int *bufsz)
+{
+    if (header_encode_cpy (header, buf, bufsz) < 0)
+        return -1;
+    if ((flags & FLUX_SIGN_ENCODED))
+        return payload_cat (pay, paysz, buf, bufsz);
+    return payload_encode_cat (pay, paysz, buf, bufsz);
+}
+
+const char *flux_sign_wrap_as (flux_security_t *ctx,
+                               int64_t userid,
+                               const void *pay, int paysz,
+                               const char *mech_type, int flags)
+{
+    struct sign *sign;
+    struct kv *header = NULL;
+    char *sig = NULL;
+    const struct sign_mech *mech;
+    int saved_errno;
+
+    if (!ctx || userid < 0 || (flags & ~FLUX_SIGN_ENCODED)
+        || paysz < 0 || (paysz > 0 && pay == NULL)) {
+        errno = EINVAL;
+        security_error (ctx, NULL);
+        return NULL;
+    }
+    if ((flags & FLUX_SIGN_ENCODED)
+        && payload_check_encoded (pay, paysz) < 0) {
+        security_error (ctx, "sign-wrap: payload is not valid base64");
+        return NULL;
+    }
+    if (!(sign = sign_init (ctx)))
+        return NULL;
+    if (!(mech = wrap_mech_init (ctx, sign, mech_type)))
+        return NULL;
+    if (!(header = wrap_header_create (ctx, mech, userid, flags)))
+        return NULL;
     /* Serialize to HEADER.PAYLOAD.SIGNATURE
      */
-    if (header_encode_cpy (header, &sign->wrapbuf, &sign->wrapbufsz) < 0)
-        goto error;
-    if (payload_encode_cat (pay, paysz, &sign->wrapbuf, &sign->wrapbufsz) < 0)
+    if (wrap_encode_cpy (header, pay, paysz, flags,
+                         &sign->wrapbuf, &sign->wrapbufsz) < 0)
         goto error;
     if (!(sig = mech->sign (ctx, sign->wrapbuf, strlen (sign->wrapbuf), flags)))
         goto error_msg;
@@ -311,6 +511,196 @@ const char *flux_sign_wrap (flux_security_t *ctx,
     return flux_sign_wrap_as (ctx, getuid(), pay, paysz, mech_type, flags);
 }
 
+/* Encode Merkle root 'digest' as the string that is passed to mech->sign()
+ * and mech->verify() for a batch.  Since it contains no period, it cannot
+ * be mistaken for the HEADER.PAYLOAD input of an ordinary credential.
+ */
+static void batch_root_encode (const unsigned char *digest,
+                               char *root, size_t rootsz)
+{
+    sodium_bin2base64 (root, rootsz, digest, MERKLE_DIGEST_SIZE,
+                       sodium_base64_VARIANT_ORIGINAL);
+}
+
+/* Compute base64 SHA256 digest of 'tmpl' credential string,
+ * by which delta credentials refer to it.
+ */
+static void template_digest (const char *tmpl, char *buf, size_t bufsz)
+{
+    BYTE digest[SHA256_BLOCK_SIZE];
+    SHA256_CTX shx;
+
+    sha256_init (&shx);
+    sha256_update (&shx, (const BYTE *)tmpl, strlen (tmpl));
+    sha256_final (&shx, digest);
+    sodium_bin2base64 (buf, bufsz, digest, sizeof (digest),
+                       sodium_base64_VARIANT_ORIGINAL);
+}
+
+/* Append "." prefix, base64 inclusion proof for batch item 'index',
+ * and pre-encoded signature to buf/bufsz, growing as needed.
+ * This must be called after wrap_encode_cpy().
+ * Return 0 on success, -1 on failure with errno set.
+ */
+static int batch_signature_cat (struct merkle *m, int index, int count,
+                                const char *sig, void **buf, int *bufsz)
+{
+    unsigned char proof[MERKLE_PROOF_MAX * MERKLE_DIGEST_SIZE];
+    int n = merkle_proof_len (index, count);
+    int len = strlen (*buf);
+    char *dst;
+    int i;
+
+    if (merkle_proof (m, index, proof) < 0)
+        return -1;
+    if (grow_buf (buf, bufsz, len + 2 + n * DIGEST_B64LEN + strlen (sig)) < 0)
+        return -1;
+    dst = (char *)*buf + len;
+    *dst++ = '.';
+    for (i = 0; i < n; i++) {
+        sodium_bin2base64 (dst, DIGEST_B64LEN + 1,
+                           proof + i * MERKLE_DIGEST_SIZE, MERKLE_DIGEST_SIZE,
+                           sodium_base64_VARIANT_ORIGINAL);
+        dst += DIGEST_B64LEN;
+    }
+    strcpy (dst, sig);
+    return 0;
+}
+
+/* Sign a batch of payloads as described in flux_sign_wrap_batch().
+ * If 'tmpl' is non-NULL, each item header references it by digest.
+ */
+static const char **sign_wrap_batch (flux_security_t *ctx,
+                                     int64_t userid,
+                                     const char *tmpl,
+                                     const void *pay[], const int paysz[],
+                                     int count,
+                                     const char *mech_type, int flags)
+{
+    struct sign *sign;
+    struct kv *header = NULL;
+    struct merkle *m = NULL;
+    char **batch = NULL;
+    int bufsz;
+    char *sig = NULL;
+    unsigned char digest[MERKLE_DIGEST_SIZE];
+    char root[DIGEST_B64LEN + 1];
+    const struct sign_mech *mech;
+    int saved_errno;
+    int i;
+
+    if (!ctx || userid < 0 || (flags & ~FLUX_SIGN_ENCODED)
+        || count <= 0 || !pay || !paysz) {
+        errno = EINVAL;
+        security_error (ctx, NULL);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        if (paysz[i] < 0 || (paysz[i] > 0 && pay[i] == NULL)) {
+            errno = EINVAL;
+            security_error (ctx, NULL);
+            return NULL;
+        }
+        if ((flags & FLUX_SIGN_ENCODED)
+            && payload_check_encoded (pay[i], paysz[i]) < 0) {
+            security_error (ctx, "sign-wrap: payload is not valid base64");
+            return NULL;
+        }
+    }
+    if (!(sign = sign_init (ctx)))
+        return NULL;
+    if (!(mech = wrap_mech_init (ctx, sign, mech_type)))
+        return NULL;
+    if (!(header = wrap_header_create (ctx, mech, userid, flags)))
+        return NULL;
+    if (tmpl) {
+        char digest[DIGEST_B64LEN + 1];
+        template_digest (tmpl, digest, sizeof (digest));
+        if (kv_put (header, "template", KV_STRING, digest) < 0)
+            goto error;
+    }
+    if (kv_put (header, "merkle.count", KV_INT64, (int64_t)count) < 0)
+        goto error;
+    /* Serialize each item to HEADER.PAYLOAD, where HEADER differs only
+     * in merkle.index, and add its digest to the tree.
+     */
+    if (!(m = merkle_create (count))
+        || !(batch = calloc (count + 1, sizeof (batch[0]))))
+        goto error;
+    for (i = 0; i < count; i++) {
+        bufsz = 0;
+        if (kv_put (header, "merkle.index", KV_INT64, (int64_t)i) < 0
+            || wrap_encode_cpy (header, pay[i], paysz[i], flags,
+                                (void **)&batch[i], &bufsz) < 0
+            || merkle_set_leaf (m, i, batch[i], strlen (batch[i])) < 0)
+            goto error;
+    }
+    /* One mech signature over the root covers the whole batch.
+     */
+    if (merkle_build (m) < 0 || merkle_root (m, digest) < 0)
+        goto error;
+    batch_root_encode (digest, root, sizeof (root));
+    if (!(sig = mech->sign (ctx, root, strlen (root), flags)))
+        goto error_msg;
+    for (i = 0; i < count; i++) {
+        bufsz = strlen (batch[i]) + 1;
+        if (batch_signature_cat (m, i, count, sig,
+                                 (void **)&batch[i], &bufsz) < 0)
+            goto error;
+    }
+
+    batch_destroy (sign->batch);
+    sign->batch = batch;
+    free (sig);
+    merkle_destroy (m);
+    kv_destroy (header);
+    return (const char **)sign->batch;
+error:
+    security_error (ctx, NULL);
+error_msg:
+    saved_errno = errno;
+    batch_destroy (batch);
+    merkle_destroy (m);
+    kv_destroy (header);
+    free (sig);
+    errno = saved_errno;
+    return NULL;
+}
+
+const char **flux_sign_wrap_batch_as (flux_security_t *ctx,
+                                      int64_t userid,
+                                      const void *pay[], const int paysz[],
+                                      int count,
+                                      const char *mech_type, int flags)
+{
+    return sign_wrap_batch (ctx, userid, NULL, pay, paysz, count,
+                            mech_type, flags);
+}
+
+const char **flux_sign_wrap_batch (flux_security_t *ctx,
+                                   const void *pay[], const int paysz[],
+                                   int count,
+                                   const char *mech_type, int flags)
+{
+    return flux_sign_wrap_batch_as (ctx, getuid (), pay, paysz, count,
+                                    mech_type, flags);
+}
+
+const char **flux_sign_wrap_delta (flux_security_t *ctx,
+                                   const char *tmpl,
+                                   const void *delta[], const int deltasz[],
+                                   int count,
+                                   const char *mech_type, int flags)
+{
+    if (!tmpl) {
+        errno = EINVAL;
+        security_error (ctx, NULL);
+        return NULL;
+    }
+    return sign_wrap_batch (ctx, getuid (), tmpl, delta, deltasz, count,
+                            mech_type, flags);
+}
+
 /* Decode HEADER portion of HEADER.PAYLOAD.SIGNATURE
  * Return header on success or NULL on error with errno set.
  * Set 'endptr' to period ('.') delimiter following HEADER.
@@ -384,37 +774,125 @@ static int payload_decode_cpy (const char *input, void **buf, int *bufsz,
     return dstlen;
 }
 
-/* Return true if mechanism 'name' is present in the 'allowed' array.
+/* Decode PAYLOAD of length 'srclen' at 'src' in place, overwriting the
+ * base64 text with the decoded bytes.  Work through a small bounce buffer
+ * one chunk at a time, which is safe since the decoded output never grows
+ * past the input that has already been consumed.
+ * Return decoded length on success, -1 on failure with errno set.
  */
-static bool mech_allowed (const char *name, const cf_t *allowed)
+static int payload_decode_inplace (char *src, size_t srclen)
 {
+    const size_t chunksz = 1024; // base64 characters, multiple of 4
+    unsigned char chunk[BASE64_DECODE_SIZE (1024)];
+    size_t offset = 0;
+    size_t dstlen = 0;
+
+    while (offset < srclen) {
+        size_t n = srclen - offset;
+        size_t len;
+
+        if (n > chunksz)
+            n = chunksz;
+        /* Padding may only appear at the end of the final chunk.
+         */
+        if (offset + n < srclen && src[offset + n - 1] == '=') {
+            errno = EINVAL;
+            return -1;
+        }
+        if (sodium_base642bin (chunk, sizeof (chunk), src + offset, n,
+                               NULL, &len, NULL,
+                               sodium_base64_VARIANT_ORIGINAL) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy (src + dstlen, chunk, len);
+        dstlen += len;
+        offset += n;
+    }
+    return dstlen;
+}
+
+/* Verify batch item HEADER.PAYLOAD (input) with SIGNATURE consisting of
+ * the inclusion proof followed by the mechanism signature over the root.
+ * The proof length is determined by merkle.index and merkle.count, which
+ * are themselves covered by the item digest.
+ * Return 0 on success, -1 on failure with error in ctx.
+ */
+static int verify_batch (flux_security_t *ctx,
+                         const struct sign_mech *mech,
+                         const struct kv *header,
+                         const char *input, int inputsz,
+                         const char *signature, int flags)
+{
+    unsigned char proof[MERKLE_PROOF_MAX * MERKLE_DIGEST_SIZE];
+    unsigned char digest[MERKLE_DIGEST_SIZE];
+    char root[DIGEST_B64LEN + 1];
+    int64_t count;
+    int64_t index;
+    int n;
     int i;
-    const cf_t *el;
 
-    for (i = 0; (el = cf_get_at (allowed, i)) != NULL; i++) {
-        if (!strcmp (cf_string (el), name))
-            return true;
+    if (kv_get (header, "merkle.count", KV_INT64, &count) < 0
+        || kv_get (header, "merkle.index", KV_INT64, &index) < 0
+        || count <= 0 || count > INT_MAX || index < 0 || index >= count) {
+        errno = EINVAL;
+        security_error (ctx, "sign-unwrap: invalid batch header");
+        return -1;
+    }
+    n = merkle_proof_len (index, count);
+    if (strlen (signature) <= (size_t) n * DIGEST_B64LEN)
+        goto badproof;
+    for (i = 0; i < n; i++) {
+        size_t len;
+        if (sodium_base642bin (proof + i * MERKLE_DIGEST_SIZE,
+                               MERKLE_DIGEST_SIZE,
+                               signature + i * DIGEST_B64LEN,
+                               DIGEST_B64LEN,
+                               NULL, &len, NULL,
+                               sodium_base64_VARIANT_ORIGINAL) < 0
+            || len != MERKLE_DIGEST_SIZE)
+            goto badproof;
     }
-    return false;
+    if (merkle_proof_root (input, inputsz, index, count, proof, digest) < 0)
+        goto badproof;
+    batch_root_encode (digest, root, sizeof (root));
+    return mech->verify (ctx,
+                         header,
+                         root,
+                         strlen (root),
+                         signature + n * DIGEST_B64LEN,
+                         flags);
+badproof:
+    errno = EINVAL;
+    security_error (ctx, "sign-unwrap: batch inclusion proof error");
+    return -1;
 }
 
 static int sign_unwrap (flux_security_t *ctx,
                         const char *input,
                         const void **payload, int *payloadsz,
                         const char **mech_typep,
-                        int64_t *useridp, int flags, bool check_allowed)
+                        int64_t *useridp, int flags, bool check_allowed,
+                        const char *tmpl_digest)
 {
     struct sign *sign;
     struct kv *header;
-    int len;
+    int len = 0;
     int64_t userid;
     int64_t version;
     const char *mechanism;
+    const char *digest;
     const struct sign_mech *mech;
-    const cf_t *allowed_types;
+    int index;
     char *endptr;
+    const char *paystart;
+    const void *paybuf = NULL;
 
-    if (!ctx || !input || !(flags == 0 || flags == FLUX_SIGN_NOVERIFY)) {
+    if (!ctx || !input
+             || (flags & ~(FLUX_SIGN_NOVERIFY
+                           | FLUX_SIGN_INPLACE
+                           | FLUX_SIGN_ENCODED))
+             || ((flags & FLUX_SIGN_INPLACE) && (flags & FLUX_SIGN_ENCODED))) {
         errno = EINVAL;
         security_error (ctx, NULL);
         return -1;
@@ -444,15 +922,15 @@ static int sign_unwrap (flux_security_t *ctx,
         security_error (ctx, "sign-unwrap: header mechanism missing");
         goto error;
     }
-    if (!(mech = lookup_mech (mechanism))) {
+    if ((index = lookup_mech (mechanism)) < 0) {
         errno = EINVAL;
         security_error (ctx, "sign-unwrap: header mechanism=%s unknown",
                         mechanism);
         goto error;
     }
+    mech = mech_table[index];
     if (check_allowed) {
-        allowed_types = cf_get_in (sign->config, "allowed-types");
-        if (!mech_allowed (mechanism, allowed_types)) {
+        if (!(sign->allowed_mechs & (1U << index))) {
             errno = EINVAL;
             security_error (ctx, "sign-unwrap: header mechanism=%s not allowed",
                             mechanism);
@@ -464,30 +942,83 @@ static int sign_unwrap (flux_security_t *ctx,
         security_error (ctx, "sign-unwrap: header userid missing");
         goto error;
     }
-    /* Decode payload
+    /* A delta credential is only meaningful with its template, so it
+     * must not be accepted on its own, or with another template.
      */
-    len = payload_decode_cpy (endptr + 1, &sign->unwrapbuf, &sign->unwrapbufsz,
-                              &endptr);
-    if (len < 0) {
-        security_error (ctx, "sign-unwrap: payload decode error: %s",
-                        strerror (errno));
+    if (kv_get (header, "template", KV_STRING, &digest) == 0) {
+        if (!tmpl_digest || strcmp (digest, tmpl_digest) != 0) {
+            errno = EINVAL;
+            security_error (ctx, "sign-unwrap: template mismatch");
+            goto error;
+        }
+    }
+    else if (tmpl_digest) {
+        errno = EINVAL;
+        security_error (ctx, "sign-unwrap: header template missing");
         goto error;
     }
+    /* Decode payload.  If decoding in place, only locate it for now,
+     * since the signature covers the encoded form.  If the caller wants
+     * the encoded form, check it without decoding.
+     */
+    paystart = endptr + 1;
+    if ((flags & (FLUX_SIGN_INPLACE | FLUX_SIGN_ENCODED))) {
+        if (!(endptr = strchr (paystart, '.'))
+            || ((flags & FLUX_SIGN_ENCODED)
+                && payload_check_encoded (paystart, endptr - paystart) < 0)) {
+            errno = EINVAL;
+            security_error (ctx, "sign-unwrap: payload decode error: %s",
+                            strerror (errno));
+            goto error;
+        }
+        if ((flags & FLUX_SIGN_ENCODED)) {
+            len = endptr - paystart;
+            paybuf = paystart;
+        }
+    }
+    else {
+        len = payload_decode_cpy (paystart,
+                                  &sign->unwrapbuf,
+                                  &sign->unwrapbufsz,
+                                  &endptr);
+        if (len < 0) {
+            security_error (ctx, "sign-unwrap: payload decode error: %s",
+                            strerror (errno));
+            goto error;
+        }
+        paybuf = sign->unwrapbuf;
+    }
     /* Mech-specific verification (optional).
      */
     if (!(flags & FLUX_SIGN_NOVERIFY)) {
         int inputsz = endptr - input;
         const char *signature = endptr + 1;
-        if (mech->init) {
-            if (mech->init (ctx, sign->config) < 0)
+        if (!mech_init (ctx, sign, index))
+            goto error;
+        if (kv_get (header, "merkle.count", KV_INT64, NULL) == 0) {
+            if (verify_batch (ctx, mech, header, input, inputsz,
+                              signature, flags) < 0)
                 goto error;
         }
-        if (mech->verify (ctx, header, input, inputsz, signature, flags) < 0)
+        else if (mech->verify (ctx, header, input, inputsz,
+                               signature, flags) < 0)
             goto error;
     }
+    if ((flags & FLUX_SIGN_INPLACE)) {
+        /* N.B. const is cast away here: caller asserted 'input' is
+         * writable by setting FLUX_SIGN_INPLACE.
+         */
+        len = payload_decode_inplace ((char *)paystart, endptr - paystart);
+        if (len < 0) {
+            security_error (ctx, "sign-unwrap: payload decode error: %s",
+                            strerror (errno));
+            goto error;
+        }
+        paybuf = paystart;
+    }
     kv_destroy (header);
     if (payload)
-        *payload = (len > 0 ? sign->unwrapbuf : NULL);
+        *payload = (len > 0 ? paybuf : NULL);
     if (payloadsz)
         *payloadsz = len;
     if (mech_typep)
@@ -506,7 +1037,7 @@ int flux_sign_unwrap_anymech (flux_security_t *ctx, const char *input,
                               int64_t *userid, int flags)
 {
     return sign_unwrap (ctx, input, payload, payloadsz,
-                        mech_type, userid, flags, false);
+                        mech_type, userid, flags, false, NULL);
 }
 
 int flux_sign_unwrap (flux_security_t *ctx, const char *input,
@@ -514,7 +1045,81 @@ int flux_sign_unwrap (flux_security_t *ctx, const char *input,
                       int64_t *userid, int flags)
 {
     return sign_unwrap (ctx, input, payload, payloadsz,
-                        NULL, userid, flags, true);
+                        NULL, userid, flags, true, NULL);
+}
+
+/* Unwrap 'tmpl' and cache its payload and userid in 'sign', keyed
+ * by its digest.  A verified result is reused by later calls with the
+ * same template, so the template signature is checked only once.
+ * Return 0 on success, -1 on failure with error in ctx.
+ */
+static int template_cache (flux_security_t *ctx,
+                           struct sign *sign,
+                           const char *tmpl,
+                           const char *digest,
+                           int flags)
+{
+    const void *payload;
+    int payloadsz;
+    int64_t userid;
+
+    sign->tmpl_digest[0] = '\0';
+    if (sign_unwrap (ctx, tmpl, &payload, &payloadsz, NULL, &userid,
+                     flags & FLUX_SIGN_NOVERIFY, true, NULL) < 0)
+        return -1;
+    if (grow_buf (&sign->tmplbuf, &sign->tmplbufsz, payloadsz) < 0) {
+        security_error (ctx, NULL);
+        return -1;
+    }
+    if (payloadsz > 0)
+        memcpy (sign->tmplbuf, payload, payloadsz);
+    sign->tmpllen = payloadsz;
+    sign->tmpl_userid = userid;
+    sign->tmpl_verified = !(flags & FLUX_SIGN_NOVERIFY);
+    strcpy (sign->tmpl_digest, digest);
+    return 0;
+}
+
+int flux_sign_unwrap_delta (flux_security_t *ctx,
+                            const char *tmpl,
+                            const char *input,
+                            const void **template_payload,
+                            int *template_payloadsz,
+                            const void **payload, int *payloadsz,
+                            int64_t *useridp, int flags)
+{
+    struct sign *sign;
+    char digest[DIGEST_B64LEN + 1];
+    int64_t userid;
+
+    if (!ctx || !tmpl || !input) {
+        errno = EINVAL;
+        security_error (ctx, NULL);
+        return -1;
+    }
+    if (!(sign = sign_init (ctx)))
+        return -1;
+    template_digest (tmpl, digest, sizeof (digest));
+    if (strcmp (digest, sign->tmpl_digest) != 0
+        || (!sign->tmpl_verified && !(flags & FLUX_SIGN_NOVERIFY))) {
+        if (template_cache (ctx, sign, tmpl, digest, flags) < 0)
+            return -1;
+    }
+    if (sign_unwrap (ctx, input, payload, payloadsz, NULL, &userid,
+                     flags, true, digest) < 0)
+        return -1;
+    if (userid != sign->tmpl_userid) {
+        errno = EINVAL;
+        security_error (ctx, "sign-unwrap: template userid mismatch");
+        return -1;
+    }
+    if (template_payload)
+        *template_payload = (sign->tmpllen > 0 ? sign->tmplbuf : NULL);
+    if (template_payloadsz)
+        *template_payloadsz = sign->tmpllen;
+    if (useridp)
+        *useridp = userid;
+    return 0;
 }
 
 /*
@@ -51,12 +51,16 @@ extern "C" {
 
 enum {
     FLUX_SIGN_NOVERIFY = 1,   // flux_sign_unwrap() need not verify signature
+    FLUX_SIGN_INPLACE = 2,    // flux_sign_unwrap() decodes payload in 'input'
+    FLUX_SIGN_ENCODED = 4,    // payload is base64, not decoded/encoded
 };
 
 /* Sign payload/payloadsz, returning a NULL terminated string
  * suitable for feeding into flux_sign_unwrap().  The returned string
  * remains valid until the next call to flux_sign_wrap() or 'ctx'
- * is destroyed.  'flags' currently must be set to 0.
+ * is destroyed.  'flags' may be set to 0, or if 'payload' is already
+ * base64 encoded (sodium_base64_VARIANT_ORIGINAL), FLUX_SIGN_ENCODED,
+ * in which case it is checked and embedded without re-encoding.
  * If 'mech_type' is NULL, use the configured 'default-type'.
  * On error, NULL is returned and context error state is updated.
  */
@@ -75,14 +79,64 @@ const char *flux_sign_wrap_as (flux_security_t *ctx,
                                const char *mech_type,
                                int flags);
 
+/* Sign 'count' payloads pay[i]/paysz[i] as a batch, returning an array of
+ * 'count' NULL terminated strings (followed by a NULL entry), each suitable
+ * for feeding into flux_sign_unwrap() independently.  The signing mechanism
+ * is invoked once, over the root of a Merkle tree of the HEADER.PAYLOAD
+ * digests, and each credential carries the proof of its own inclusion.
+ * The returned array remains valid until the next call to
+ * flux_sign_wrap_batch() or 'ctx' is destroyed.  'flags' is as for
+ * flux_sign_wrap().
+ * On error, NULL is returned and context error state is updated.
+ */
+const char **flux_sign_wrap_batch (flux_security_t *ctx,
+                                   const void *pay[],
+                                   const int paysz[],
+                                   int count,
+                                   const char *mech_type,
+                                   int flags);
+
+/* Same as flux_sign_wrap_batch(), but allow userid to be explicitly set.
+ */
+const char **flux_sign_wrap_batch_as (flux_security_t *ctx,
+                                      int64_t userid,
+                                      const void *pay[],
+                                      const int paysz[],
+                                      int count,
+                                      const char *mech_type,
+                                      int flags);
 
-/* Given a NULL-terminated 'input' string generated by flux_sign_wrap(),
- * decode its contents and verify the signature.  If payload/payloadsz are
- * non-NULL, a pointer to the original payload and size is provided.
+/* Sign 'count' delta payloads delta[i]/deltasz[i] as a batch, as with
+ * flux_sign_wrap_batch(), but with each credential also referring by digest
+ * to 'tmpl', a credential from flux_sign_wrap() whose payload holds what
+ * the deltas have in common.  The template is then stored and sent once,
+ * and the deltas are unwrapped with flux_sign_unwrap_delta().
+ * On error, NULL is returned and context error state is updated.
+ */
+const char **flux_sign_wrap_delta (flux_security_t *ctx,
+                                   const char *tmpl,
+                                   const void *delta[],
+                                   const int deltasz[],
+                                   int count,
+                                   const char *mech_type,
+                                   int flags);
+
+/* Given a NULL-terminated 'input' string generated by flux_sign_wrap() or
+ * flux_sign_wrap_batch(), decode its contents and verify the signature.
+ * If payload/payloadsz are non-NULL, a pointer to the original payload
+ * and size is provided.
  * The payload remains valid until the next call to flux_sign_unwrap()
  * or 'ctx' is destroyed.  If 'userid' is non-NULL, the userid that
  * signed 'input' is returned.  'flags' may be set to 0, or if signature
  * validation is not required, it may be set to FLUX_SIGN_NOVERIFY.
+ * If FLUX_SIGN_INPLACE is set, the payload is decoded into 'input' itself
+ * rather than a buffer owned by 'ctx', and the returned payload points into
+ * 'input'.  'input' must then be writable memory and may no longer be a valid
+ * credential after the call (successful or not).
+ * If FLUX_SIGN_ENCODED is set, the payload is not decoded: the returned
+ * payload points to the base64 PAYLOAD segment within 'input' (not NULL
+ * terminated) and 'payloadsz' is its encoded length.  FLUX_SIGN_ENCODED
+ * and FLUX_SIGN_INPLACE may not be combined.
  * On success, 0 is returned; on error, -1 is returned and context error
  * state is updated.
  */
@@ -99,6 +153,25 @@ int flux_sign_unwrap_anymech (flux_security_t *ctx, const char *input,
                               const char **mech_type,
                               int64_t *userid, int flags);
 
+/* Unwrap delta credential 'input' from flux_sign_wrap_delta() together with
+ * the template 'tmpl' it refers to.  The template payload and size are assigned
+ * to 'template_payload'/'template_payloadsz', and remain valid until the
+ * next call to flux_sign_unwrap_delta() with a different template or 'ctx'
+ * is destroyed.  Other arguments are as for flux_sign_unwrap().  The result
+ * of verifying the template is cached in 'ctx', so a series of deltas that
+ * share a template only pay for the template signature once.
+ * Both must have been signed by the same userid.
+ * On success, 0 is returned; on error, -1 is returned and context error
+ * state is updated.
+ */
+int flux_sign_unwrap_delta (flux_security_t *ctx,
+                            const char *tmpl,
+                            const char *input,
+                            const void **template_payload,
+                            int *template_payloadsz,
+                            const void **payload, int *payloadsz,
+                            int64_t *userid, int flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,27 +25,51 @@
 #include "sign_mech.h"
 #include "src/libca/sigcert.h"
 #include "src/libca/ca.h"
+#include "src/libutil/sha256.h"
+
+/* Upper bound on the lifetime of a delegated signing cert, in seconds.
+ */
+static const int64_t delegate_ttl_max = 86400;
+
+/* Delegation most recently validated by op_verify(), identified by
+ * a digest over the long-term cert, delegated cert, and userid.
+ */
+struct delegation {
+    bool valid;
+    BYTE digest[SHA256_BLOCK_SIZE];
+    time_t xtime;
+    int64_t max_sign_ttl;   // -1 if not signed by CA
+};
 
 struct sign_curve {
     struct sigcert *cert;
     int64_t max_ttl;
     const cf_t *curve_config;
+    bool require_ca;
     struct ca *ca;
+    int64_t delegate_ttl;   // 0 if signing with long-term cert
+    struct sigcert *dcert;
+    int64_t dcert_userid;
+    time_t dcert_xtime;
+    struct delegation verified;
+    int64_t home_userid;    // user of home_certpath, -1 if none
+    char *home_certpath;
 };
 
 static const struct cf_option curve_opts[] = {
     {"require-ca",              CF_BOOL,        true},
     {"cert-path",               CF_STRING,      false},
+    {"delegate-ttl",            CF_INT64,       false},
     CF_OPTIONS_TABLE_END,
 };
 
-static const char *auxname = "flux::sign_curve";
-
 static void sc_destroy (struct sign_curve *sc)
 {
     if (sc) {
         ca_destroy (sc->ca);
+        sigcert_destroy (sc->dcert);
         sigcert_destroy (sc->cert);
+        free (sc->home_certpath);
         free (sc);
     }
 }
@@ -54,13 +78,14 @@ static void sc_destroy (struct sign_curve *sc)
  */
 static int op_init (flux_security_t *ctx, const cf_t *cf)
 {
-    struct sign_curve *sc = flux_security_aux_get (ctx, auxname);
+    struct sign_curve *sc = security_slot_get (ctx, SECURITY_SLOT_SIGN_CURVE);
     struct cf_error cfe;
 
     if (sc != NULL)
         return 0;
     if (!(sc = calloc (1, sizeof (*sc))))
         goto error;
+    sc->home_userid = -1;
     sc->max_ttl = cf_int64 (cf_get_in (cf, "max-ttl"));
     if (!(sc->curve_config = cf_get_in (cf, "curve"))) {
         security_error (ctx, "sign-curve-init: [sign.curve] config missing");
@@ -70,9 +95,21 @@ static int op_init (flux_security_t *ctx, const cf_t *cf)
         security_error (ctx, "sign-curve-init: [curve] config: %s", cfe.errbuf);
         goto error_nomsg;
     }
-    if (flux_security_aux_set (ctx, auxname, sc,
-                               (flux_security_free_f)sc_destroy) < 0)
-        goto error;
+    sc->require_ca = cf_bool (cf_get_in (sc->curve_config, "require-ca"));
+    if (cf_get_in (sc->curve_config, "delegate-ttl")) {
+        sc->delegate_ttl = cf_int64 (cf_get_in (sc->curve_config,
+                                                "delegate-ttl"));
+        if (sc->delegate_ttl <= 0 || sc->delegate_ttl > delegate_ttl_max
+                                  || sc->delegate_ttl < sc->max_ttl) {
+            security_error (ctx, "sign-curve-init: delegate-ttl must be"
+                            " between max-ttl and %d", (int)delegate_ttl_max);
+            goto error_nomsg;
+        }
+    }
+    security_slot_set (ctx,
+                       SECURITY_SLOT_SIGN_CURVE,
+                       sc,
+                       (flux_security_free_f)sc_destroy);
     return 0;
 error:
     security_error (ctx, NULL);
@@ -93,7 +130,7 @@ static int header_put_cert (struct kv *header, const char *prefix,
 
     if (sigcert_encode (cert, &buf, &bufsz) < 0)
         return -1;
-    if (!(kv = kv_decode (buf, bufsz)))
+    if (!(kv = kv_view (buf, bufsz)))
         return -1;
     if (kv_join (header, kv, prefix) < 0)
         goto error;
@@ -111,66 +148,171 @@ static struct sigcert *header_get_cert (const struct kv *header,
                                         const char *prefix)
 {
     struct kv *kv;
-    const char *buf;
-    int len;
     struct sigcert *cert;
 
-    if (!(kv = kv_split (header, prefix)))
+    if (!(kv = kv_view_prefix (header, prefix)))
         return NULL;
-    if (kv_encode (kv, &buf, &len) < 0)
-        goto error;
-    if (!(cert = sigcert_decode (buf, len)))
-        goto error;
+    cert = sigcert_decode_kv (kv);
     kv_destroy (kv);
     return cert;
+}
+
+/* Create a short-lived signing cert for 'userid', valid until 'xtime',
+ * and certify it with the long-term 'cert'.
+ * Return cert on success, NULL on error with errno set.
+ */
+static struct sigcert *delegate_create (const struct sigcert *cert,
+                                        int64_t userid,
+                                        time_t ctime,
+                                        time_t xtime)
+{
+    struct sigcert *dcert;
+
+    if (!(dcert = sigcert_create ()))
+        return NULL;
+    if (sigcert_meta_set (dcert, "userid", SM_INT64, userid) < 0
+        || sigcert_meta_set (dcert, "ctime", SM_TIMESTAMP, ctime) < 0
+        || sigcert_meta_set (dcert, "xtime", SM_TIMESTAMP, xtime) < 0
+        || sigcert_sign_cert (cert, dcert) < 0) {
+        sigcert_destroy (dcert);
+        return NULL;
+    }
+    return dcert;
+}
+
+/* Load the signing cert named by configuration.
+ * Return cert on success, NULL on failure with error in ctx.
+ */
+static struct sigcert *cert_load (flux_security_t *ctx,
+                                  const cf_t *curve_config)
+{
+    char buf[PATH_MAX + 1];
+    int bufsz = sizeof (buf);
+    const char *certpath;
+    struct sigcert *cert;
+    const cf_t *entry;
+
+    if ((entry = cf_get_in (curve_config, "cert-path"))) // test
+        certpath = cf_string (entry);
+    else {
+        uid_t real_uid = getuid ();
+        struct passwd *pw = getpwuid (real_uid);
+        if (!pw || snprintf (buf, bufsz, "%s/.flux/curve/sig",
+                                                pw->pw_dir) >= bufsz) {
+            errno = EINVAL;
+            security_error (ctx, NULL);
+            return NULL;
+        }
+        certpath = buf;
+    }
+    if (!(cert = sigcert_load (certpath, true))) {
+        security_error (ctx, "sign-curve-prep: load %s: %s",
+                        certpath, strerror (errno));
+        return NULL;
+    }
+    return cert;
+}
+
+/* Load the CA context from configuration, using the CA cert shared in
+ * the configuration object if there is one.
+ * Return ca on success, NULL on failure with error in 'e'.
+ */
+static struct ca *ca_context_load (flux_security_t *ctx,
+                                   const cf_t *ca_config,
+                                   ca_error_t e)
+{
+    const struct sigcert *shared = security_get_cred (ctx, "curve.ca-cert");
+    struct ca *ca;
+
+    if (!(ca = ca_create (ca_config, e)))
+        return NULL;
+    if (shared) {
+        if (ca_set_cert (ca, shared, e) < 0)
+            goto error;
+    }
+    else if (ca_load (ca, false, e) < 0)
+        goto error;
+    return ca;
 error:
-    kv_destroy (kv);
+    ca_destroy (ca);
     return NULL;
 }
 
+/* preload - load the CA cert, if required, into the configuration
+ * object so other contexts need not read it.  The signing cert holds
+ * the secret key, so each context still loads it on first use.
+ */
+static void op_preload (flux_security_t *ctx)
+{
+    struct sign_curve *sc = security_slot_get (ctx, SECURITY_SLOT_SIGN_CURVE);
+    const cf_t *ca_config;
+    struct sigcert *cert;
+    ca_error_t e;
+
+    assert (sc != NULL);
+
+    if (sc->require_ca
+        && (ca_config = security_get_config (ctx, "ca"))) {
+        struct ca *ca;
+        const struct sigcert *ca_cert;
+
+        if ((ca = ca_context_load (ctx, ca_config, e))
+            && (ca_cert = ca_get_cert (ca, e))
+            && (cert = sigcert_copy (ca_cert))
+            && security_set_cred (ctx, "curve.ca-cert", cert,
+                                  (flux_security_free_f)sigcert_destroy) < 0)
+            sigcert_destroy (cert);
+        ca_destroy (ca);
+    }
+}
+
 /* prep - add to security header
  *   curve.cert    signer's public certificate
+ *   curve.dcert   delegated public certificate (if delegate-ttl is set)
  *   curve.ctime   signature creation time
  *   curve.xtime   signature expiration time
  */
 static int op_prep (flux_security_t *ctx, struct kv *header, int flags)
 {
-    struct sign_curve *sc = flux_security_aux_get (ctx, auxname);
+    struct sign_curve *sc = security_slot_get (ctx, SECURITY_SLOT_SIGN_CURVE);
     time_t ctime;
     time_t xtime;
 
     assert (sc != NULL);
 
     if (!sc->cert) { // load signing cert on first use
-        char buf[PATH_MAX + 1];
-        int bufsz = sizeof (buf);
-        const char *certpath;
-        struct sigcert *cert;
-        const cf_t *entry;
-        if ((entry = cf_get_in (sc->curve_config, "cert-path"))) // test
-            certpath = cf_string (entry);
-        else {
-            uid_t real_uid = getuid ();
-            struct passwd *pw = getpwuid (real_uid);
-            if (!pw || snprintf (buf, bufsz, "%s/.flux/curve/sig",
-                                                    pw->pw_dir) >= bufsz) {
-                errno = EINVAL;
-                goto error;
-            }
-            certpath = buf;
-        }
-        if (!(cert = sigcert_load (certpath, true))) {
-            security_error (ctx, "sign-curve-prep: load %s: %s",
-                            certpath, strerror (errno));
+        if (!(sc->cert = cert_load (ctx, sc->curve_config)))
             goto error_nomsg;
-        }
-        sigcert_destroy (sc->cert);
-        sc->cert = cert;
     }
     if ((ctime = time (NULL)) == (time_t)-1)
         goto error;
     xtime = ctime + sc->max_ttl;
+    /* Replace the delegated cert if it would expire before this signature.
+     */
+    if (sc->delegate_ttl > 0) {
+        int64_t userid;
+
+        if (kv_get (header, "userid", KV_INT64, &userid) < 0)
+            goto error;
+        if (!sc->dcert || sc->dcert_xtime < xtime
+                       || sc->dcert_userid != userid) {
+            struct sigcert *dcert;
+
+            if (!(dcert = delegate_create (sc->cert,
+                                           userid,
+                                           ctime,
+                                           ctime + sc->delegate_ttl)))
+                goto error;
+            sigcert_destroy (sc->dcert);
+            sc->dcert = dcert;
+            sc->dcert_userid = userid;
+            sc->dcert_xtime = ctime + sc->delegate_ttl;
+        }
+    }
     if (header_put_cert (header, "curve.cert.", sc->cert) < 0
+            || (sc->dcert && header_put_cert (header,
+                                              "curve.dcert.",
+                                              sc->dcert) < 0)
             || kv_put (header, "curve.ctime", KV_TIMESTAMP, ctime) < 0
             || kv_put (header, "curve.xtime", KV_TIMESTAMP, xtime) < 0)
         goto error;
@@ -181,39 +323,63 @@ error_nomsg:
     return -1;
 }
 
-/* sign - sign HEADER.PAYLOAD
+/* sign - sign HEADER.PAYLOAD with the delegated cert, if any,
+ * otherwise with the long-term cert.
  */
 static char *op_sign (flux_security_t *ctx,
                       const char *input, int inputsz, int flags)
 {
-    struct sign_curve *sc = flux_security_aux_get (ctx, auxname);
+    struct sign_curve *sc = security_slot_get (ctx, SECURITY_SLOT_SIGN_CURVE);
     char *sign;
 
     assert (sc != NULL);
 
-    if (!(sign = sigcert_sign_detached (sc->cert, (uint8_t *)input, inputsz))) {
+    if (!(sign = sigcert_sign_detached (sc->dcert ? sc->dcert : sc->cert,
+                                        (uint8_t *)input,
+                                        inputsz))) {
         security_error (ctx, "sign-curve: %s", strerror (errno));
         return NULL;
     }
     return sign;
 }
 
+/* Return the path of the cert in userid's home directory.  The path is
+ * cached for the most recent userid, so verifying many signatures from
+ * the same user costs one passwd lookup.
+ * Return path on success, NULL on failure.
+ */
+static const char *home_certpath (struct sign_curve *sc, int64_t userid)
+{
+    char buf[PATH_MAX + 1];
+    int bufsz = sizeof (buf);
+    struct passwd *pw;
+    char *path;
+
+    if (sc->home_certpath && sc->home_userid == userid)
+        return sc->home_certpath;
+    if (!(pw = getpwuid (userid))
+        || snprintf (buf, bufsz, "%s/.flux/curve/sig", pw->pw_dir) >= bufsz
+        || !(path = strdup (buf)))
+        return NULL;
+    free (sc->home_certpath);
+    sc->home_certpath = path;
+    sc->home_userid = userid;
+    return path;
+}
+
 /* Verify that cert authenticates userid, because it exists in that user's
  * home directory.
  */
 static int verify_cert_home (flux_security_t *ctx, struct sign_curve *sc,
                              const struct sigcert *cert, int64_t userid)
 {
-    char buf[PATH_MAX + 1] = "unknown user";
-    int bufsz = sizeof (buf);
-    struct passwd *pw = getpwuid (userid);
+    const char *path = home_certpath (sc, userid);
     struct sigcert *ucert = NULL;
 
-    if (!pw || snprintf (buf, bufsz, "%s/.flux/curve/sig", pw->pw_dir) >= bufsz
-                                || (!(ucert = sigcert_load (buf, false)))) {
+    if (!path || !(ucert = sigcert_load (path, false))) {
         errno = EINVAL;
         security_error (ctx, "sign-curve-verify: error loading cert from %s",
-                        buf);
+                        path ? path : "unknown user");
         return -1;
     }
     if (!sigcert_equal (ucert, cert)) {
@@ -227,11 +393,12 @@ static int verify_cert_home (flux_security_t *ctx, struct sign_curve *sc,
 }
 
 /* Verify that cert authenticates userid, because it was signed by the CA,
- * and the cert contains the same userid.
+ * and the cert contains the same userid.  Set 'max_sign_ttl' to the
+ * limit the cert places on signature age.
  */
 static int verify_cert_ca (flux_security_t *ctx, struct sign_curve *sc,
                            const struct sigcert *cert, int64_t userid,
-                           time_t now, time_t ctime)
+                           int64_t *max_sign_ttl)
 {
     int64_t cert_max_sign_ttl;
     int64_t cert_userid;
@@ -245,9 +412,8 @@ static int verify_cert_ca (flux_security_t *ctx, struct sign_curve *sc,
             security_error (ctx, "sign-curve-verify: [ca] config missing");
             return -1;
         }
-        if (!(ca = ca_create (ca_config, e)) || ca_load (ca, false, e)) {
+        if (!(ca = ca_context_load (ctx, ca_config, e))) {
             security_error (ctx, "sign-curve-verify: ca: %s", e);
-            ca_destroy (ca);
             return -1;
         }
         sc->ca = ca;
@@ -260,15 +426,111 @@ static int verify_cert_ca (flux_security_t *ctx, struct sign_curve *sc,
         security_error (ctx, "sign-curve-verify: ca: userid mismatch");
         return -1;
     }
-    if (ctime + cert_max_sign_ttl < now) {
-        security_error (ctx, "sign-curve-verify: ca: max-sign-ttl exceeded");
+    *max_sign_ttl = cert_max_sign_ttl;
+    return 0;
+}
+
+/* Verify that cert authenticates userid by one of the two methods above,
+ * depending on configuration.  Set 'max_sign_ttl' to the limit on
+ * signature age imposed by the CA, or -1 if there is none.
+ */
+static int verify_cert_userid (flux_security_t *ctx, struct sign_curve *sc,
+                               const struct sigcert *cert, int64_t userid,
+                               int64_t *max_sign_ttl)
+{
+    if (sc->require_ca)
+        return verify_cert_ca (ctx, sc, cert, userid, max_sign_ttl);
+    *max_sign_ttl = -1;
+    return verify_cert_home (ctx, sc, cert, userid);
+}
+
+static int digest_update_cert (SHA256_CTX *shx, const struct sigcert *cert)
+{
+    const char *buf;
+    int len;
+
+    if (sigcert_encode (cert, &buf, &len) < 0)
+        return -1;
+    sha256_update (shx, (const BYTE *)&len, sizeof (len));
+    sha256_update (shx, (const BYTE *)buf, len);
+    return 0;
+}
+
+/* Verify that delegated cert 'dcert' was certified for 'userid' by
+ * long-term 'cert', that cert authenticates userid, and that the
+ * delegation has not expired.  The result is cached, so subsequent
+ * messages carrying the same delegation only need the expiration check.
+ * Set 'max_sign_ttl' as for verify_cert_userid().
+ */
+static int verify_delegation (flux_security_t *ctx, struct sign_curve *sc,
+                              const struct sigcert *cert,
+                              const struct sigcert *dcert,
+                              int64_t userid, time_t now,
+                              int64_t *max_sign_ttl)
+{
+    BYTE digest[SHA256_BLOCK_SIZE];
+    SHA256_CTX shx;
+    int64_t duserid;
+    time_t dctime;
+    time_t dxtime;
+
+    sha256_init (&shx);
+    if (digest_update_cert (&shx, cert) < 0
+        || digest_update_cert (&shx, dcert) < 0) {
+        security_error (ctx, "sign-curve-verify: error encoding"
+                        " delegation for digest");
         return -1;
     }
+    sha256_update (&shx, (const BYTE *)&userid, sizeof (userid));
+    sha256_final (&shx, digest);
+
+    if (sc->verified.valid
+        && memcmp (sc->verified.digest, digest, sizeof (digest)) == 0) {
+        if (sc->verified.xtime < now) {
+            errno = EINVAL;
+            security_error (ctx, "sign-curve-verify: delegation expired");
+            return -1;
+        }
+        *max_sign_ttl = sc->verified.max_sign_ttl;
+        return 0;
+    }
+    if (sigcert_verify_cert (cert, dcert) < 0) {
+        errno = EINVAL;
+        security_error (ctx, "sign-curve-verify: delegation"
+                        " verification failure");
+        return -1;
+    }
+    if (sigcert_meta_get (dcert, "userid", SM_INT64, &duserid) < 0
+        || sigcert_meta_get (dcert, "ctime", SM_TIMESTAMP, &dctime) < 0
+        || sigcert_meta_get (dcert, "xtime", SM_TIMESTAMP, &dxtime) < 0) {
+        errno = EINVAL;
+        security_error (ctx, "sign-curve-verify: incomplete delegation");
+        return -1;
+    }
+    if (duserid != userid) {
+        errno = EINVAL;
+        security_error (ctx, "sign-curve-verify: delegation userid mismatch");
+        return -1;
+    }
+    if (dxtime - dctime > delegate_ttl_max || dctime > now || dxtime < now) {
+        errno = EINVAL;
+        security_error (ctx, "sign-curve-verify: delegation expired"
+                        " or lifetime invalid");
+        return -1;
+    }
+    if (verify_cert_userid (ctx, sc, cert, userid, max_sign_ttl) < 0)
+        return -1;
+    sc->verified.valid = true;
+    memcpy (sc->verified.digest, digest, sizeof (digest));
+    sc->verified.xtime = dxtime;
+    sc->verified.max_sign_ttl = *max_sign_ttl;
     return 0;
 }
 
 /* verify - verify HEADER.PAYLOAD.SIGNATURE, e.g.
- * - enclosed cert created SIGNATURE over HEADER.PAYLOAD
+ * - enclosed cert (or delegated cert, if present) created SIGNATURE
+ *   over HEADER.PAYLOAD
+ * - delegated cert, if present, was certified by enclosed cert
  * - enclosed cert authenticates header userid (two methods)
  * - xtime has not passed
  * - ctime plus configured max-ttl has not passed
@@ -277,12 +539,14 @@ static int op_verify (flux_security_t *ctx, const struct kv *header,
                       const char *input, int inputsz,
                       const char *signature, int flags)
 {
-    struct sign_curve *sc = flux_security_aux_get (ctx, auxname);
+    struct sign_curve *sc = security_slot_get (ctx, SECURITY_SLOT_SIGN_CURVE);
     struct sigcert *cert = NULL;
+    struct sigcert *dcert = NULL;
     time_t now;
     time_t ctime;
     time_t xtime;
     int64_t userid;
+    int64_t max_sign_ttl;
 
     assert (sc != NULL);
 
@@ -296,19 +560,29 @@ static int op_verify (flux_security_t *ctx, const struct kv *header,
         security_error (ctx, "sign-curve-verify: incomplete header");
         goto error_nomsg;
     }
-    if (sigcert_verify_detached (cert, signature,
+    if (kv_get (header, "curve.dcert.curve.public-key", KV_STRING, NULL) == 0
+        && !(dcert = header_get_cert (header, "curve.dcert."))) {
+        security_error (ctx, "sign-curve-verify: incomplete header");
+        goto error_nomsg;
+    }
+    if (sigcert_verify_detached (dcert ? dcert : cert, signature,
                                  (uint8_t *)input, inputsz) < 0) {
         security_error (ctx, "sign-curve-verify: verification failure");
         goto error_nomsg;
     }
-    if (cf_bool (cf_get_in (sc->curve_config, "require-ca"))) {
-        if (verify_cert_ca (ctx, sc, cert, userid, now, ctime) < 0)
+    if (dcert) {
+        if (verify_delegation (ctx, sc, cert, dcert, userid, now,
+                               &max_sign_ttl) < 0)
             goto error_nomsg;
     }
-    else {          // require-ca = false
-        if (verify_cert_home (ctx, sc, cert, userid) < 0)
+    else {
+        if (verify_cert_userid (ctx, sc, cert, userid, &max_sign_ttl) < 0)
             goto error_nomsg;
     }
+    if (max_sign_ttl >= 0 && ctime + max_sign_ttl < now) {
+        security_error (ctx, "sign-curve-verify: ca: max-sign-ttl exceeded");
+        goto error_nomsg;
+    }
     if (xtime < now || ctime + sc->max_ttl < now) {
         errno = EINVAL;
         security_error (ctx, "sign-curve-verify: xtime or max-ttl exceeded");
@@ -319,11 +593,13 @@ static int op_verify (flux_security_t *ctx, const struct kv *header,
         security_error (ctx, "sign-curve-verify: ctime is in the future");
         goto error_nomsg;
     }
+    sigcert_destroy (dcert);
     sigcert_destroy (cert);
     return 0;
 error:
     security_error (ctx, NULL);
 error_nomsg:
+    sigcert_destroy (dcert);
     sigcert_destroy (cert);
     return -1;
 }
@@ -331,6 +607,7 @@ error_nomsg:
 const struct sign_mech sign_mech_curve = {
     .name = "curve",
     .init = op_init,
+    .preload = op_preload,
     .prep = op_prep,
     .sign = op_sign,
     .verify = op_verify,
@@ -32,6 +32,16 @@
  */
 typedef int (*sign_mech_init_f)(flux_security_t *ctx, const cf_t *cf);
 
+/* preload (optional)
+ * Called by flux_security_config_get(), after init, if defined.  Load any
+ * public credentials that would otherwise be read on first use, and store
+ * them in the configuration object with security_set_cred(), so they are
+ * shared by all contexts the configuration is attached to.  Secret keys
+ * must not be preloaded.  Failure is not fatal, the mechanism falls back
+ * to loading them itself, and any context error set here is discarded.
+ */
+typedef void (*sign_mech_preload_f)(flux_security_t *ctx);
+
 /* prep (optional)
  * Called before signing, if defined.  Populate 'struct kv' header with
  * mechanism specific data before HEADER is serialized for signing.
@@ -65,6 +75,7 @@ typedef int (*sign_mech_verify_f)(flux_security_t *ctx,
 struct sign_mech {
     const char *name;
     sign_mech_init_f init;
+    sign_mech_preload_f preload;
     sign_mech_prep_f prep;
     sign_mech_sign_f sign;
     sign_mech_verify_f verify;
@@ -44,8 +44,6 @@ static const struct cf_option munge_opts[] = {
     CF_OPTIONS_TABLE_END,
 };
 
-static const char *auxname = "flux::sign_munge";
-
 static void sm_destroy (struct sign_munge *sm)
 {
     if (sm) {
@@ -59,7 +57,7 @@ static void sm_destroy (struct sign_munge *sm)
 
 static int op_init (flux_security_t *ctx, const cf_t *cf)
 {
-    struct sign_munge *sm = flux_security_aux_get (ctx, auxname);
+    struct sign_munge *sm = security_slot_get (ctx, SECURITY_SLOT_SIGN_MUNGE);
     const cf_t *munge_config;
     const char *socket_path = NULL;
 
@@ -69,9 +67,6 @@ static int op_init (flux_security_t *ctx, const cf_t *cf)
         goto error;
     if (!(sm->munge = munge_ctx_create ()))
         goto error;
-    if (flux_security_aux_set (ctx, auxname, sm,
-                               (flux_security_free_f)sm_destroy) < 0)
-        goto error;
     sm->max_ttl = cf_int64 (cf_get_in (cf, "max-ttl"));
     if ((munge_config = cf_get_in (cf, "munge"))) {
         struct cf_error cfe;
@@ -92,6 +87,10 @@ static int op_init (flux_security_t *ctx, const cf_t *cf)
             goto error_nomsg;
         }
     }
+    security_slot_set (ctx,
+                       SECURITY_SLOT_SIGN_MUNGE,
+                       sm,
+                       (flux_security_free_f)sm_destroy);
     return 0;
 error:
     security_error (ctx, NULL);
@@ -107,7 +106,7 @@ error_nomsg:
 static char *op_sign (flux_security_t *ctx,
                       const char *input, int inputsz, int flags)
 {
-    struct sign_munge *sm = flux_security_aux_get (ctx, auxname);
+    struct sign_munge *sm = security_slot_get (ctx, SECURITY_SLOT_SIGN_MUNGE);
     BYTE digest[SHA256_BLOCK_SIZE + 1] = { HASH_TYPE_SHA256 };
     SHA256_CTX shx;
     char *cred;
@@ -137,7 +136,7 @@ static int op_verify (flux_security_t *ctx, const struct kv *header,
                       const char *input, int inputsz,
                       const char *signature, int flags)
 {
-    struct sign_munge *sm = flux_security_aux_get (ctx, auxname);
+    struct sign_munge *sm = security_slot_get (ctx, SECURITY_SLOT_SIGN_MUNGE);
     munge_err_t e;
     char *indigest = NULL;
     int indigestsz = 0;
@@ -213,6 +212,7 @@ error:
 const struct sign_mech sign_mech_munge = {
     .name = "munge",
     .init = op_init,
+    .preload = NULL,
     .prep = NULL,
     .sign = op_sign,
     .verify = op_verify,
@@ -59,6 +59,7 @@ static int op_verify (flux_security_t *ctx, const struct kv *header,
 const struct sign_mech sign_mech_none = {
     .name = "none",
     .init = NULL,
+    .preload = NULL,
     .prep = NULL,
     .sign = op_sign,
     .verify = op_verify,
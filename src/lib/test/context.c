@@ -121,6 +121,107 @@ void test_set_config (void)
     flux_security_destroy (ctx);
 }
 
+void test_shared_config (void)
+{
+    flux_security_t *ctx1;
+    flux_security_t *ctx2;
+    flux_security_config_t *cfg;
+    const cf_t *cf;
+    char *s;
+    cf_t *conf_cf;
+
+    if (!(ctx1 = flux_security_create (0)) || !(ctx2 = flux_security_create (0)))
+        BAIL_OUT ("flux_security_create failed");
+    if (!(conf_cf = cf_create ()) || cf_update (conf_cf, conf, strlen (conf),
+                                                NULL) < 0
+                                  || security_set_config (ctx1, conf_cf) < 0)
+        BAIL_OUT ("failed to set config");
+    cf_destroy (conf_cf);
+    if (!(s = strdup ("hello")))
+        BAIL_OUT ("strdup failed");
+
+    errno = 0;
+    ok (flux_security_config_get (ctx2) == NULL && errno == EINVAL,
+        "flux_security_config_get without loading config fails with EINVAL");
+
+    ok (security_set_cred (ctx1, "foo", s, free) == 0,
+        "security_set_cred works before config is shared");
+    ok (security_get_cred (ctx1, "foo") == s,
+        "security_get_cred retrieves data");
+    ok (security_get_cred (ctx1, "bar") == NULL,
+        "security_get_cred name=unknown returns NULL");
+
+    ok ((cfg = flux_security_config_get (ctx1)) != NULL,
+        "flux_security_config_get works");
+    errno = 0;
+    ok (security_set_cred (ctx1, "bar", s, NULL) < 0 && errno == EINVAL,
+        "security_set_cred fails with EINVAL once config is shared");
+
+    ok (flux_security_config_attach (ctx2, cfg) == 0,
+        "flux_security_config_attach works");
+    cf = security_get_config (ctx2, "foo");
+    ok (cf != NULL && cf == security_get_config (ctx1, "foo"),
+        "contexts share the same config object");
+    ok (security_get_cred (ctx2, "foo") == s,
+        "contexts share the same credentials");
+
+    flux_security_config_decref (cfg);
+    flux_security_destroy (ctx1);
+    cf = security_get_config (ctx2, "foo");
+    ok (cf != NULL && cf_int64 (cf) == 42
+        && security_get_cred (ctx2, "foo") == s,
+        "config remains valid after other references are dropped");
+
+    errno = 0;
+    ok (flux_security_config_attach (NULL, cfg) < 0 && errno == EINVAL,
+        "flux_security_config_attach ctx=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_security_config_attach (ctx2, NULL) < 0 && errno == EINVAL,
+        "flux_security_config_attach cfg=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_security_config_get (NULL) == NULL && errno == EINVAL,
+        "flux_security_config_get ctx=NULL fails with EINVAL");
+    lives_ok ({flux_security_config_decref (NULL);},
+        "flux_security_config_decref cfg=NULL doesn't crash");
+
+    flux_security_destroy (ctx2);
+}
+
+/* A [sign] table with no [sign.curve] table, so the curve
+ * mechanism fails to initialize during preload.
+ */
+const char *bad_curve_conf = "[sign]\n"
+                             "max-ttl = 30\n"
+                             "default-type = \"curve\"\n"
+                             "allowed-types = [ \"curve\" ]\n";
+
+void test_preload_error (void)
+{
+    flux_security_t *ctx;
+    flux_security_config_t *cfg;
+    cf_t *cf;
+
+    if (!(ctx = flux_security_create (0)))
+        BAIL_OUT ("flux_security_create failed");
+    if (!(cf = cf_create ()) || cf_update (cf, bad_curve_conf,
+                                           strlen (bad_curve_conf),
+                                           NULL) < 0
+                             || security_set_config (ctx, cf) < 0)
+        BAIL_OUT ("failed to set config");
+    cf_destroy (cf);
+
+    ok ((cfg = flux_security_config_get (ctx)) != NULL,
+        "flux_security_config_get works when preload fails");
+    ok (flux_security_last_error (ctx) == NULL
+        && flux_security_last_errnum (ctx) == 0,
+        "preload failure does not leave an error in the context");
+    ok (security_get_cred (ctx, "curve.cert") == NULL,
+        "signing cert is not preloaded");
+
+    flux_security_config_decref (cfg);
+    flux_security_destroy (ctx);
+}
+
 void test_error (void)
 {
     flux_security_t *ctx;
@@ -202,6 +303,38 @@ void test_aux (void)
         "flux_security_destroy called aux destructor for each item");
 }
 
+void test_slot (void)
+{
+    flux_security_t *ctx;
+    char *s, *p;
+
+    free_flag = 0;
+    if (!(ctx = flux_security_create (0)))
+        BAIL_OUT ("flux_security_create failed");
+    if (!(s = strdup ("hello")))
+        BAIL_OUT ("strdup failed");
+    if (!(p = strdup ("goodbye")))
+        BAIL_OUT ("strdup failed");
+
+    ok (security_slot_get (ctx, SECURITY_SLOT_SIGN) == NULL,
+        "security_slot_get on empty slot returns NULL");
+    security_slot_set (ctx, SECURITY_SLOT_SIGN, s, aux_free);
+    ok (security_slot_get (ctx, SECURITY_SLOT_SIGN) == s,
+        "security_slot_get retrieves data");
+    ok (security_slot_get (ctx, SECURITY_SLOT_SIGN_MUNGE) == NULL,
+        "other slots are unaffected");
+    ok (flux_security_aux_get (ctx, "flux::sign") == NULL,
+        "slots are not visible as aux items");
+    security_slot_set (ctx, SECURITY_SLOT_SIGN, p, aux_free);
+    ok (free_flag == 1 && security_slot_get (ctx, SECURITY_SLOT_SIGN) == p,
+        "security_slot_set on existing slot destroys previous value");
+
+    flux_security_destroy (ctx);
+
+    ok (free_flag == 2,
+        "flux_security_destroy called slot destructor");
+}
+
 void test_corner (void)
 {
     flux_security_t *ctx;
@@ -267,8 +400,11 @@ int main (int argc, char *argv[])
 
     test_basic ();
     test_set_config ();
+    test_shared_config ();
+    test_preload_error ();
     test_error ();
     test_aux ();
+    test_slot ();
     test_corner ();
 
     conf_fini ();
@@ -271,6 +271,330 @@ void test_basic (flux_security_t *ctx)
     diag ("%s", flux_security_last_error (ctx));
 }
 
+void test_inplace (flux_security_t *ctx)
+{
+    char inmsg[4096];
+    const char *outmsg;
+    int outmsgsz;
+    const char *s;
+    char *cpy;
+    char *badcpy;
+    int64_t userid;
+
+    memset (inmsg, 'x', sizeof (inmsg));
+
+    /* Payload spans several decode chunks
+     */
+    if (!(s = flux_sign_wrap (ctx, inmsg, sizeof (inmsg), NULL, 0)))
+        BAIL_OUT ("flux_sign_wrap: %s", flux_security_last_error (ctx));
+    if (!(cpy = strdup (s)))
+        BAIL_OUT ("strdup failed");
+    if (!(badcpy = strdup (s)))
+        BAIL_OUT ("strdup failed");
+
+    outmsgsz = 0;
+    outmsg = NULL;
+    ok (flux_sign_unwrap (ctx, cpy, (const void **)&outmsg,
+                          &outmsgsz, &userid, FLUX_SIGN_INPLACE) == 0,
+        "flux_sign_unwrap INPLACE works");
+    ok (outmsgsz == sizeof (inmsg),
+        "unwrapped size matches wrapped size");
+    ok (outmsg != NULL && memcmp (outmsg, inmsg, sizeof (inmsg)) == 0,
+        "unwrapped message matches wrapped message");
+    ok (outmsg > cpy && outmsg < cpy + strlen (s),
+        "unwrapped message was decoded within input buffer");
+    ok (userid == getuid (),
+        "userid matches real userid");
+
+    /* Corrupt the payload after the header delimiter.
+     */
+    strchr (badcpy, '.')[1] = '&';
+    errno = 0;
+    ok (flux_sign_unwrap (ctx, badcpy, NULL, NULL, NULL,
+                          FLUX_SIGN_INPLACE | FLUX_SIGN_NOVERIFY) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap INPLACE fails on not-base64 PAYLOAD with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+
+    /* Empty payload
+     */
+    free (cpy);
+    if (!(s = flux_sign_wrap (ctx, NULL, 0, NULL, 0)))
+        BAIL_OUT ("flux_sign_wrap: %s", flux_security_last_error (ctx));
+    if (!(cpy = strdup (s)))
+        BAIL_OUT ("strdup failed");
+    outmsgsz = -1;
+    outmsg = NULL;
+    ok (flux_sign_unwrap (ctx, cpy, (const void **)&outmsg,
+                          &outmsgsz, NULL, FLUX_SIGN_INPLACE) == 0,
+        "flux_sign_unwrap INPLACE works on empty payload");
+    ok (outmsg == NULL && outmsgsz == 0,
+        "returned payload=NULL payloadsz=0");
+
+    free (badcpy);
+    free (cpy);
+}
+
+void test_encoded (flux_security_t *ctx)
+{
+    const char *inmsg = "aGVsbG8gd29ybGQ="; // "hello world"
+    int inmsgsz = strlen (inmsg);
+    const char *outmsg;
+    int outmsgsz;
+    const char *s;
+    char *cpy;
+
+    /* Wrap pre-encoded payload
+     */
+    s = flux_sign_wrap (ctx, inmsg, inmsgsz, NULL, FLUX_SIGN_ENCODED);
+    ok (s != NULL,
+        "flux_sign_wrap ENCODED works");
+    diag ("%s", s);
+    if (!(cpy = strdup (s)))
+        BAIL_OUT ("strdup failed");
+
+    /* Unwrap normally
+     */
+    outmsgsz = 0;
+    outmsg = NULL;
+    ok (flux_sign_unwrap (ctx, cpy, (const void **)&outmsg,
+                          &outmsgsz, NULL, 0) == 0,
+        "flux_sign_unwrap works on ENCODED wrap");
+    ok (outmsgsz == 11 && outmsg != NULL
+        && memcmp (outmsg, "hello world", 11) == 0,
+        "unwrapped message matches decoded payload");
+
+    /* Unwrap without decoding
+     */
+    outmsgsz = 0;
+    outmsg = NULL;
+    ok (flux_sign_unwrap (ctx, cpy, (const void **)&outmsg,
+                          &outmsgsz, NULL, FLUX_SIGN_ENCODED) == 0,
+        "flux_sign_unwrap ENCODED works");
+    ok (outmsgsz == inmsgsz && outmsg != NULL
+        && memcmp (outmsg, inmsg, inmsgsz) == 0,
+        "unwrapped message matches encoded payload");
+    ok (outmsg > cpy && outmsg < cpy + strlen (cpy),
+        "unwrapped message points into input");
+
+    /* Empty payload
+     */
+    ok (flux_sign_wrap (ctx, NULL, 0, NULL, FLUX_SIGN_ENCODED) != NULL,
+        "flux_sign_wrap ENCODED works on empty payload");
+
+    errno = 0;
+    ok (flux_sign_wrap (ctx, "aGk", 3, NULL, FLUX_SIGN_ENCODED) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap ENCODED fails on bad length with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+    errno = 0;
+    ok (flux_sign_wrap (ctx, "a&k=", 4, NULL, FLUX_SIGN_ENCODED) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap ENCODED fails on bad character with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+    errno = 0;
+    ok (flux_sign_wrap (ctx, "aG=k", 4, NULL, FLUX_SIGN_ENCODED) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap ENCODED fails on misplaced padding with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+    errno = 0;
+    ok (flux_sign_wrap (ctx, "aGl=", 4, NULL, FLUX_SIGN_ENCODED) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap ENCODED fails on nonzero trailing bits with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+
+    errno = 0;
+    ok (flux_sign_unwrap (ctx, cpy, NULL, NULL, NULL,
+                          FLUX_SIGN_ENCODED | FLUX_SIGN_INPLACE) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap ENCODED|INPLACE fails with EINVAL");
+
+    free (cpy);
+}
+
+void test_batch (flux_security_t *ctx)
+{
+    const char *inmsg[] = { "a", "bb", "ccc", "dddd", "eeeee", "" };
+    int inmsgsz[] = { 1, 2, 3, 4, 5, 0 };
+    int count = sizeof (inmsgsz) / sizeof (inmsgsz[0]);
+    const char **batch;
+    const char *outmsg;
+    int outmsgsz;
+    int64_t userid;
+    char *cpy;
+    char *p;
+    int errors;
+    int i;
+
+    batch = flux_sign_wrap_batch (ctx, (const void **)inmsg, inmsgsz, count,
+                                  NULL, 0);
+    ok (batch != NULL,
+        "flux_sign_wrap_batch works");
+    if (!batch)
+        BAIL_OUT ("flux_sign_wrap_batch: %s", flux_security_last_error (ctx));
+    for (i = 0; i < count; i++)
+        diag ("%s", batch[i]);
+    ok (batch[count] == NULL,
+        "batch array is NULL terminated");
+
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        outmsgsz = -1;
+        outmsg = NULL;
+        if (flux_sign_unwrap (ctx, batch[i], (const void **)&outmsg,
+                              &outmsgsz, &userid, 0) < 0
+            || outmsgsz != inmsgsz[i]
+            || (outmsgsz > 0 && memcmp (outmsg, inmsg[i], outmsgsz) != 0)
+            || userid != getuid ()) {
+            diag ("%d: %s", i, flux_security_last_error (ctx));
+            errors++;
+        }
+    }
+    ok (errors == 0,
+        "flux_sign_unwrap works on each batch item");
+
+    /* Truncate the proof of item 3.
+     * N.B. the "none" mechanism does not check what it signed, so only
+     * proof format errors can be detected here.  Proof and payload
+     * tampering is covered with real mechanisms in the sharness tests.
+     */
+    if (!(cpy = strdup (batch[3])))
+        BAIL_OUT ("strdup failed");
+    p = strrchr (cpy, '.');
+    memmove (p + 1, p + 2, strlen (p + 2) + 1);
+    errno = 0;
+    ok (flux_sign_unwrap (ctx, cpy, NULL, NULL, NULL, 0) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap fails on item with truncated proof");
+    diag ("%s", flux_security_last_error (ctx));
+    free (cpy);
+
+    /* Batch of one
+     */
+    batch = flux_sign_wrap_batch (ctx, (const void **)inmsg, inmsgsz, 1,
+                                  NULL, 0);
+    ok (batch != NULL && batch[0] != NULL && batch[1] == NULL
+        && flux_sign_unwrap (ctx, batch[0], NULL, NULL, NULL, 0) == 0,
+        "flux_sign_wrap_batch count=1 works");
+
+    /* Sign-as
+     */
+    batch = flux_sign_wrap_batch_as (ctx, 42, (const void **)inmsg, inmsgsz,
+                                     count, NULL, 0);
+    ok (batch != NULL,
+        "flux_sign_wrap_batch_as works");
+    ok (batch != NULL
+        && flux_sign_unwrap (ctx, batch[1], NULL, NULL, &userid,
+                             FLUX_SIGN_NOVERIFY) == 0
+        && userid == 42,
+        "flux_sign_unwrap NOVERIFY works with flux_sign_wrap_batch_as()");
+    ok (batch != NULL
+        && flux_sign_unwrap (ctx, batch[1], NULL, NULL, NULL, 0) < 0,
+        "flux_sign_unwrap VERIFY fails with flux_sign_wrap_batch_as()");
+
+    errno = 0;
+    ok (flux_sign_wrap_batch (ctx, (const void **)inmsg, inmsgsz, 0,
+                              NULL, 0) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap_batch count=0 fails with EINVAL");
+    errno = 0;
+    ok (flux_sign_wrap_batch (ctx, NULL, inmsgsz, count, NULL, 0) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap_batch pay=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_sign_wrap_batch (ctx, (const void **)inmsg, inmsgsz, count,
+                              NULL, 0xff) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap_batch flags=0xff fails with EINVAL");
+}
+
+void test_delta (flux_security_t *ctx)
+{
+    const char *tmplmsg = "common part";
+    const char *delta[] = { "0", "1", "2" };
+    int deltasz[] = { 1, 1, 1 };
+    char *tmpl;
+    char *tmpl2;
+    const char **batch;
+    const char *s;
+    const char *outmsg;
+    int outmsgsz;
+    const char *outtmpl;
+    int outtmplsz;
+    int64_t userid;
+    int errors;
+    int i;
+
+    if (!(s = flux_sign_wrap (ctx, tmplmsg, strlen (tmplmsg), NULL, 0))
+        || !(tmpl = strdup (s)))
+        BAIL_OUT ("failed to create template");
+    if (!(s = flux_sign_wrap (ctx, "other", 5, NULL, 0))
+        || !(tmpl2 = strdup (s)))
+        BAIL_OUT ("failed to create template");
+
+    batch = flux_sign_wrap_delta (ctx, tmpl, (const void **)delta, deltasz, 3,
+                                  NULL, 0);
+    ok (batch != NULL,
+        "flux_sign_wrap_delta works");
+    if (!batch)
+        BAIL_OUT ("flux_sign_wrap_delta: %s", flux_security_last_error (ctx));
+    diag ("%s", batch[0]);
+
+    errors = 0;
+    for (i = 0; i < 3; i++) {
+        outmsg = outtmpl = NULL;
+        outmsgsz = outtmplsz = -1;
+        if (flux_sign_unwrap_delta (ctx, tmpl, batch[i],
+                                    (const void **)&outtmpl, &outtmplsz,
+                                    (const void **)&outmsg, &outmsgsz,
+                                    &userid, 0) < 0
+            || outtmplsz != (int) strlen (tmplmsg)
+            || memcmp (outtmpl, tmplmsg, outtmplsz) != 0
+            || outmsgsz != 1
+            || memcmp (outmsg, delta[i], 1) != 0
+            || userid != getuid ()) {
+            diag ("%d: %s", i, flux_security_last_error (ctx));
+            errors++;
+        }
+    }
+    ok (errors == 0,
+        "flux_sign_unwrap_delta works on each delta");
+
+    errno = 0;
+    ok (flux_sign_unwrap_delta (ctx, tmpl2, batch[0], NULL, NULL,
+                                NULL, NULL, NULL, 0) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap_delta with wrong template fails with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+
+    errno = 0;
+    ok (flux_sign_unwrap (ctx, batch[0], NULL, NULL, NULL, 0) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap on delta fails with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+
+    errno = 0;
+    ok (flux_sign_unwrap_delta (ctx, tmpl, tmpl2, NULL, NULL,
+                                NULL, NULL, NULL, 0) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap_delta on non-delta fails with EINVAL");
+    diag ("%s", flux_security_last_error (ctx));
+
+    errno = 0;
+    ok (flux_sign_wrap_delta (ctx, NULL, (const void **)delta, deltasz, 3,
+                              NULL, 0) == NULL
+        && errno == EINVAL,
+        "flux_sign_wrap_delta template=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_sign_unwrap_delta (ctx, NULL, tmpl, NULL, NULL,
+                                NULL, NULL, NULL, 0) < 0
+        && errno == EINVAL,
+        "flux_sign_unwrap_delta template=NULL fails with EINVAL");
+
+    free (tmpl2);
+    free (tmpl);
+}
+
 void test_mechselect (flux_security_t *ctx)
 {
     const char *inmsg = "hello world";
@@ -560,6 +884,10 @@ int main (int argc, char *argv[])
 
     ctx = context_init (conf);
     test_basic (ctx);
+    test_inplace (ctx);
+    test_encoded (ctx);
+    test_batch (ctx);
+    test_delta (ctx);
     test_mechselect (ctx);
     test_badheader (ctx);
     test_badpayload (ctx);
@@ -146,6 +146,7 @@ struct sigcert *sigcert_copy (const struct sigcert *cert)
     }
     memcpy (cpy, cert, sizeof (*cpy));
     cpy->meta = metacpy;
+    cpy->enc = NULL;
     return cpy;
 }
 
@@ -501,12 +502,11 @@ static int sigcert_fread_secret (struct sigcert *cert, FILE *fp)
     toml_table_t *cert_table = NULL;
     toml_table_t *curve_table;
     const char *raw;
-    char errbuf[200];
     char *conf;
 
     if (!(conf = freads_limited (fp, cert_read_limit)))
         return -1;
-    if (!(cert_table = toml_parse (conf, errbuf, sizeof (errbuf))))
+    if (!(cert_table = tomltk_parse (conf, strlen (conf), NULL)))
         goto inval;
     if (!(curve_table = toml_table_in (cert_table, "curve")))
         goto inval;
@@ -517,11 +517,11 @@ static int sigcert_fread_secret (struct sigcert *cert, FILE *fp)
         goto inval;
     cert->secret_valid = true;
     free (conf);
-    toml_free (cert_table);
+    tomltk_free (cert_table);
     return 0;
 inval:
     free (conf);
-    toml_free (cert_table);
+    tomltk_free (cert_table);
     errno = EINVAL;
     return -1;
 }
@@ -537,7 +537,6 @@ struct sigcert *sigcert_fread_public (FILE *fp)
     const char *key;
     const char *raw;
     int i;
-    char errbuf[200];
     char *conf;
 
     if (!(cert = sigcert_alloc ()))
@@ -546,7 +545,7 @@ struct sigcert *sigcert_fread_public (FILE *fp)
         sigcert_destroy (cert);
         return NULL;
     }
-    if (!(cert_table = toml_parse (conf, errbuf, sizeof (errbuf))))
+    if (!(cert_table = tomltk_parse (conf, strlen (conf), NULL)))
         goto inval;
 
     // [metadata]
@@ -574,11 +573,11 @@ struct sigcert *sigcert_fread_public (FILE *fp)
         cert->signature_valid = true;
     }
     free (conf);
-    toml_free (cert_table);
+    tomltk_free (cert_table);
     return cert;
 inval:
     free (conf);
-    toml_free (cert_table);
+    tomltk_free (cert_table);
     sigcert_destroy (cert);
     errno = EINVAL;
     return NULL;
@@ -627,7 +626,7 @@ error:
  * The decoded size must exactly match 'dstsz'.
  * Return 0 on success, -1 on error with errno set.
  */
-static int get_base64_exact (struct kv *kv, const char *key,
+static int get_base64_exact (const struct kv *kv, const char *key,
                              uint8_t *dst, size_t dstsz)
 {
     const char *src;
@@ -649,10 +648,23 @@ struct sigcert *sigcert_decode (const char *s, int len)
         errno = EINVAL;
         return NULL;
     }
-    if (!(kv = kv_decode (s, len)))
+    if (!(kv = kv_view (s, len)))
         return NULL;
+    cert = sigcert_decode_kv (kv);
+    kv_destroy (kv);
+    return cert;
+}
+
+struct sigcert *sigcert_decode_kv (const struct kv *kv)
+{
+    struct sigcert *cert;
+
+    if (!kv) {
+        errno = EINVAL;
+        return NULL;
+    }
     if (!(cert = sigcert_alloc ()))
-        goto error;
+        return NULL;
 
     kv_destroy (cert->meta);
     if (!(cert->meta = kv_split (kv, "meta.")))
@@ -665,10 +677,8 @@ struct sigcert *sigcert_decode (const char *s, int len)
         cert->signature_valid = true;
     else if (errno != ENOENT)
         goto error;
-    kv_destroy (kv);
     return cert;
 error:
-    kv_destroy (kv);
     sigcert_destroy (cert);
     return NULL;
 }
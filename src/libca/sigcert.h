@@ -71,6 +71,11 @@ struct sigcert *sigcert_fread_public (FILE *fp);
  */
 struct sigcert *sigcert_decode (const char *s, int len);
 
+/* Decode cert from kv object, e.g. a kv_view_prefix() of a larger kv.
+ */
+struct kv;
+struct sigcert *sigcert_decode_kv (const struct kv *kv);
+
 /* Encode cert to kv buffer.
  */
 int sigcert_encode (const struct sigcert *cert, const char **bp, int *len);
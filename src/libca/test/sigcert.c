@@ -19,6 +19,7 @@
 #include <errno.h>
 
 #include "src/libtap/tap.h"
+#include "src/libutil/kv.h"
 #include "sigcert.h"
 
 static char scratch[PATH_MAX + 1];
@@ -316,6 +317,9 @@ void test_codec (void)
     struct sigcert *cert;
     struct sigcert *cert_pub;
     struct sigcert *cert2;
+    struct kv *kv;
+    struct kv *cert_kv;
+    struct kv *view;
     const char *s;
     int len;
 
@@ -355,6 +359,23 @@ void test_codec (void)
         "sigcert_decode works");
     ok (sigcert_equal (cert2, cert_pub) == true,
         "the two certs are equal");
+    sigcert_destroy (cert2);
+
+    /* Embed encoded cert_pub in a larger kv with a prefix, then decode
+     * from a prefix view as cert2.
+     */
+    if (!(kv = kv_create ())
+        || kv_put (kv, "other", KV_STRING, "foo") < 0
+        || !(cert_kv = kv_decode (s, len))
+        || kv_join (kv, cert_kv, "cert.") < 0
+        || !(view = kv_view_prefix (kv, "cert.")))
+        BAIL_OUT ("failed to create kv with embedded cert");
+    cert2 = sigcert_decode_kv (view);
+    ok (cert2 != NULL && sigcert_equal (cert2, cert_pub) == true,
+        "sigcert_decode_kv works on a prefix view");
+    kv_destroy (view);
+    kv_destroy (cert_kv);
+    kv_destroy (kv);
 
     sigcert_destroy (cert);
     sigcert_destroy (cert_pub);
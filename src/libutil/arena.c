@@ -0,0 +1,261 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "arena.h"
+
+/* Each allocation is preceded by a header holding its size, padded so
+ * that the allocation itself has the same alignment as malloc(3).
+ */
+#define ALIGN 16
+
+struct chunk {
+    size_t size;
+    char pad[ALIGN - sizeof (size_t)];
+};
+
+/* The first block of an arena holds the arena itself.
+ */
+struct block {
+    struct arena *arena;
+    struct block *next;
+    size_t size;
+    size_t used;
+    struct chunk *last;
+    char pad[ALIGN - ((sizeof (void *) * 3 + sizeof (size_t) * 2) % ALIGN)];
+};
+
+struct arena {
+    struct block *blocks;   // current block for small allocations first
+    struct block *large;
+};
+
+static size_t roundup (size_t size)
+{
+    return (size + ALIGN - 1) & ~((size_t)ALIGN - 1);
+}
+
+static struct block *block_create (struct arena *arena, size_t size)
+{
+    struct block *b;
+
+    if (size == ARENA_BLOCK_SIZE) {
+        void *p;
+        int e;
+        if ((e = posix_memalign (&p, ARENA_BLOCK_SIZE, size)) != 0) {
+            errno = e;
+            return NULL;
+        }
+        b = p;
+    }
+    else if (!(b = malloc (size)))
+        return NULL;
+    b->arena = arena;
+    b->next = NULL;
+    b->size = size;
+    b->used = sizeof (*b);
+    b->last = NULL;
+    return b;
+}
+
+static void block_list_destroy (struct block *b)
+{
+    while (b) {
+        struct block *next = b->next;
+        free (b);
+        b = next;
+    }
+}
+
+struct arena *arena_create (void)
+{
+    struct block *b;
+    struct arena *arena;
+
+    if (!(b = block_create (NULL, ARENA_BLOCK_SIZE)))
+        return NULL;
+    arena = (struct arena *)((char *)b + b->used);
+    b->used += roundup (sizeof (*arena));
+    b->arena = arena;
+    arena->blocks = b;
+    arena->large = NULL;
+    return arena;
+}
+
+void arena_destroy (struct arena *arena)
+{
+    if (arena) {
+        int saved_errno = errno;
+        block_list_destroy (arena->large);
+        block_list_destroy (arena->blocks); // arena is freed last
+        errno = saved_errno;
+    }
+}
+
+/* Carve 'size' bytes from block 'b', if there is room.
+ */
+static void *block_alloc (struct block *b, size_t size)
+{
+    struct chunk *c;
+
+    if (b->size - b->used < sizeof (*c) + size)
+        return NULL;
+    c = (struct chunk *)((char *)b + b->used);
+    c->size = size;
+    b->used += sizeof (*c) + size;
+    b->last = c;
+    return c + 1;
+}
+
+/* Allocate 'size' bytes, with room for the allocation to grow in place
+ * to 'capacity' if it is large.
+ */
+static void *arena_alloc (struct arena *arena, size_t size, size_t capacity)
+{
+    struct block *b;
+    void *ptr;
+
+    if (size > SIZE_MAX / 4 || capacity > SIZE_MAX / 4) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size = roundup (size);
+    if (size > ARENA_LARGE_SIZE) {
+        capacity = roundup (capacity);
+        if (capacity < size)
+            capacity = size;
+        if (!(b = block_create (arena, sizeof (*b) + sizeof (struct chunk)
+                                                   + capacity)))
+            return NULL;
+        b->next = arena->large;
+        arena->large = b;
+        ptr = block_alloc (b, size);
+        return ptr;
+    }
+    if (!(ptr = block_alloc (arena->blocks, size))) {
+        if (!(b = block_create (arena, ARENA_BLOCK_SIZE)))
+            return NULL;
+        b->next = arena->blocks;
+        arena->blocks = b;
+        ptr = block_alloc (b, size);
+    }
+    return ptr;
+}
+
+void *arena_malloc (struct arena *arena, size_t size)
+{
+    if (!arena) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return arena_alloc (arena, size, size);
+}
+
+void *arena_calloc (struct arena *arena, size_t nmemb, size_t size)
+{
+    void *ptr;
+
+    if (!arena) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (size > 0 && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((ptr = arena_alloc (arena, nmemb * size, nmemb * size)))
+        memset (ptr, 0, nmemb * size);
+    return ptr;
+}
+
+/* Find the block holding allocation 'c' by checking the blocks where it
+ * could be the last allocation.  Return NULL if it is not last anywhere.
+ */
+static struct block *find_last (struct arena *arena, struct chunk *c)
+{
+    if (arena->blocks->last == c)
+        return arena->blocks;
+    if (arena->large && arena->large->last == c)
+        return arena->large;
+    return NULL;
+}
+
+void *arena_realloc (struct arena *arena, void *ptr, size_t size)
+{
+    struct chunk *c;
+    struct block *b;
+    void *new;
+
+    if (!arena) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!ptr)
+        return arena_alloc (arena, size, size);
+    c = (struct chunk *)ptr - 1;
+    if (size > SIZE_MAX / 4) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size = roundup (size);
+    if (size <= c->size)
+        return ptr;
+    if ((b = find_last (arena, c))) {
+        size_t avail = b->size - ((char *)ptr - (char *)b);
+        if (size <= avail) {
+            b->used += size - c->size;
+            c->size = size;
+            return ptr;
+        }
+    }
+    /* Growing allocations move to their own block with room to keep
+     * growing, so that repeated reallocs don't copy every time.
+     */
+    if (!(new = arena_alloc (arena, size, size * 2)))
+        return NULL;
+    memcpy (new, ptr, c->size);
+    arena_free (arena, ptr);
+    return new;
+}
+
+void arena_free (struct arena *arena, void *ptr)
+{
+    struct chunk *c;
+    struct block *b;
+
+    if (!arena || !ptr)
+        return;
+    c = (struct chunk *)ptr - 1;
+    if ((b = find_last (arena, c))) {
+        b->used = (char *)c - (char *)b;
+        b->last = NULL;
+    }
+}
+
+struct arena *arena_from_ptr (const void *ptr)
+{
+    const struct block *b;
+
+    if (!ptr)
+        return NULL;
+    b = (const struct block *)((uintptr_t)ptr & ~((uintptr_t)ARENA_BLOCK_SIZE - 1));
+    return b->arena;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
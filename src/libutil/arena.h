@@ -0,0 +1,47 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_ARENA_H
+#define _UTIL_ARENA_H
+
+/* Region allocator for data structures that are built up by many small
+ * allocations and torn down all at once.
+ *
+ * Memory comes from ARENA_BLOCK_SIZE blocks, aligned on that size, so that
+ * the arena owning a small allocation can be found from its address with
+ * arena_from_ptr().  Requests larger than ARENA_LARGE_SIZE get a dedicated
+ * block, for which that does not work.  arena_free() only reclaims memory
+ * if it was the last allocation in its block, and arena_realloc() grows
+ * the last allocation in place when there is room.
+ */
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (16*1024)
+#define ARENA_LARGE_SIZE (ARENA_BLOCK_SIZE / 4)
+
+struct arena *arena_create (void);
+void arena_destroy (struct arena *arena);
+
+void *arena_malloc (struct arena *arena, size_t size);
+void *arena_calloc (struct arena *arena, size_t nmemb, size_t size);
+void *arena_realloc (struct arena *arena, void *ptr, size_t size);
+void arena_free (struct arena *arena, void *ptr);
+
+/* Return the arena that 'ptr', an allocation of ARENA_LARGE_SIZE or less,
+ * was allocated from.
+ */
+struct arena *arena_from_ptr (const void *ptr);
+
+#endif /* !_UTIL_ARENA_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -14,17 +14,51 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
 #include <glob.h>
 #include <fnmatch.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <jansson.h>
 
 #include "src/libtomlc99/toml.h"
 #include "tomltk.h"
 #include "cf.h"
 #include "path.h"
+#include "sha256.h"
+#include "hash.h"
 
 #define ERRBUFSZ 200
 
+/* Compiled configuration cache file layout:
+ *   struct cache_header
+ *   struct cache_entry[nfiles]     (stat of each source file, glob order)
+ *   source file paths              (pathsz bytes, each NUL terminated)
+ *   merged configuration           (datalen bytes, compact JSON)
+ */
+#define CACHE_MAGIC "FLXCFC01"
+
+struct cache_header {
+    char magic[8];
+    uint32_t nfiles;
+    uint32_t pathsz;
+    uint64_t datalen;
+    BYTE digest[SHA256_BLOCK_SIZE]; // initial configuration
+};
+
+struct cache_entry {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+};
+
 cf_t *cf_create (void)
 {
     cf_t *cf;
@@ -196,6 +230,25 @@ int cf_array_size (const cf_t *cf)
     return cf ? json_array_size (cf) : 0;
 }
 
+int cf_table_foreach (const cf_t *cf, cf_table_f fn, void *arg)
+{
+    void *iter;
+
+    if (cf_typeof (cf) != CF_TABLE)
+        return 0;
+    /* N.B. const is cast away for iteration, but object is not modified.
+     */
+    iter = json_object_iter ((json_t *)cf);
+    while (iter) {
+        if (fn (json_object_iter_key (iter),
+                json_object_iter_value (iter),
+                arg) < 0)
+            return -1;
+        iter = json_object_iter_next ((json_t *)cf, iter);
+    }
+    return 0;
+}
+
 /*  Return true if 'str' appears in cf array 'cf'
  *  False if array is NULL or is zero length, or doesn't contain str
  */
@@ -230,6 +283,122 @@ bool cf_array_contains_match (const cf_t *cf, const char *str)
     return false;
 }
 
+struct cf_pattern {
+    char *pattern;
+    size_t prefixlen;   // length of literal prefix
+};
+
+struct cf_set {
+    hash_t literals;
+    struct cf_pattern *patterns;
+    int npatterns;
+};
+
+void cf_set_destroy (struct cf_set *set)
+{
+    if (set) {
+        int saved_errno = errno;
+        int i;
+        if (set->literals)
+            hash_destroy (set->literals);
+        for (i = 0; i < set->npatterns; i++)
+            free (set->patterns[i].pattern);
+        free (set->patterns);
+        free (set);
+        errno = saved_errno;
+    }
+}
+
+static int set_add_literal (struct cf_set *set, const char *str)
+{
+    char *cpy;
+
+    if (hash_find (set->literals, str))
+        return 0;
+    if (!(cpy = strdup (str)))
+        return -1;
+    if (!hash_insert (set->literals, cpy, cpy)) {
+        free (cpy);
+        return -1;
+    }
+    return 0;
+}
+
+static int set_add_pattern (struct cf_set *set, const char *str)
+{
+    struct cf_pattern *p = &set->patterns[set->npatterns];
+    int i;
+
+    for (i = 0; i < set->npatterns; i++) {
+        if (!strcmp (set->patterns[i].pattern, str))
+            return 0;
+    }
+    if (!(p->pattern = strdup (str)))
+        return -1;
+    p->prefixlen = strcspn (str, "*?[\\");
+    set->npatterns++;
+    return 0;
+}
+
+struct cf_set *cf_set_create (const cf_t *cf, int flags)
+{
+    struct cf_set *set;
+    int size = cf_array_size (cf);
+    int i;
+
+    if ((cf && cf_typeof (cf) != CF_ARRAY) || (flags & ~CF_SET_MATCH)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(set = calloc (1, sizeof (*set))))
+        return NULL;
+    if (!(set->literals = hash_create (size,
+                                       (hash_key_f)hash_key_string,
+                                       (hash_cmp_f)strcmp,
+                                       free)))
+        goto error;
+    if ((flags & CF_SET_MATCH) && size > 0
+        && !(set->patterns = calloc (size, sizeof (set->patterns[0]))))
+        goto error;
+    for (i = 0; i < size; i++) {
+        const cf_t *entry = cf_get_at (cf, i);
+        const char *str;
+
+        if (cf_typeof (entry) != CF_STRING)
+            continue;
+        str = cf_string (entry);
+        /* A pattern without special characters matches only itself.
+         */
+        if ((flags & CF_SET_MATCH) && strpbrk (str, "*?[\\")) {
+            if (set_add_pattern (set, str) < 0)
+                goto error;
+        }
+        else if (set_add_literal (set, str) < 0)
+            goto error;
+    }
+    return set;
+error:
+    cf_set_destroy (set);
+    return NULL;
+}
+
+bool cf_set_contains (const struct cf_set *set, const char *str)
+{
+    int i;
+
+    if (!set || !str)
+        return false;
+    if (hash_find (set->literals, str))
+        return true;
+    for (i = 0; i < set->npatterns; i++) {
+        const struct cf_pattern *p = &set->patterns[i];
+        if (strncmp (str, p->pattern, p->prefixlen) == 0
+            && fnmatch (p->pattern, str, 0) == 0)
+            return true;
+    }
+    return false;
+}
+
 static bool filename_is_secure (cf_t *cf,
                                 const char *filename,
                                 struct cf_error *error)
@@ -274,7 +443,6 @@ static int update_object (cf_t *cf,
 {
     struct tomltk_error toml_error;
     toml_table_t *tab;
-    json_t *obj = NULL;
     int saved_errno;
 
     if (!cf || json_typeof ((json_t *)cf) != JSON_OBJECT) {
@@ -295,23 +463,16 @@ static int update_object (cf_t *cf,
                    "%s", toml_error.errbuf);
         goto error;
     }
-    if (!(obj = tomltk_table_to_json (tab))) {
+    if (tomltk_table_update_json (cf, tab) < 0) {
         errprintf (error, filename, -1, "converting TOML to JSON: %s",
                    strerror (errno));
         goto error;
     }
-    if (json_object_update (cf, obj) < 0) {
-        errprintf (error, filename, -1, "updating JSON object: out of memory");
-        errno = ENOMEM;
-        goto error;
-    }
-    json_decref (obj);
-    toml_free (tab);
+    tomltk_free (tab);
     return 0;
 error:
     saved_errno = errno;
-    toml_free (tab);
-    json_decref (obj);
+    tomltk_free (tab);
     errno = saved_errno;
     return -1;
 }
@@ -364,7 +525,237 @@ int cf_update_pack (cf_t *cf, struct cf_error *error, const char *fmt, ...)
     return rc;
 }
 
-int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
+static void cache_entry_set (struct cache_entry *e, const struct stat *sb)
+{
+    memset (e, 0, sizeof (*e));
+    e->dev = sb->st_dev;
+    e->ino = sb->st_ino;
+    e->size = sb->st_size;
+    e->mtime_sec = sb->st_mtim.tv_sec;
+    e->mtime_nsec = sb->st_mtim.tv_nsec;
+    e->ctime_sec = sb->st_ctim.tv_sec;
+    e->ctime_nsec = sb->st_ctim.tv_nsec;
+}
+
+/* Compute digest of 'cf' before any files are merged into it, since
+ * the cached result is only valid for the same starting point.
+ */
+static int cache_digest (const cf_t *cf, BYTE *digest)
+{
+    SHA256_CTX shx;
+    char *s;
+
+    if (!(s = json_dumps (cf, JSON_COMPACT | JSON_SORT_KEYS))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    sha256_init (&shx);
+    sha256_update (&shx, (BYTE *)s, strlen (s));
+    sha256_final (&shx, digest);
+    free (s);
+    return 0;
+}
+
+/* Cache must be a regular file owned by root or the caller, and not
+ * writable by anyone else.
+ */
+static bool cache_is_trusted (const char *cachepath,
+                              const struct stat *sb,
+                              bool paranoid)
+{
+    struct path_error path_error;
+
+    if (!S_ISREG (sb->st_mode)
+        || (sb->st_uid != 0 && sb->st_uid != geteuid ())
+        || (sb->st_mode & (S_IWGRP | S_IWOTH)))
+        return false;
+    if (paranoid && !path_is_secure (cachepath, &path_error))
+        return false;
+    return true;
+}
+
+/* Load merged configuration from 'cachepath' if it was compiled from the
+ * files in 'gl', unchanged since their stat was taken in 'sb', starting
+ * from configuration with 'digest'.
+ * Return object on success, or NULL if the cache is missing or stale.
+ */
+static json_t *cache_load (cf_t *cf,
+                           const char *cachepath,
+                           const glob_t *gl,
+                           const struct stat *sb,
+                           const BYTE *digest)
+{
+    const struct cache_header *hdr;
+    const struct cache_entry *entry;
+    const char *path;
+    const char *data;
+    void *map = MAP_FAILED;
+    struct stat cache_sb;
+    size_t size;
+    json_t *obj = NULL;
+    bool paranoid = check_file_permissions (cf);
+    size_t i;
+    int fd;
+
+    if ((fd = open (cachepath, O_RDONLY | O_CLOEXEC | O_NOFOLLOW)) < 0)
+        return NULL;
+    if (fstat (fd, &cache_sb) < 0
+        || !cache_is_trusted (cachepath, &cache_sb, paranoid)
+        || cache_sb.st_size < (off_t)sizeof (*hdr))
+        goto done;
+    size = cache_sb.st_size;
+    if ((map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        goto done;
+    hdr = map;
+    if (memcmp (hdr->magic, CACHE_MAGIC, sizeof (hdr->magic)) != 0
+        || memcmp (hdr->digest, digest, sizeof (hdr->digest)) != 0
+        || hdr->nfiles != gl->gl_pathc
+        || hdr->datalen > size - sizeof (*hdr)
+        || size - sizeof (*hdr) - hdr->datalen
+            != (uint64_t)hdr->nfiles * sizeof (*entry) + hdr->pathsz)
+        goto done;
+    entry = (const struct cache_entry *)(hdr + 1);
+    path = (const char *)(entry + hdr->nfiles);
+    data = path + hdr->pathsz;
+    for (i = 0; i < gl->gl_pathc; i++) {
+        struct cache_entry e;
+        size_t len = strlen (gl->gl_pathv[i]) + 1;
+
+        cache_entry_set (&e, &sb[i]);
+        if (path + len > data
+            || memcmp (path, gl->gl_pathv[i], len) != 0
+            || memcmp (&entry[i], &e, sizeof (e)) != 0)
+            goto done;
+        path += len;
+    }
+    if (path != data
+        || !(obj = json_loadb (data, hdr->datalen, 0, NULL))
+        || !json_is_object (obj))
+        goto error;
+    /* Path security of the source files may depend on the merged result,
+     * so check it against both.
+     */
+    if (paranoid || check_file_permissions (obj)) {
+        for (i = 0; i < gl->gl_pathc; i++) {
+            struct path_error path_error;
+            if (!path_is_secure (gl->gl_pathv[i], &path_error))
+                goto error;
+        }
+    }
+    goto done;
+error:
+    json_decref (obj);
+    obj = NULL;
+done:
+    if (map != MAP_FAILED)
+        (void)munmap (map, size);
+    close (fd);
+    return obj;
+}
+
+static int write_all (int fd, const void *buf, size_t len)
+{
+    const char *cp = buf;
+
+    while (len > 0) {
+        ssize_t n = write (fd, cp, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        cp += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Replace 'cachepath' with merged configuration 'obj' compiled from the
+ * files in 'gl', whose stat was taken in 'sb' before they were parsed.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+static int cache_write (const char *cachepath,
+                        const glob_t *gl,
+                        const struct stat *sb,
+                        const BYTE *digest,
+                        json_t *obj)
+{
+    struct cache_header hdr;
+    char tmp[PATH_MAX + 1];
+    char *data = NULL;
+    size_t pathsz = 0;
+    size_t i;
+    int fd = -1;
+    int saved_errno;
+
+    if (snprintf (tmp, sizeof (tmp), "%s.XXXXXX", cachepath)
+                                                    >= (int)sizeof (tmp)) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (i = 0; i < gl->gl_pathc; i++)
+        pathsz += strlen (gl->gl_pathv[i]) + 1;
+    if (pathsz > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(data = json_dumps (obj, JSON_COMPACT))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, CACHE_MAGIC, sizeof (hdr.magic));
+    hdr.nfiles = gl->gl_pathc;
+    hdr.pathsz = pathsz;
+    hdr.datalen = strlen (data);
+    memcpy (hdr.digest, digest, sizeof (hdr.digest));
+
+    if ((fd = mkstemp (tmp)) < 0)
+        goto error;
+    if (fchmod (fd, 0644) < 0 || write_all (fd, &hdr, sizeof (hdr)) < 0)
+        goto error_unlink;
+    for (i = 0; i < gl->gl_pathc; i++) {
+        struct cache_entry e;
+        cache_entry_set (&e, &sb[i]);
+        if (write_all (fd, &e, sizeof (e)) < 0)
+            goto error_unlink;
+    }
+    for (i = 0; i < gl->gl_pathc; i++) {
+        if (write_all (fd, gl->gl_pathv[i], strlen (gl->gl_pathv[i]) + 1) < 0)
+            goto error_unlink;
+    }
+    if (write_all (fd, data, hdr.datalen) < 0
+        || close (fd) < 0)
+        goto error_unlink_noclose;
+    if (rename (tmp, cachepath) < 0)
+        goto error_unlink_noclose;
+    free (data);
+    return 0;
+error_unlink:
+    saved_errno = errno;
+    close (fd);
+    errno = saved_errno;
+error_unlink_noclose:
+    saved_errno = errno;
+    (void)unlink (tmp);
+    errno = saved_errno;
+error:
+    saved_errno = errno;
+    free (data);
+    errno = saved_errno;
+    return -1;
+}
+
+/* Merge files matching 'pattern' into 'cf' as described for
+ * cf_update_glob().  If 'cachepath' is non-NULL, try to load the result
+ * from the cache first, and if 'update' is true, (re)compile the cache
+ * if it is stale.
+ */
+static int update_glob (cf_t *cf,
+                        const char *pattern,
+                        const char *cachepath,
+                        bool update,
+                        struct cf_error *error)
 {
     cf_t *tmp;
     glob_t gl;
@@ -372,6 +763,25 @@ int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
     int count = -1;
     int errnum = 0;
     int rc = glob (pattern, GLOB_ERR, NULL, &gl);
+    struct stat *sb = NULL;
+    BYTE digest[SHA256_BLOCK_SIZE];
+
+    /* Stat source files before they are parsed, so that a change made
+     * while parsing leaves the compiled cache stale rather than wrong.
+     */
+    if (cachepath && rc == 0) {
+        if (!(sb = calloc (gl.gl_pathc, sizeof (sb[0])))
+            || cache_digest (cf, digest) < 0)
+            cachepath = NULL;
+        for (i = 0; cachepath && i < gl.gl_pathc; i++) {
+            if (stat (gl.gl_pathv[i], &sb[i]) < 0)
+                cachepath = NULL;
+        }
+        if (cachepath && (tmp = cache_load (cf, cachepath, &gl, sb, digest))) {
+            count = gl.gl_pathc;
+            goto update;
+        }
+    }
 
     tmp = cf_copy (cf);
 
@@ -386,6 +796,8 @@ int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
                 }
                 count++;
             }
+            if (count > 0 && cachepath && update)
+                (void)cache_write (cachepath, &gl, sb, digest, tmp);
             break;
         case GLOB_NOMATCH:
             count = 0;
@@ -400,7 +812,9 @@ int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
             errnum = EINVAL;
             break;
     }
+update:
     globfree (&gl);
+    free (sb);
 
     /*
      *  If glob sucessfully processed at least one file, update
@@ -416,6 +830,49 @@ int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
     return (count);
 }
 
+int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error)
+{
+    return update_glob (cf, pattern, NULL, false, error);
+}
+
+int cf_update_glob_cached (cf_t *cf,
+                           const char *pattern,
+                           const char *cachepath,
+                           int flags,
+                           struct cf_error *error)
+{
+    if ((flags & ~CF_CACHE_UPDATE)) {
+        errprintf (error, pattern, -1, "invalid flags");
+        errno = EINVAL;
+        return -1;
+    }
+    return update_glob (cf,
+                        pattern,
+                        cachepath,
+                        flags & CF_CACHE_UPDATE,
+                        error);
+}
+
+int cf_cache_path (const char *pattern, char *buf, int bufsz)
+{
+    const char *p;
+    int len;
+
+    if (!pattern || !buf || !(p = strrchr (pattern, '/'))) {
+        errno = EINVAL;
+        return -1;
+    }
+    len = p - pattern;
+    if (memchr (pattern, '*', len)
+        || memchr (pattern, '?', len)
+        || memchr (pattern, '[', len)
+        || snprintf (buf, bufsz, "%.*s/.cf-cache", len, pattern) >= bufsz) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
 static bool is_end_marker (struct cf_option opt)
 {
     const struct cf_option end = CF_OPTIONS_TABLE_END;
@@ -92,6 +92,13 @@ time_t cf_timestamp (const cf_t *cf);     // default: 0
  */
 int cf_array_size (const cf_t *cf);
 
+/* Call 'fn' with each key and value in table 'cf'.
+ * If 'fn' returns < 0, stop and return -1.  If cf is NULL or is not a
+ * table, 'fn' is not called.  Return 0 on success.
+ */
+typedef int (*cf_table_f) (const char *key, const cf_t *val, void *arg);
+int cf_table_foreach (const cf_t *cf, cf_table_f fn, void *arg);
+
 /* Return true if array contains string str.
  * Return false if cf is NULL, is not an array, or doesn't contain str.
  */
@@ -101,6 +108,25 @@ bool cf_array_contains (const cf_t *cf, const char *str);
  */
 bool cf_array_contains_match (const cf_t *cf, const char *str);
 
+/* Compiled set of the strings in array 'cf', for constant time lookups
+ * of literal strings.  With CF_SET_MATCH, entries are glob(7) patterns as
+ * for cf_array_contains_match(), and only those containing special
+ * characters are matched with fnmatch(3).  Non-string entries are ignored.
+ * A NULL 'cf' creates an empty set.  Destroy with cf_set_destroy().
+ * Return set on success, or NULL on failure with errno set.
+ */
+enum {
+    CF_SET_MATCH = 1,
+};
+
+struct cf_set *cf_set_create (const cf_t *cf, int flags);
+void cf_set_destroy (struct cf_set *set);
+
+/* Return true if 'str' is in (or matches a pattern in) 'set'.
+ * Return false if 'set' is NULL.
+ */
+bool cf_set_contains (const struct cf_set *set, const char *str);
+
 /* Update table 'cf' with info parsed from TOML 'buf' or 'filename'.
  * On success return 0.  On failure, return -1 with errno set.
  * If error is non-NULL, write error description there.
@@ -125,6 +151,35 @@ int cf_update_pack (cf_t *cf, struct cf_error *error, const char *fmt, ...);
  */
 int cf_update_glob (cf_t *cf, const char *pattern, struct cf_error *error);
 
+/* Same as cf_update_glob(), but load the merged result of the files from
+ * the compiled cache 'cachepath' if it is still valid: it must be a regular
+ * file owned by root or the caller and writable only by its owner, the
+ * files matching 'pattern' and their stat(2) must be the same as when it
+ * was compiled, 'cf' must have had the same contents, and the files must
+ * still pass path security checks if enabled.  Otherwise, parse the files,
+ * and if 'flags' includes CF_CACHE_UPDATE, try to replace the cache with
+ * the result (failure to do so is not an error).  Callers should only set
+ * CF_CACHE_UPDATE when they are expected to be able to write the cache,
+ * e.g. not in a setuid program run by an unprivileged user.  If
+ * 'cachepath' is NULL, this is equivalent to cf_update_glob().
+ */
+enum {
+    CF_CACHE_UPDATE = 1,
+};
+
+int cf_update_glob_cached (cf_t *cf,
+                           const char *pattern,
+                           const char *cachepath,
+                           int flags,
+                           struct cf_error *error);
+
+/* Build the conventional cache path for 'pattern' in 'buf': the file
+ * .cf-cache in the directory part of 'pattern'.  Return 0 on success,
+ * or -1 with errno set if the directory part contains wildcards or
+ * 'buf' is too small.
+ */
+int cf_cache_path (const char *pattern, char *buf, int bufsz);
+
 /* Apply 'opts' to table 'cf' according to flags.
  * On success return 0.  On failure, return -1 with errno set.
  * If error is non-NULL, write error description there.
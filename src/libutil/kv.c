@@ -21,6 +21,7 @@
 #include <time.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "timestamp.h"
 #include "kv.h"
@@ -28,17 +29,56 @@
 
 #define KV_CHUNK 4096
 
+/* A side index is built once a linear key lookup has to look at more than
+ * KV_INDEX_THRESHOLD entries.  It is an open addressing (linear probing)
+ * hash table of entry offset + 1, with 0 marking an empty slot.  The
+ * index is only a cache: the buffer and its encoding are unchanged, and
+ * if the index can't be allocated, lookups fall back to a linear scan.
+ *
+ * Deleting an entry moves all following entries down.  Rather than
+ * adjusting every slot on each delete, slots hold offsets as they were
+ * before the last KV_INDEX_MAXDEL deletions, and those deletions are
+ * kept sorted by that same (pre-deletion) offset, with a running total
+ * of their lengths, so an offset is corrected with a binary search.
+ * Appended entries are stored with the total deleted length added.
+ */
+#define KV_INDEX_THRESHOLD 32
+#define KV_INDEX_MINSIZE 64
+#define KV_INDEX_MAXDEL 64
+
+struct kv_index {
+    int size;       // power of 2
+    int count;
+    int ndel;
+    int del_offset[KV_INDEX_MAXDEL];    // sorted
+    int del_sum[KV_INDEX_MAXDEL + 1];   // del_sum[n] = length of first n
+    int slots[];
+};
+
 struct kv {
     char *buf;
     int bufsz;
     int len;
+    struct kv_index *index;
+    bool readonly;      // view: buf is borrowed
+    char *prefix;       // view: only entries with prefix, prefix removed
+    int prefixlen;
 };
 
+static void kv_index_drop (struct kv *kv)
+{
+    free (kv->index);
+    kv->index = NULL;
+}
+
 void kv_destroy (struct kv *kv)
 {
     if (kv) {
         int saved_errno = errno;
-        free (kv->buf);
+        free (kv->index);
+        if (!kv->readonly)
+            free (kv->buf);
+        free (kv->prefix);
         free (kv);
         errno = saved_errno;
     }
@@ -80,33 +120,102 @@ struct kv *kv_copy (const struct kv *kv)
         errno = EINVAL;
         return NULL;
     }
+    if (kv->prefixlen > 0)
+        return kv_split (kv, NULL);
     return kv_create_from (kv->buf, kv->len);
 }
 
+/* Compare entry by entry, for prefix views whose entries are not
+ * contiguous in their buffer.
+ */
+static bool kv_equal_entries (const struct kv *kv1, const struct kv *kv2)
+{
+    const char *key1 = NULL;
+    const char *key2 = NULL;
+
+    for (;;) {
+        key1 = kv_next (kv1, key1);
+        key2 = kv_next (kv2, key2);
+        if (!key1 || !key2)
+            break;
+        if (strcmp (key1, key2) != 0
+            || kv_typeof (key1) != kv_typeof (key2)
+            || strcmp (kv_val_string (key1), kv_val_string (key2)) != 0)
+            return false;
+    }
+    return key1 == key2;
+}
+
 bool kv_equal (const struct kv *kv1, const struct kv *kv2)
 {
     if (!kv1 || !kv2)
         return false;
+    if (kv1->prefixlen > 0 || kv2->prefixlen > 0)
+        return kv_equal_entries (kv1, kv2);
     if (kv1->len != kv2->len)
         return false;
-    if (memcmp (kv1->buf, kv2->buf, kv1->len) != 0)
+    if (kv1->len > 0 && memcmp (kv1->buf, kv2->buf, kv1->len) != 0)
         return false;
     return true;
 }
 
+/* Resize kv buffer to 'size' bytes, which must be at least kv->len.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int kv_resize (struct kv *kv, int size)
+{
+    char *new;
+
+    if (!(new = realloc (kv->buf, size)))
+        return -1;
+    kv->buf = new;
+    kv->bufsz = size;
+    return 0;
+}
+
 /* Grow kv buffer until it can accommodate 'needsz' new characters.
+ * The buffer at least doubles each time so that building a large object
+ * takes O(log n) reallocations.
  * Returns 0 on success, -1 on failure with errno set.
  */
 static int kv_expand (struct kv *kv, int needsz)
 {
-    char *new;
-    while (kv->bufsz - kv->len < needsz) {
-        if (!(new = realloc (kv->buf, kv->bufsz + KV_CHUNK)))
-            return -1;
-        kv->buf = new;
-        kv->bufsz += KV_CHUNK;
+    int size;
+
+    if (kv->bufsz - kv->len >= needsz)
+        return 0;
+    if (needsz > INT_MAX - kv->len) {
+        errno = ENOMEM;
+        return -1;
     }
-    return 0;
+    size = kv->bufsz > 0 ? kv->bufsz : KV_CHUNK;
+    while (size - kv->len < needsz) {
+        if (size > INT_MAX / 2) {
+            size = kv->len + needsz;
+            break;
+        }
+        size *= 2;
+    }
+    return kv_resize (kv, size);
+}
+
+int kv_reserve (struct kv *kv, int size)
+{
+    if (!kv || size < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (kv->readonly) {
+        errno = EROFS;
+        return -1;
+    }
+    if (kv->bufsz - kv->len >= size)
+        return 0;
+    if (size > INT_MAX - kv->len) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return kv_resize (kv, kv->len + size);
 }
 
 static bool valid_key (const char *key)
@@ -116,6 +225,180 @@ static bool valid_key (const char *key)
     return true;
 }
 
+/* FNV-1a hash of NUL terminated 'key'.
+ */
+static unsigned int key_hash (const char *key)
+{
+    unsigned int h = 2166136261U;
+
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+/* Convert 'offset' from before logged deletions to current offset.
+ */
+static int kv_index_adjust (const struct kv_index *index, int offset)
+{
+    int lo = 0;
+    int hi = index->ndel;
+
+    /* Find number of logged deletions at lower offsets */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (index->del_offset[mid] < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return offset - index->del_sum[lo];
+}
+
+/* Return current buffer offset for index slot 'i'.
+ */
+static int kv_index_offset (const struct kv_index *index, int i)
+{
+    return kv_index_adjust (index, index->slots[i] - 1);
+}
+
+static void kv_index_insert (struct kv *kv, int offset)
+{
+    struct kv_index *index = kv->index;
+    int mask = index->size - 1;
+    int i = key_hash (kv->buf + offset) & mask;
+
+    while (index->slots[i] != 0)
+        i = (i + 1) & mask;
+    index->slots[i] = offset + index->del_sum[index->ndel] + 1;
+    index->count++;
+}
+
+/* (Re)build the index from all entries in the buffer, with room for
+ * at least as many again.  On failure, leave kv without an index.
+ */
+static void kv_index_build (struct kv *kv)
+{
+    const char *entry = NULL;
+    int count = 0;
+    int size = KV_INDEX_MINSIZE;
+
+    kv_index_drop (kv);
+    while ((entry = kv_next (kv, entry)))
+        count++;
+    while (size < count * 4) {
+        if (size > INT_MAX / 8)
+            return;
+        size *= 2;
+    }
+    if (!(kv->index = calloc (1, sizeof (*kv->index)
+                                 + size * sizeof (kv->index->slots[0]))))
+        return;
+    kv->index->size = size;
+    while ((entry = kv_next (kv, entry)))
+        kv_index_insert (kv, entry - kv->buf);
+}
+
+/* Add entry at 'offset', just appended to the buffer, to the index.
+ * Keep the load factor at or below 1/2.
+ */
+static void kv_index_add (struct kv *kv, int offset)
+{
+    if (!kv->index)
+        return;
+    if ((kv->index->count + 1) * 2 > kv->index->size)
+        kv_index_build (kv); // includes new entry
+    else
+        kv_index_insert (kv, offset);
+}
+
+/* Remove entry at 'offset' with length 'entry_len' from the index, and
+ * log the deletion.  Call before the entry is removed from the buffer.
+ */
+static void kv_index_remove (struct kv *kv, int offset, int entry_len)
+{
+    struct kv_index *index = kv->index;
+    int mask;
+    int i;
+    int j;
+
+    if (!index)
+        return;
+    mask = index->size - 1;
+    i = key_hash (kv->buf + offset) & mask;
+    while (kv_index_offset (index, i) != offset) {
+        assert (index->slots[i] != 0);
+        i = (i + 1) & mask;
+    }
+    /* Backward shift deletion: move later members of the probe
+     * sequence into the hole so lookups need no tombstones.
+     */
+    j = i;
+    for (;;) {
+        int k;
+        j = (j + 1) & mask;
+        if (index->slots[j] == 0)
+            break;
+        k = key_hash (kv->buf + kv_index_offset (index, j)) & mask;
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+    index->slots[i] = 0;
+    index->count--;
+
+    /* Shrink when mostly empty.  The entry being deleted is still in the
+     * buffer and will be reindexed, so drop the index and let the next
+     * long lookup rebuild it.
+     */
+    if (index->size > KV_INDEX_MINSIZE && index->count * 8 < index->size) {
+        kv_index_drop (kv);
+        return;
+    }
+
+    /* When the log is full, apply it to all slots and start over.
+     */
+    if (index->ndel == KV_INDEX_MAXDEL) {
+        for (i = 0; i < index->size; i++) {
+            if (index->slots[i] != 0)
+                index->slots[i] = kv_index_offset (index, i) + 1;
+        }
+        index->ndel = 0;
+    }
+    /* Convert 'offset' to its value before logged deletions, then insert
+     * the deletion in sorted order.
+     */
+    for (i = 0; i < index->ndel; i++) {
+        if (index->del_offset[i] > offset)
+            break;
+        offset += index->del_sum[i + 1] - index->del_sum[i];
+    }
+    for (j = index->ndel; j > i; j--) {
+        index->del_offset[j] = index->del_offset[j - 1];
+        index->del_sum[j + 1] = index->del_sum[j] + entry_len;
+    }
+    index->del_offset[i] = offset;
+    index->del_sum[i + 1] = index->del_sum[i] + entry_len;
+    index->ndel++;
+}
+
+static const char *kv_index_find (const struct kv *kv, const char *key)
+{
+    const struct kv_index *index = kv->index;
+    int mask = index->size - 1;
+    int i = key_hash (key) & mask;
+
+    while (index->slots[i] != 0) {
+        const char *entry = kv->buf + kv_index_offset (index, i);
+        if (!strcmp (key, entry))
+            return entry;
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
 /* Look up entry by key (and type if type != KV_UNKNOWN).
  * Returns entry on success, NULL on failure with errno set.
  */
@@ -123,17 +406,29 @@ static const char *kv_find (const struct kv *kv, const char *key,
                             enum kv_type type)
 {
     const char *entry = NULL;
+    int count = 0;
 
     if (!kv || !valid_key (key)) {
         errno = EINVAL;
         return NULL;
     }
-    while ((entry = kv_next (kv, entry))) {
-        if (!strcmp (key, entry)) {
-            if (type == KV_UNKNOWN || kv_typeof (entry) == type)
-                return entry;
-            break;
+    if (kv->index)
+        entry = kv_index_find (kv, key);
+    else {
+        while ((entry = kv_next (kv, entry))) {
+            if (!strcmp (key, entry))
+                break;
+            count++;
         }
+        /* The index is a cache, so building it doesn't change the
+         * logical contents of kv, even though kv is const here.
+         */
+        if (count > KV_INDEX_THRESHOLD)
+            kv_index_build ((struct kv *)kv);
+    }
+    if (entry) {
+        if (type == KV_UNKNOWN || kv_typeof (entry) == type)
+            return entry;
     }
     errno = ENOENT;
     return NULL;
@@ -164,11 +459,16 @@ int kv_delete (struct kv *kv, const char *key)
     int entry_offset;
     int entry_len;
 
+    if (kv && kv->readonly) {
+        errno = EROFS;
+        return -1;
+    }
     if (!(entry = kv_find (kv, key, KV_UNKNOWN)))
         return -1;
     entry_offset = entry - kv->buf;
     entry_len = entry_length (entry, kv->len - entry_offset);
     assert (entry_len >= 0);
+    kv_index_remove (kv, entry_offset, entry_len);
     memmove (kv->buf + entry_offset,
              kv->buf + entry_offset + entry_len,
              kv->len - entry_offset - entry_len);
@@ -176,6 +476,34 @@ int kv_delete (struct kv *kv, const char *key)
     return 0;
 }
 
+/* Append entry with key 'prefix' + 'key' (prefix may be NULL) without
+ * checking for an existing entry with the same key.
+ * Only use when the key is known not to be present in 'kv'.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int kv_append_raw (struct kv *kv, const char *prefix, const char *key,
+                          enum kv_type type, const char *val)
+{
+    int prefixlen = prefix ? strlen (prefix) : 0;
+    int keylen = strlen (key);
+    int vallen = strlen (val);
+    int offset = kv->len;
+    // prefixkey\0Tval\0
+    if (kv_expand (kv, prefixlen + keylen + vallen + 3) < 0)
+        return -1;
+    if (prefixlen > 0) {
+        memcpy (&kv->buf[kv->len], prefix, prefixlen);
+        kv->len += prefixlen;
+    }
+    strlcpy (&kv->buf[kv->len], key, keylen + 1);
+    kv->len += keylen + 1;
+    kv->buf[kv->len++] = type;
+    strlcpy (&kv->buf[kv->len], val, vallen + 1);
+    kv->len += vallen + 1;
+    kv_index_add (kv, offset);
+    return 0;
+}
+
 /* Put 'val' of a given type that has been already been converted to a string.
  * Returns 0 on success, -1 on failure with errno set.
  */
@@ -186,41 +514,37 @@ static int kv_put_raw (struct kv *kv, const char *key, enum kv_type type,
         errno = EINVAL;
         return -1;
     }
+    if (kv->readonly) {
+        errno = EROFS;
+        return -1;
+    }
     if (kv_delete (kv, key) < 0) {
         if (errno != ENOENT)
             return -1;
     }
-    int keylen = strlen (key);
-    int vallen = strlen (val);
-    if (kv_expand (kv, keylen + vallen + 3) < 0) // key\0Tval\0
-        return -1;
-    strlcpy (&kv->buf[kv->len], key, keylen + 1);
-    kv->len += keylen + 1;
-    kv->buf[kv->len++] = type;
-    strlcpy (&kv->buf[kv->len], val, vallen + 1);
-    kv->len += vallen + 1;
-    return 0;
+    return kv_append_raw (kv, NULL, key, type, val);
 }
 
-int kv_vput (struct kv *kv, const char *key, enum kv_type type, va_list ap)
+/* Convert value of 'type' from 'ap' to a string, using 's' of 'size'
+ * bytes for storage if needed.  Return string or NULL if invalid.
+ */
+static const char *kv_vformat (enum kv_type type, va_list ap,
+                               char *s, int size)
 {
-    char s[80];
     const char *val = NULL;
 
-    if (!kv || !valid_key (key))
-        goto inval;
     switch (type) {
         case KV_STRING:
             val = va_arg (ap, const char *);
             break;
         case KV_INT64:
-            if (vsnprintf (s, sizeof (s), "%" PRIi64, ap) >= sizeof (s))
-                goto inval;
+            if (vsnprintf (s, size, "%" PRIi64, ap) >= size)
+                return NULL;
             val = s;
             break;
         case KV_DOUBLE:
-            if (vsnprintf (s, sizeof (s), "%f", ap) >= sizeof (s))
-                goto inval;
+            if (vsnprintf (s, size, "%f", ap) >= size)
+                return NULL;
             val = s;
             break;
         case KV_BOOL: {
@@ -230,20 +554,57 @@ int kv_vput (struct kv *kv, const char *key, enum kv_type type, va_list ap)
         }
         case KV_TIMESTAMP: {
             time_t t = va_arg (ap, time_t);
-            if (timestamp_tostr (t, s, sizeof (s)) < 0)
-                goto inval;
+            if (timestamp_tostr (t, s, size) < 0)
+                return NULL;
             val = s;
             break;
         }
         default:
-            goto inval;
+            break;
+    }
+    return val;
+}
+
+int kv_vput (struct kv *kv, const char *key, enum kv_type type, va_list ap)
+{
+    char s[80];
+    const char *val;
+
+    if (!kv || !valid_key (key)
+        || !(val = kv_vformat (type, ap, s, sizeof (s)))) {
+        errno = EINVAL;
+        return -1;
     }
-    if (!val)
-        goto inval;
     return kv_put_raw (kv, key, type, val);
-inval:
-    errno = EINVAL;
-    return -1;
+}
+
+int kv_vappend (struct kv *kv, const char *key, enum kv_type type,
+                va_list ap)
+{
+    char s[80];
+    const char *val;
+
+    if (!kv || !valid_key (key)
+        || !(val = kv_vformat (type, ap, s, sizeof (s)))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (kv->readonly) {
+        errno = EROFS;
+        return -1;
+    }
+    return kv_append_raw (kv, NULL, key, type, val);
+}
+
+int kv_append (struct kv *kv, const char *key, enum kv_type type, ...)
+{
+    va_list ap;
+    int rc;
+
+    va_start (ap, type);
+    rc = kv_vappend (kv, key, type, ap);
+    va_end (ap);
+    return rc;
 }
 
 int kv_put (struct kv *kv, const char *key, enum kv_type type, ...)
@@ -257,22 +618,42 @@ int kv_put (struct kv *kv, const char *key, enum kv_type type, ...)
     return rc;
 }
 
-const char *kv_next (const struct kv *kv, const char *key)
+/* Return the entry following 'entry' in the buffer, or the first
+ * entry if 'entry' is NULL.  Return NULL at the end of the buffer.
+ */
+static const char *next_entry (const struct kv *kv, const char *entry)
 {
     int entry_len;
     int entry_offset;
 
-    if (!kv || kv->len == 0)
+    if (kv->len == 0)
         return NULL;
-    if (!key)
+    if (!entry)
         return kv->buf;
-    if (key < kv->buf || key > kv->buf + kv->len)
+    if (entry < kv->buf || entry > kv->buf + kv->len)
         return NULL;
-    entry_offset = key - kv->buf;
-    entry_len = entry_length (key, kv->len - entry_offset);
+    entry_offset = entry - kv->buf;
+    entry_len = entry_length (entry, kv->len - entry_offset);
     if (entry_len < 0 || entry_offset + entry_len == kv->len)
         return NULL;
-    return key + entry_len;
+    return entry + entry_len;
+}
+
+const char *kv_next (const struct kv *kv, const char *key)
+{
+    const char *entry;
+
+    if (!kv)
+        return NULL;
+    if (kv->prefixlen == 0)
+        return next_entry (kv, key);
+    entry = key ? key - kv->prefixlen : NULL;
+    while ((entry = next_entry (kv, entry))) {
+        if (!strncmp (entry, kv->prefix, kv->prefixlen)
+            && entry[kv->prefixlen] != '\0')
+            return entry + kv->prefixlen;
+    }
+    return NULL;
 }
 
 const char *kv_val_string (const char *key)
@@ -423,7 +804,7 @@ inval:
 
 int kv_encode (const struct kv *kv, const char **buf, int *len)
 {
-    if (!kv || !buf || !len) {
+    if (!kv || !buf || !len || kv->prefixlen > 0) {
         errno = EINVAL;
         return -1;
     }
@@ -468,10 +849,59 @@ static int kv_put_prefix (struct kv *kv, const char *prefix, const char *key,
     return 0;
 }
 
+/* Return true if no key in 'kv' can equal 'prefix' + a non-empty key,
+ * i.e. if kv is empty or (with a prefix) no key in kv starts with prefix.
+ */
+static bool kv_prefix_is_fresh (const struct kv *kv, const char *prefix)
+{
+    const char *key = NULL;
+    int n = prefix ? strlen (prefix) : 0;
+
+    if (n == 0)
+        return kv->len == 0;
+    while ((key = kv_next (kv, key))) {
+        if (!strncmp (key, prefix, n))
+            return false;
+    }
+    return true;
+}
+
+/* Append all kv2 entries to kv1 with 'prefix' prepended to their keys.
+ * The caller ensures no resulting key is already in kv1.
+ */
+static int kv_join_append (struct kv *kv1, const struct kv *kv2,
+                           const char *prefix)
+{
+    const char *key = NULL;
+    size_t n = prefix ? strlen (prefix) : 0;
+    size_t size = 0;
+
+    while ((key = kv_next (kv2, key))) {
+        const char *val = kv_val_string (key);
+        size += n + (val - key) + strlen (val) + 1;
+        if (size > INT_MAX) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    if (kv_reserve (kv1, size) < 0)
+        return -1;
+    while ((key = kv_next (kv2, key))) {
+        if (kv_append_raw (kv1, prefix, key, kv_typeof (key),
+                                            kv_val_string (key)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
 int kv_join (struct kv *kv1, const struct kv *kv2, const char *prefix)
 {
     const char *key = NULL;
 
+    if (kv1 && kv2 && kv1 != kv2 && !kv1->readonly
+        && kv_prefix_is_fresh (kv1, prefix))
+        return kv_join_append (kv1, kv2, prefix);
+
     while ((key = kv_next (kv2, key))) {
         if (kv_put_prefix (kv1, prefix, key, kv_typeof (key),
                                              kv_val_string (key)) < 0)
@@ -480,7 +910,55 @@ int kv_join (struct kv *kv1, const struct kv *kv2, const char *prefix)
     return 0;
 }
 
-struct kv *kv_split (const struct kv *kv1, const char *prefix)
+struct kv *kv_view (const char *buf, int len)
+{
+    struct kv *kv;
+
+    if (len < 0 || (len > 0 && !buf)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(kv = calloc (1, sizeof (*kv))))
+        return NULL;
+    kv->buf = (char *)buf;
+    kv->bufsz = kv->len = len;
+    kv->readonly = true;
+    if (kv_check_integrity (kv) < 0) {
+        kv_destroy (kv);
+        return NULL;
+    }
+    return kv;
+}
+
+struct kv *kv_view_prefix (const struct kv *kv, const char *prefix)
+{
+    struct kv *view;
+
+    if (!kv) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(view = calloc (1, sizeof (*view))))
+        return NULL;
+    view->buf = kv->buf;
+    view->bufsz = view->len = kv->len;
+    view->readonly = true;
+    if (asprintf (&view->prefix,
+                  "%s%s",
+                  kv->prefix ? kv->prefix : "",
+                  prefix ? prefix : "") < 0) {
+        view->prefix = NULL;
+        kv_destroy (view);
+        return NULL;
+    }
+    view->prefixlen = strlen (view->prefix);
+    return view;
+}
+
+struct kv *kv_split_filter (const struct kv *kv1,
+                            const char *prefix,
+                            kv_filter_f filter,
+                            void *arg)
 {
     const char *key = NULL;
     struct kv *kv2;
@@ -488,16 +966,33 @@ struct kv *kv_split (const struct kv *kv1, const char *prefix)
 
     if (!(kv2 = kv_create ()))
         return NULL;
+    /* The result can be no larger than kv1, so allocate that up front.
+     * Keys in kv1 are unique, so entries may be appended without the
+     * duplicate check done by kv_put_raw().
+     */
+    if (kv1 && kv1->len > 0) {
+        if (!(kv2->buf = malloc (kv1->len)))
+            goto error;
+        kv2->bufsz = kv1->len;
+    }
     while ((key = kv_next (kv1, key))) {
-        if (strlen (key) > n && !strncmp (key, prefix, n)) {
-            if (kv_put_raw (kv2, key + n, kv_typeof (key),
-                                          kv_val_string (key)) < 0) {
-                kv_destroy (kv2);
-                return NULL;
-            }
+        if (strlen (key) > n && (n == 0 || !strncmp (key, prefix, n))) {
+            if (filter && !filter (key + n, arg))
+                continue;
+            if (kv_append_raw (kv2, NULL, key + n, kv_typeof (key),
+                                                   kv_val_string (key)) < 0)
+                goto error;
         }
     }
     return kv2;
+error:
+    kv_destroy (kv2);
+    return NULL;
+}
+
+struct kv *kv_split (const struct kv *kv1, const char *prefix)
+{
+    return kv_split_filter (kv1, prefix, NULL, NULL);
 }
 
 void kv_environ_destroy (char ***envp)
@@ -586,10 +1081,23 @@ struct kv *kv_encode_argv (const char **argv)
     }
     if (!(kv = kv_create ()))
         return NULL;
+    /* Keys are unique by construction, so reserve the full size and
+     * append without duplicate checks.
+     */
+    size_t size = 0;
+    for (int i = 0; argv[i] != NULL; i++) {
+        size += 21 + strlen (argv[i]) + 2; // key\0Tval\0, key < 21 chars
+        if (size > INT_MAX) {
+            errno = ENOMEM;
+            goto error;
+        }
+    }
+    if (kv_reserve (kv, size) < 0)
+        goto error;
     for (int i = 0; argv[i] != NULL; i++) {
         char key [21];
         (void) sprintf (key, "%d", i);
-        if (kv_put (kv, key, KV_STRING, argv[i]) < 0)
+        if (kv_append_raw (kv, NULL, key, KV_STRING, argv[i]) < 0)
             goto error;
     }
     return kv;
@@ -16,6 +16,9 @@
  *
  * T=single-char type hint:
  *   s=string, i=int64_t, d=double, b=bool, t=timestamp
+ *
+ * Objects with many keys get a hashed side index for key lookups.
+ * It is internal and does not affect the encoding.
  */
 
 #include <stdbool.h>
@@ -39,7 +42,9 @@ void kv_destroy (struct kv *kv);
 struct kv *kv_copy (const struct kv *kv);
 
 /* Add kv2 entries to kv1, prepending 'prefix' to its keys (if non-NULL).
- * When there are key conflicts, values from kv2 override kv1.
+ * When there are key conflicts, values from kv2 override kv1.  If kv1 is
+ * empty or has no keys starting with 'prefix', entries are appended
+ * without per-key conflict checks.
  * Return 0 on success, -1 on failure with errno set.
  */
 int kv_join (struct kv *kv1, const struct kv *kv2, const char *prefix);
@@ -50,6 +55,34 @@ int kv_join (struct kv *kv1, const struct kv *kv2, const char *prefix);
  */
 struct kv *kv_split (const struct kv *kv, const char *prefix);
 
+/* Like kv_split(), but only keep entries for which 'filter' returns true
+ * when passed the key with prefix removed.  A NULL 'filter' keeps all
+ * matching entries.  The new kv object is built in a single pass.
+ * Returns new kv object on success, NULL on failure with errno set.
+ */
+typedef bool (*kv_filter_f)(const char *key, void *arg);
+struct kv *kv_split_filter (const struct kv *kv,
+                            const char *prefix,
+                            kv_filter_f filter,
+                            void *arg);
+
+/* Create a read-only view of encoded kv 'buf' of length 'len'.  Like
+ * kv_decode(), the buffer is validated, but it is not copied, so it must
+ * remain valid and unchanged until the view is destroyed with
+ * kv_destroy().  Functions that would modify a view fail with EROFS.
+ * Returns view on success, NULL on failure with errno set.
+ */
+struct kv *kv_view (const char *buf, int len);
+
+/* Create a read-only view of the entries in 'kv' with key prefix 'prefix',
+ * with the prefix removed, like kv_split() but without copying.  'kv' must
+ * not be modified or destroyed while the view exists.  kv_encode() fails
+ * with EINVAL on a prefix view since its entries are not contiguous;
+ * use kv_copy() to obtain an ordinary kv object.
+ * Returns view on success, NULL on failure with errno set.
+ */
+struct kv *kv_view_prefix (const struct kv *kv, const char *prefix);
+
 /* Return true if kv1 is identical to kv2 (including entry order)
  */
 bool kv_equal (const struct kv *kv1, const struct kv *kv2);
@@ -71,6 +104,21 @@ int kv_delete (struct kv *kv, const char *key);
 int kv_vput (struct kv *kv, const char *key, enum kv_type type, va_list ap);
 int kv_put (struct kv *kv, const char *key, enum kv_type type, ...);
 
+/* Builder interface for constructing large kv objects.
+ * kv_reserve() ensures there is room for 'size' more bytes of encoded
+ * entries (key\0Tvalue\0) without reallocation.  kv_append() is like
+ * kv_put() but does not check for an existing entry with the same key,
+ * so the caller must know that 'key' is not already present.
+ * Return 0 on success, -1 on failure with errno set:
+ *   EINVAL - invalid argument
+ *   ENOMEM - out of memory
+ *   EROFS - kv is a read-only view
+ */
+int kv_reserve (struct kv *kv, int size);
+int kv_vappend (struct kv *kv, const char *key, enum kv_type type,
+                va_list ap);
+int kv_append (struct kv *kv, const char *key, enum kv_type type, ...);
+
 /* Find key in kv object and get val (if non-NULL).
  * Return 0 on success, -1 on failure with errno set:
  *   EINVAL - invalid argument
@@ -0,0 +1,218 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "merkle.h"
+
+/* Node digests for all levels are stored in one array, leaves first,
+ * then each successive level up to the root.
+ */
+struct merkle {
+    int count;
+    int nodecount;
+    bool built;
+    unsigned char (*node)[MERKLE_DIGEST_SIZE];
+};
+
+enum {
+    MERKLE_LEAF = 0x00,
+    MERKLE_NODE = 0x01,
+};
+
+static void hash_leaf (const void *data, size_t len, unsigned char *digest)
+{
+    BYTE prefix = MERKLE_LEAF;
+    SHA256_CTX shx;
+
+    sha256_init (&shx);
+    sha256_update (&shx, &prefix, 1);
+    sha256_update (&shx, data, len);
+    sha256_final (&shx, digest);
+}
+
+static void hash_node (const unsigned char *left,
+                       const unsigned char *right,
+                       unsigned char *digest)
+{
+    BYTE prefix = MERKLE_NODE;
+    SHA256_CTX shx;
+
+    sha256_init (&shx);
+    sha256_update (&shx, &prefix, 1);
+    sha256_update (&shx, left, MERKLE_DIGEST_SIZE);
+    sha256_update (&shx, right, MERKLE_DIGEST_SIZE);
+    sha256_final (&shx, digest);
+}
+
+/* Return total number of nodes in a tree with 'count' leaves.
+ */
+static int total_nodes (int count)
+{
+    int total = count;
+
+    while (count > 1) {
+        count = (count + 1) / 2;
+        total += count;
+    }
+    return total;
+}
+
+struct merkle *merkle_create (int count)
+{
+    struct merkle *m;
+
+    if (count <= 0 || count > 0x3fffffff) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(m = calloc (1, sizeof (*m))))
+        return NULL;
+    m->count = count;
+    m->nodecount = total_nodes (count);
+    if (!(m->node = calloc (m->nodecount, sizeof (m->node[0])))) {
+        free (m);
+        return NULL;
+    }
+    return m;
+}
+
+void merkle_destroy (struct merkle *m)
+{
+    if (m) {
+        int saved_errno = errno;
+        free (m->node);
+        free (m);
+        errno = saved_errno;
+    }
+}
+
+int merkle_set_leaf (struct merkle *m, int index, const void *data, size_t len)
+{
+    if (!m || index < 0 || index >= m->count || (len > 0 && !data)) {
+        errno = EINVAL;
+        return -1;
+    }
+    hash_leaf (data, len, m->node[index]);
+    m->built = false;
+    return 0;
+}
+
+int merkle_build (struct merkle *m)
+{
+    int base = 0;
+    int n;
+
+    if (!m) {
+        errno = EINVAL;
+        return -1;
+    }
+    n = m->count;
+    while (n > 1) {
+        int next = base + n;
+        int i;
+
+        for (i = 0; i + 1 < n; i += 2)
+            hash_node (m->node[base + i], m->node[base + i + 1],
+                       m->node[next + i / 2]);
+        if (n % 2 == 1)
+            memcpy (m->node[next + n / 2], m->node[base + n - 1],
+                    MERKLE_DIGEST_SIZE);
+        base = next;
+        n = (n + 1) / 2;
+    }
+    m->built = true;
+    return 0;
+}
+
+int merkle_root (struct merkle *m, unsigned char *root)
+{
+    if (!m || !root || !m->built) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy (root, m->node[m->nodecount - 1], MERKLE_DIGEST_SIZE);
+    return 0;
+}
+
+int merkle_proof_len (int index, int count)
+{
+    int len = 0;
+
+    if (count <= 0 || index < 0 || index >= count)
+        return -1;
+    while (count > 1) {
+        if ((index ^ 1) < count)
+            len++;
+        index /= 2;
+        count = (count + 1) / 2;
+    }
+    return len;
+}
+
+int merkle_proof (struct merkle *m, int index, unsigned char *proof)
+{
+    int base = 0;
+    int n;
+
+    if (!m || !proof || !m->built || index < 0 || index >= m->count) {
+        errno = EINVAL;
+        return -1;
+    }
+    n = m->count;
+    while (n > 1) {
+        int sibling = index ^ 1;
+        if (sibling < n) {
+            memcpy (proof, m->node[base + sibling], MERKLE_DIGEST_SIZE);
+            proof += MERKLE_DIGEST_SIZE;
+        }
+        base += n;
+        index /= 2;
+        n = (n + 1) / 2;
+    }
+    return 0;
+}
+
+int merkle_proof_root (const void *data, size_t len, int index, int count,
+                       const unsigned char *proof, unsigned char *root)
+{
+    unsigned char digest[MERKLE_DIGEST_SIZE];
+
+    if ((len > 0 && !data) || !root || count <= 0
+        || index < 0 || index >= count
+        || (count > 1 && !proof)) {
+        errno = EINVAL;
+        return -1;
+    }
+    hash_leaf (data, len, digest);
+    while (count > 1) {
+        if ((index ^ 1) < count) {
+            if (index % 2 == 0)
+                hash_node (digest, proof, digest);
+            else
+                hash_node (proof, digest, digest);
+            proof += MERKLE_DIGEST_SIZE;
+        }
+        index /= 2;
+        count = (count + 1) / 2;
+    }
+    memcpy (root, digest, MERKLE_DIGEST_SIZE);
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,71 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_MERKLE_H
+#define _UTIL_MERKLE_H
+
+/* Binary SHA256 Merkle tree over 'count' leaves.
+ *
+ * Leaf digest is H(0x00 || data), interior node digest is H(0x01 || L || R),
+ * so that a leaf can never be confused with an interior node.  When a level
+ * has an odd number of nodes, the last one is promoted to the next level
+ * unchanged.  Thus the number of digests in an inclusion proof depends only
+ * on the leaf index and the leaf count.
+ */
+
+#include <stddef.h>
+
+#include "sha256.h"
+
+#define MERKLE_DIGEST_SIZE SHA256_BLOCK_SIZE
+
+/* Create/destroy a tree with 'count' leaves (count > 0).
+ */
+struct merkle *merkle_create (int count);
+void merkle_destroy (struct merkle *m);
+
+/* Set leaf 'index' to the digest of 'data' of length 'len'.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+int merkle_set_leaf (struct merkle *m, int index, const void *data, size_t len);
+
+/* Compute interior nodes and root once all leaves are set.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+int merkle_build (struct merkle *m);
+
+/* Copy root digest to 'root' (MERKLE_DIGEST_SIZE bytes).
+ * Return 0 on success, -1 on failure with errno set.
+ */
+int merkle_root (struct merkle *m, unsigned char *root);
+
+/* Return the number of digests in the inclusion proof for leaf 'index'
+ * of a tree with 'count' leaves, or -1 on invalid arguments.
+ */
+int merkle_proof_len (int index, int count);
+
+/* Copy inclusion proof for leaf 'index' to 'proof', which must have room
+ * for merkle_proof_len() * MERKLE_DIGEST_SIZE bytes.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+int merkle_proof (struct merkle *m, int index, unsigned char *proof);
+
+/* Compute the root of a 'count' leaf tree from 'data' of length 'len'
+ * at leaf 'index' and its inclusion proof, storing result in 'root'.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+int merkle_proof_root (const void *data, size_t len, int index, int count,
+                       const unsigned char *proof, unsigned char *root);
+
+#endif /* !_UTIL_MERKLE_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,133 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "src/libtap/tap.h"
+#include "src/libutil/arena.h"
+
+void test_basic (void)
+{
+    struct arena *arena;
+    char *p, *q, *r;
+    int *z;
+    int i;
+    int count;
+
+    ok ((arena = arena_create ()) != NULL,
+        "arena_create works");
+    ok ((p = arena_malloc (arena, 5)) != NULL,
+        "arena_malloc works");
+    ok (((uintptr_t)p % 16) == 0,
+        "allocation is 16 byte aligned");
+    strcpy (p, "abcd");
+    ok ((q = arena_realloc (arena, p, 100)) == p,
+        "arena_realloc of last allocation grows in place");
+    ok (strcmp (q, "abcd") == 0,
+        "contents preserved");
+    ok ((r = arena_malloc (arena, 10)) != NULL && r != q,
+        "arena_malloc works again");
+    ok ((q = arena_realloc (arena, p, 200)) != p && strcmp (q, "abcd") == 0,
+        "arena_realloc of earlier allocation moves it and preserves contents");
+    ok (arena_from_ptr (r) == arena,
+        "arena_from_ptr returns owning arena");
+
+    ok ((z = arena_calloc (arena, 100, sizeof (int))) != NULL,
+        "arena_calloc works");
+    count = 0;
+    for (i = 0; i < 100; i++)
+        if (z[i] == 0)
+            count++;
+    ok (count == 100,
+        "arena_calloc zeroed memory");
+    arena_free (arena, z);
+    ok (arena_malloc (arena, 8) == (void *)z,
+        "arena_free of last allocation reclaims it");
+
+    /* Grow one allocation a little at a time well past the block size,
+     * as tomlc99 does when reading a file.
+     */
+    p = arena_malloc (arena, 1000);
+    memset (p, 'x', 1000);
+    for (i = 2; i <= 100; i++) {
+        if (!(q = arena_realloc (arena, p, i * 1000)))
+            break;
+        memset (q + (i - 1) * 1000, 'x', 1000);
+        p = q;
+    }
+    count = 0;
+    for (i = 0; i < 100 * 1000; i++)
+        if (p[i] == 'x')
+            count++;
+    ok (count == 100 * 1000,
+        "arena_realloc can grow allocation to many blocks in size");
+
+    /* Many small allocations span blocks, and all map to the arena.
+     */
+    count = 0;
+    for (i = 0; i < 10000; i++) {
+        if ((p = arena_malloc (arena, 24)) && arena_from_ptr (p) == arena)
+            count++;
+    }
+    ok (count == 10000,
+        "arena_from_ptr works for small allocations across many blocks");
+
+    arena_destroy (arena);
+}
+
+void test_inval (void)
+{
+    struct arena *arena;
+
+    if (!(arena = arena_create ()))
+        BAIL_OUT ("arena_create failed");
+    errno = 0;
+    ok (arena_malloc (NULL, 1) == NULL && errno == EINVAL,
+        "arena_malloc arena=NULL fails with EINVAL");
+    errno = 0;
+    ok (arena_calloc (NULL, 1, 1) == NULL && errno == EINVAL,
+        "arena_calloc arena=NULL fails with EINVAL");
+    errno = 0;
+    ok (arena_realloc (NULL, NULL, 1) == NULL && errno == EINVAL,
+        "arena_realloc arena=NULL fails with EINVAL");
+    errno = 0;
+    ok (arena_calloc (arena, SIZE_MAX / 2, 4) == NULL && errno == ENOMEM,
+        "arena_calloc fails with ENOMEM on overflow");
+    errno = 0;
+    ok (arena_malloc (arena, SIZE_MAX - 8) == NULL && errno == ENOMEM,
+        "arena_malloc fails with ENOMEM on huge size");
+    ok (arena_from_ptr (NULL) == NULL,
+        "arena_from_ptr ptr=NULL returns NULL");
+    lives_ok ({arena_free (arena, NULL);},
+        "arena_free ptr=NULL doesn't crash");
+    lives_ok ({arena_destroy (NULL);},
+        "arena_destroy arena=NULL doesn't crash");
+    arena_destroy (arena);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    test_basic ();
+    test_inval ();
+
+    done_testing ();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -608,6 +608,124 @@ void test_update_glob (void)
 
 }
 
+static ino_t cache_ino (const char *path)
+{
+    struct stat sb;
+    if (stat (path, &sb) < 0)
+        return 0;
+    return sb.st_ino;
+}
+
+static int update_cached (const char *pattern, const char *cachepath,
+                          const char *key, const char *init, int flags)
+{
+    cf_t *cf;
+    struct cf_error error;
+    int rc;
+
+    if (!(cf = cf_create ()))
+        BAIL_OUT ("cf_create: %s", strerror (errno));
+    if (init && cf_update_pack (cf, &error, "{s:b}", init, 1) < 0)
+        BAIL_OUT ("cf_update_pack: %s", error.errbuf);
+    rc = cf_update_glob_cached (cf, pattern, cachepath, flags, &error);
+    if (rc >= 0 && (!cf_get_in (cf, "tab")
+                    || !cf_get_in (cf, key)
+                    || (init && !cf_get_in (cf, init))))
+        rc = -1;
+    cf_destroy (cf);
+    return rc;
+}
+
+void test_update_glob_cached (void)
+{
+    const char *tmpdir = getenv ("TMPDIR");
+    char dir[PATH_MAX + 1];
+    char path1[PATH_MAX + 1];
+    char path2[PATH_MAX + 1];
+    char cache[PATH_MAX + 1];
+    char p [8192];
+    ino_t ino;
+    FILE *f;
+
+    snprintf (dir, sizeof (dir), "%s/cf.XXXXXXX", tmpdir ? tmpdir : "/tmp");
+    if (!mkdtemp (dir))
+        BAIL_OUT ("mkdtemp %s: %s", dir, strerror (errno));
+    create_test_file (dir, "01", path1, sizeof (path1), t1);
+    create_test_file (dir, "02", path2, sizeof (path2), tab2);
+    snprintf (p, sizeof (p), "%s/*.toml", dir);
+
+    ok (cf_cache_path (p, cache, sizeof (cache)) == 0,
+        "cf_cache_path works");
+    diag ("%s", cache);
+    errno = 0;
+    ok (cf_cache_path ("/a/*/b.toml", cache + 1, sizeof (cache) - 1) < 0
+        && errno == EINVAL,
+        "cf_cache_path fails with EINVAL on wildcard in directory");
+    errno = 0;
+    ok (cf_cache_path ("*.toml", cache + 1, sizeof (cache) - 1) < 0
+        && errno == EINVAL,
+        "cf_cache_path fails with EINVAL on pattern without directory");
+
+    ok (update_cached (p, cache, "tab2", NULL, CF_CACHE_UPDATE) == 2,
+        "cf_update_glob_cached parsed 2 files");
+    ok ((ino = cache_ino (cache)) != 0,
+        "cf_update_glob_cached compiled cache");
+    ok (update_cached (p, cache, "tab2", NULL, CF_CACHE_UPDATE) == 2
+        && cache_ino (cache) == ino,
+        "cf_update_glob_cached loaded valid cache without replacing it");
+
+    ok (update_cached (p, cache, "tab2", "extra", CF_CACHE_UPDATE) == 2
+        && cache_ino (cache) != ino,
+        "cf_update_glob_cached recompiled cache for different initial cf");
+    ok (update_cached (p, cache, "tab2", NULL, CF_CACHE_UPDATE) == 2,
+        "cf_update_glob_cached works after switching back");
+
+    if (unlink (path2) < 0)
+        BAIL_OUT ("unlink: %s", strerror (errno));
+    create_test_file (dir, "02", path2, sizeof (path2), tab3);
+    ino = cache_ino (cache);
+    ok (update_cached (p, cache, "tab3", NULL, CF_CACHE_UPDATE) == 2
+        && cache_ino (cache) != ino,
+        "cf_update_glob_cached recompiled cache after file change");
+
+    if (!(f = fopen (cache, "w")) || fputs ("FLXCFC01", f) < 0 || fclose (f))
+        BAIL_OUT ("failed to truncate cache");
+    ok (update_cached (p, cache, "tab3", NULL, CF_CACHE_UPDATE) == 2,
+        "cf_update_glob_cached ignores truncated cache");
+
+    if (chmod (cache, 0666) < 0)
+        BAIL_OUT ("chmod: %s", strerror (errno));
+    ino = cache_ino (cache);
+    ok (update_cached (p, cache, "tab3", NULL, CF_CACHE_UPDATE) == 2
+        && cache_ino (cache) != ino,
+        "cf_update_glob_cached replaced world writable cache");
+
+    ok (update_cached (p, NULL, "tab3", NULL, CF_CACHE_UPDATE) == 2,
+        "cf_update_glob_cached cachepath=NULL works");
+
+    if (unlink (cache) < 0)
+        BAIL_OUT ("unlink: %s", strerror (errno));
+    ok (update_cached (p, cache, "tab3", NULL, 0) == 2
+        && cache_ino (cache) == 0,
+        "cf_update_glob_cached does not compile cache without CF_CACHE_UPDATE");
+    ok (update_cached (p, cache, "tab3", NULL, CF_CACHE_UPDATE) == 2
+        && (ino = cache_ino (cache)) != 0,
+        "cf_update_glob_cached CF_CACHE_UPDATE compiled cache");
+    ok (update_cached (p, cache, "tab3", NULL, 0) == 2
+        && cache_ino (cache) == ino,
+        "cf_update_glob_cached loads cache without CF_CACHE_UPDATE");
+    errno = 0;
+    ok (update_cached (p, cache, "tab3", NULL, 0x100) < 0 && errno == EINVAL,
+        "cf_update_glob_cached fails with EINVAL on invalid flags");
+
+    if (   (unlink (path1) < 0)
+        || (unlink (path2) < 0)
+        || (unlink (cache) < 0))
+        BAIL_OUT ("unlink: %s", strerror (errno));
+    if (rmdir (dir) < 0)
+        BAIL_OUT ("rmdir: %s: %s", dir, strerror (errno));
+}
+
 void test_update_pack (void)
 {
     cf_t *cf;
@@ -779,6 +897,131 @@ void test_array_contains_match (void)
     cf_destroy (tab);
 }
 
+static int count_key (const char *key, const cf_t *val, void *arg)
+{
+    int *count = arg;
+
+    if (strcmp (key, "stop") == 0)
+        return -1;
+    if (cf_typeof (val) == CF_INT64)
+        (*count)++;
+    return 0;
+}
+
+void test_table_foreach (void)
+{
+    cf_t *tab;
+    int count;
+
+    if (!(tab = cf_create ()))
+        BAIL_OUT ("cf_create");
+    if (cf_update_pack (tab,
+                        NULL,
+                        "{s:i s:i s:s s:{s:i}}",
+                        "a", 1, "b", 2, "c", "foo",
+                        "t", "stop", 3) < 0)
+        BAIL_OUT ("cf_update_pack");
+
+    count = 0;
+    ok (cf_table_foreach (tab, count_key, &count) == 0 && count == 2,
+        "cf_table_foreach calls fn for each key in table");
+    count = 0;
+    ok (cf_table_foreach (NULL, count_key, &count) == 0 && count == 0,
+        "cf_table_foreach (NULL) does nothing");
+    count = 0;
+    ok (cf_table_foreach (cf_get_in (tab, "c"), count_key, &count) == 0
+        && count == 0,
+        "cf_table_foreach on non-table does nothing");
+    ok (cf_table_foreach (cf_get_in (tab, "t"), count_key, &count) < 0,
+        "cf_table_foreach fails when fn fails");
+
+    cf_destroy (tab);
+}
+
+void test_set (void)
+{
+    cf_t *tab;
+    struct cf_set *set;
+
+    /*  TOML arrays must be homogeneous, so use cf_update_pack() to
+     *   include a non-string entry.
+     */
+    if (!(tab = cf_create ()))
+        BAIL_OUT ("cf_create");
+    if (cf_update_pack (tab,
+                        NULL,
+                        "{s:[s,s,s,i,s,s] s:s}",
+                        "array", "foo", "bar*", "baz?", 42, "foo", "[xy]z",
+                        "notarray", "foo") < 0)
+        BAIL_OUT ("cf_update_pack");
+
+    errno = 0;
+    ok (cf_set_create (cf_get_in (tab, "notarray"), 0) == NULL
+        && errno == EINVAL,
+        "cf_set_create on non-array fails with EINVAL");
+    errno = 0;
+    ok (cf_set_create (cf_get_in (tab, "array"), 0x100) == NULL
+        && errno == EINVAL,
+        "cf_set_create with unknown flags fails with EINVAL");
+    ok (cf_set_contains (NULL, "foo") == false,
+        "cf_set_contains (NULL, \"foo\") returns false");
+
+    set = cf_set_create (NULL, 0);
+    ok (set != NULL,
+        "cf_set_create (NULL) returns empty set");
+    ok (cf_set_contains (set, "foo") == false,
+        "empty set does not contain \"foo\"");
+    cf_set_destroy (set);
+
+    /* Without CF_SET_MATCH, entries are literal as for cf_array_contains()
+     */
+    set = cf_set_create (cf_get_in (tab, "array"), 0);
+    ok (set != NULL,
+        "cf_set_create works");
+    ok (cf_set_contains (set, NULL) == false,
+        "cf_set_contains (set, NULL) returns false");
+    ok (cf_set_contains (set, "foo"),
+        "set contains \"foo\"");
+    ok (cf_set_contains (set, "bar*"),
+        "set contains \"bar*\"");
+    ok (cf_set_contains (set, "bar") == false,
+        "set does not contain \"bar\"");
+    ok (cf_set_contains (set, "barbaric") == false,
+        "set does not contain \"barbaric\"");
+    ok (cf_set_contains (set, "fo") == false,
+        "set does not contain \"fo\"");
+    cf_set_destroy (set);
+
+    /* With CF_SET_MATCH, results match cf_array_contains_match()
+     */
+    set = cf_set_create (cf_get_in (tab, "array"), CF_SET_MATCH);
+    ok (set != NULL,
+        "cf_set_create CF_SET_MATCH works");
+    ok (cf_set_contains (set, "foo"),
+        "set matches \"foo\"");
+    ok (cf_set_contains (set, "bar"),
+        "set matches \"bar\"");
+    ok (cf_set_contains (set, "barbaric"),
+        "set matches \"barbaric\"");
+    ok (cf_set_contains (set, "baz1"),
+        "set matches \"baz1\"");
+    ok (cf_set_contains (set, "xz") && cf_set_contains (set, "yz"),
+        "set matches \"xz\" and \"yz\"");
+    ok (cf_set_contains (set, "foobar") == false,
+        "set does not match \"foobar\"");
+    ok (cf_set_contains (set, "baz") == false,
+        "set does not match \"baz\"");
+    ok (cf_set_contains (set, "bazaar") == false,
+        "set does not match \"bazaar\"");
+    ok (cf_set_contains (set, "zz") == false,
+        "set does not match \"zz\"");
+    ok (cf_set_contains (set, "") == false,
+        "set does not match \"\"");
+    cf_set_destroy (set);
+
+    cf_destroy (tab);
+}
+
 int main (int argc, char *argv[])
 {
     plan (NO_PLAN);
@@ -788,11 +1031,14 @@ int main (int argc, char *argv[])
     test_corner ();
     test_update_file ();
     test_update_glob ();
+    test_update_glob_cached ();
     test_update_pack ();
     test_path_paranoia ();
     test_check ();
     test_array_contains ();
     test_array_contains_match ();
+    test_table_foreach ();
+    test_set ();
 
     done_testing ();
 }
@@ -474,6 +474,360 @@ void join_split (void)
     kv_destroy (kv);
 }
 
+static bool filter_not_b (const char *key, void *arg)
+{
+    int *count = arg;
+    (*count)++;
+    return strcmp (key, "b") != 0;
+}
+
+void split_filter (void)
+{
+    struct kv *kv;
+    struct kv *kv1;
+    struct kv *kv2;
+    struct kv *kv_cpy;
+    int count = 0;
+
+    if (!(kv = kv_create()))
+        BAIL_OUT ("kv_create failed");
+    kv1 = create_test_kv ();
+    if (kv_join (kv, kv1, "foo.") < 0
+        || kv_join (kv, kv1, "bar.") < 0)
+        BAIL_OUT ("kv_join failed");
+
+    /* kv2 = kv1 without "b"
+     */
+    kv2 = create_test_kv ();
+    if (kv_delete (kv2, "b") < 0)
+        BAIL_OUT ("kv_delete failed");
+
+    ok ((kv_cpy = kv_split_filter (kv, "foo.", NULL, NULL)) != NULL
+        && kv_equal (kv_cpy, kv1),
+        "kv_split_filter with NULL filter works like kv_split");
+    kv_destroy (kv_cpy);
+
+    ok ((kv_cpy = kv_split_filter (kv, "bar.", filter_not_b, &count)) != NULL
+        && kv_equal (kv_cpy, kv2),
+        "kv_split_filter removes filtered entries");
+    ok (count == 4,
+        "filter was called once per entry with matching prefix");
+    ok (kv_put (kv_cpy, "e", KV_STRING, "bar") == 0
+        && kv_put (kv_cpy, "a", KV_STRING, "baz") == 0,
+        "kv_put works on kv_split_filter result");
+    kv_destroy (kv_cpy);
+
+    ok ((kv_cpy = kv_split_filter (kv, "baz.", NULL, NULL)) != NULL
+        && kv_next (kv_cpy, NULL) == NULL,
+        "kv_split_filter with unmatched prefix returns empty kv");
+    kv_destroy (kv_cpy);
+
+    kv_destroy (kv1);
+    kv_destroy (kv2);
+    kv_destroy (kv);
+}
+
+/* Exercise the side index used for objects with many keys.
+ */
+void large_object (void)
+{
+    struct kv *kv;
+    struct kv *kv2;
+    const char *entry;
+    char key[32];
+    int64_t val;
+    int n = 1000;
+    int i;
+    int errors;
+
+    if (!(kv = kv_create ()))
+        BAIL_OUT ("kv_create failed");
+    errors = 0;
+    for (i = 0; i < n; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_put (kv, key, KV_INT64, (int64_t)i) < 0)
+            errors++;
+    }
+    ok (errors == 0,
+        "kv_put %d keys works", n);
+    errors = 0;
+    for (i = 0; i < n; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_get (kv, key, KV_INT64, &val) < 0 || val != i)
+            errors++;
+    }
+    ok (errors == 0,
+        "kv_get of all %d keys works", n);
+    errno = 0;
+    ok (kv_get (kv, "key1000", KV_INT64, &val) < 0 && errno == ENOENT,
+        "kv_get of missing key fails with ENOENT");
+    errno = 0;
+    ok (kv_get (kv, "key1", KV_STRING, &entry) < 0 && errno == ENOENT,
+        "kv_get with wrong type fails with ENOENT");
+
+    /* Delete even keys, in reverse so offsets of indexed entries shift
+     */
+    errors = 0;
+    for (i = n - 2; i >= 0; i -= 2) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_delete (kv, key) < 0)
+            errors++;
+    }
+    ok (errors == 0,
+        "kv_delete of even keys works");
+    errors = 0;
+    for (i = 0; i < n; i++) {
+        int rc;
+        snprintf (key, sizeof (key), "key%d", i);
+        rc = kv_get (kv, key, KV_INT64, &val);
+        if (i % 2 == 0 ? rc == 0 : rc < 0 || val != i)
+            errors++;
+    }
+    ok (errors == 0,
+        "only odd keys remain after deletion");
+
+    /* Update odd keys: each is moved to the end of the buffer
+     */
+    errors = 0;
+    for (i = 1; i < n; i += 2) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_put (kv, key, KV_INT64, (int64_t)i * 2) < 0)
+            errors++;
+    }
+    ok (errors == 0,
+        "kv_put update of odd keys works");
+    errors = 0;
+    for (i = 1; i < n; i += 2) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_get (kv, key, KV_INT64, &val) < 0 || val != i * 2)
+            errors++;
+    }
+    ok (errors == 0,
+        "kv_get returns updated values");
+
+    /* Encoding is unaffected by the index
+     */
+    if (!(kv2 = kv_create ()))
+        BAIL_OUT ("kv_create failed");
+    for (i = 1; i < n; i += 2) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_put (kv2, key, KV_INT64, (int64_t)i * 2) < 0)
+            BAIL_OUT ("kv_put failed");
+    }
+    ok (kv_equal (kv, kv2),
+        "kv is identical to one built without deletions");
+    kv_destroy (kv2);
+
+    entry = NULL;
+    i = 1;
+    errors = 0;
+    while ((entry = kv_next (kv, entry))) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (strcmp (entry, key) != 0)
+            errors++;
+        i += 2;
+    }
+    ok (errors == 0 && i == n + 1,
+        "kv_next iterates entries in insertion order");
+
+    kv_destroy (kv);
+}
+
+void views (void)
+{
+    struct kv *kv;
+    struct kv *kv1;
+    struct kv *view;
+    struct kv *pview;
+    struct kv *pview2;
+    struct kv *cpy;
+    const char *buf;
+    const char *key;
+    const char *s;
+    int len;
+    int64_t i;
+    int count;
+
+    if (!(kv = kv_create ()))
+        BAIL_OUT ("kv_create failed");
+    kv1 = create_test_kv ();
+    if (kv_join (kv, kv1, "foo.") < 0
+        || kv_join (kv, kv1, "foo.bar.") < 0
+        || kv_put (kv, "baz", KV_STRING, "x") < 0
+        || kv_put (kv, "foo.", KV_STRING, "empty") < 0)
+        BAIL_OUT ("kv_join failed");
+    if (kv_encode (kv, &buf, &len) < 0)
+        BAIL_OUT ("kv_encode failed");
+
+    errno = 0;
+    ok (kv_view (buf, len - 1) == NULL && errno == EINVAL,
+        "kv_view fails with EINVAL on truncated buffer");
+    errno = 0;
+    ok (kv_view (NULL, 1) == NULL && errno == EINVAL,
+        "kv_view fails with EINVAL on NULL buffer");
+    errno = 0;
+    ok (kv_view_prefix (NULL, "foo.") == NULL && errno == EINVAL,
+        "kv_view_prefix fails with EINVAL on NULL kv");
+
+    view = kv_view (buf, len);
+    ok (view != NULL,
+        "kv_view works");
+    ok (kv_next (view, NULL) == buf,
+        "kv_view does not copy buffer");
+    ok (kv_equal (view, kv),
+        "kv_view is equal to original");
+    ok (kv_get (view, "baz", KV_STRING, &s) == 0 && !strcmp (s, "x"),
+        "kv_get works on view");
+    errno = 0;
+    ok (kv_put (view, "baz", KV_STRING, "y") < 0 && errno == EROFS,
+        "kv_put on view fails with EROFS");
+    errno = 0;
+    ok (kv_delete (view, "baz") < 0 && errno == EROFS,
+        "kv_delete on view fails with EROFS");
+    errno = 0;
+    ok (kv_join (view, kv1, NULL) < 0 && errno == EROFS,
+        "kv_join to view fails with EROFS");
+    ok ((cpy = kv_copy (view)) != NULL
+        && kv_put (cpy, "baz", KV_STRING, "y") == 0,
+        "kv_copy of view is writable");
+    kv_destroy (cpy);
+
+    pview = kv_view_prefix (view, "foo.");
+    ok (pview != NULL,
+        "kv_view_prefix works");
+    ok (kv_get (pview, "b", KV_INT64, &i) == 0 && i == 42,
+        "kv_get works on prefix view");
+    ok (kv_get (pview, "bar.a", KV_STRING, &s) == 0 && !strcmp (s, "foo"),
+        "kv_get of nested key works on prefix view");
+    errno = 0;
+    ok (kv_get (pview, "baz", KV_STRING, &s) < 0 && errno == ENOENT,
+        "kv_get of key outside prefix fails with ENOENT");
+    count = 0;
+    key = NULL;
+    while ((key = kv_next (pview, key)))
+        count++;
+    ok (count == 8,
+        "kv_next iterates over entries with prefix only");
+    errno = 0;
+    ok (kv_encode (pview, &buf, &len) < 0 && errno == EINVAL,
+        "kv_encode fails with EINVAL on prefix view");
+    ok ((cpy = kv_split (view, "foo.")) != NULL && kv_equal (pview, cpy),
+        "prefix view is equal to kv_split result");
+    kv_destroy (cpy);
+    ok ((cpy = kv_copy (pview)) != NULL && kv_equal (pview, cpy)
+        && kv_encode (cpy, &buf, &len) == 0,
+        "kv_copy of prefix view works and can be encoded");
+    kv_destroy (cpy);
+
+    pview2 = kv_view_prefix (pview, "bar.");
+    ok (pview2 != NULL && kv_equal (pview2, kv1),
+        "prefix view of prefix view works");
+    ok (kv_equal (pview, kv1) == false,
+        "kv_equal detects difference in prefix view");
+    kv_destroy (pview2);
+    kv_destroy (pview);
+
+    pview = kv_view_prefix (kv, "nomatch.");
+    ok (pview != NULL && kv_next (pview, NULL) == NULL,
+        "prefix view with no matching entries is empty");
+    kv_destroy (pview);
+
+    kv_destroy (view);
+    kv_destroy (kv1);
+    kv_destroy (kv);
+}
+
+void builder (void)
+{
+    struct kv *kv;
+    struct kv *kv1;
+    struct kv *kv2;
+    struct kv *view;
+    const char *buf;
+    int len;
+    int64_t i;
+    int errors;
+
+    if (!(kv = kv_create ()))
+        BAIL_OUT ("kv_create failed");
+    errno = 0;
+    ok (kv_reserve (NULL, 10) < 0 && errno == EINVAL,
+        "kv_reserve kv=NULL fails with EINVAL");
+    errno = 0;
+    ok (kv_reserve (kv, -1) < 0 && errno == EINVAL,
+        "kv_reserve size=-1 fails with EINVAL");
+    errno = 0;
+    ok (kv_append (NULL, "a", KV_STRING, "b") < 0 && errno == EINVAL,
+        "kv_append kv=NULL fails with EINVAL");
+    errno = 0;
+    ok (kv_append (kv, "", KV_STRING, "b") < 0 && errno == EINVAL,
+        "kv_append key=\"\" fails with EINVAL");
+    errno = 0;
+    ok (kv_append (kv, "a", KV_STRING, NULL) < 0 && errno == EINVAL,
+        "kv_append val=NULL fails with EINVAL");
+    ok (kv_reserve (kv, 1024 * 1024) == 0,
+        "kv_reserve 1M works");
+    ok (kv_append (kv, "a", KV_STRING, "foo") == 0
+        && kv_append (kv, "b", KV_INT64, 42LL) == 0
+        && kv_append (kv, "c", KV_DOUBLE, 3.14) == 0
+        && kv_append (kv, "d", KV_BOOL, true) == 0,
+        "kv_append works");
+    kv1 = create_test_kv ();
+    ok (kv_equal (kv, kv1),
+        "kv_append result is the same as with kv_put");
+    ok (kv_put (kv, "b", KV_INT64, 43LL) == 0
+        && kv_get (kv, "b", KV_INT64, &i) == 0 && i == 43,
+        "kv_put works after kv_append");
+    kv_destroy (kv);
+
+    if (kv_encode (kv1, &buf, &len) < 0 || !(view = kv_view (buf, len)))
+        BAIL_OUT ("failed to create view");
+    errno = 0;
+    ok (kv_reserve (view, 10) < 0 && errno == EROFS,
+        "kv_reserve on view fails with EROFS");
+    errno = 0;
+    ok (kv_append (view, "e", KV_STRING, "x") < 0 && errno == EROFS,
+        "kv_append on view fails with EROFS");
+    kv_destroy (view);
+
+    /* kv_join with fresh and existing prefixes gives same result as
+     * repeated kv_put
+     */
+    if (!(kv = kv_create ()) || !(kv2 = kv_create ()))
+        BAIL_OUT ("kv_create failed");
+    errors = 0;
+    if (kv_put (kv2, "x", KV_STRING, "y") < 0)
+        errors++;
+    for (i = 0; i < 200; i++) {
+        char key[32];
+        snprintf (key, sizeof (key), "p.key%d", (int)i);
+        if (kv_put (kv2, key, KV_INT64, i) < 0)
+            errors++;
+    }
+    for (i = 0; i < 200; i++) {
+        char key[32];
+        snprintf (key, sizeof (key), "p.key%d", (int)i);
+        if (kv_put (kv2, key, KV_INT64, i + 1) < 0)
+            errors++;
+    }
+    if (errors > 0)
+        BAIL_OUT ("kv_put failed");
+    if (!(view = kv_view_prefix (kv2, "p.")))
+        BAIL_OUT ("kv_view_prefix failed");
+    ok (kv_put (kv, "x", KV_STRING, "y") == 0
+        && kv_join (kv, view, "p.") == 0,
+        "kv_join with fresh prefix works");
+    ok (kv_join (kv, view, "p.") == 0,
+        "kv_join with existing prefix works");
+    ok (kv_equal (kv, kv2),
+        "kv_join results match kv_put");
+    kv_destroy (view);
+
+    kv_destroy (kv1);
+    kv_destroy (kv2);
+    kv_destroy (kv);
+}
+
 static void test_expand (void)
 {
     char **env;
@@ -622,6 +976,10 @@ int main (int argc, char *argv[])
     key_deletion ();
     key_update ();
     join_split ();
+    split_filter ();
+    large_object ();
+    views ();
+    builder ();
     test_expand ();
     test_argv ();
 
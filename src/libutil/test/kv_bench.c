@@ -0,0 +1,266 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* kv_bench - time kv operations on large objects
+ *
+ * Usage: kv_bench [-n entries] [-i iterations]
+ *
+ * put/get/delete: build a kv with 'entries' keys using kv_put(), look
+ *   up every key with kv_get(), then remove every key with kv_delete().
+ *
+ * argv/join: encode an argv of 'entries' 256 byte arguments with
+ *   kv_encode_argv(), then kv_join() it into an empty kv under a prefix.
+ *
+ * filter: split an environment of 'entries' variables with an
+ *   IMP_RUN_ENV_ prefix out of a kv and keep those allowed by a typical
+ *   allowed-environment list, as 'flux-imp run' does.  Compare deleting
+ *   disallowed entries from a kv_split() copy with cf_array_contains_match()
+ *   against kv_split_filter() with a compiled cf_set.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "src/libutil/kv.h"
+#include "src/libutil/cf.h"
+
+static const char *allowed_env =
+    "allowed-environment = [ \"FLUX_*\", \"SLURM_*\", \"OMPI_*\","
+    " \"PMI_*\", \"TEST_*\", \"EXACT_MATCH\", \"LANG\", \"TZ\" ]";
+
+static const char *env_prefixes[] = {
+    "FLUX_", "OMPI_", "MY_", "PMI_", "XDG_", "TEST_",
+};
+
+static double now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+static void die (const char *msg)
+{
+    fprintf (stderr, "kv_bench: %s\n", msg);
+    exit (1);
+}
+
+static struct kv *create_env (int entries)
+{
+    struct kv *kv;
+    char key[64];
+    int n = sizeof (env_prefixes) / sizeof (env_prefixes[0]);
+    int i;
+
+    if (!(kv = kv_create ()))
+        die ("kv_create failed");
+    for (i = 0; i < entries; i++) {
+        snprintf (key, sizeof (key), "IMP_RUN_ENV_%sVAR%d",
+                  env_prefixes[i % n], i);
+        if (kv_put (kv, key, KV_STRING, "some-value") < 0)
+            die ("kv_put failed");
+    }
+    return kv;
+}
+
+static void bench_put_get (int entries)
+{
+    struct kv *kv;
+    char key[64];
+    const char *val;
+    double t;
+    double t_put;
+    double t_get;
+    double t_delete;
+    int i;
+
+    if (!(kv = kv_create ()))
+        die ("kv_create failed");
+    t = now ();
+    for (i = 0; i < entries; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_put (kv, key, KV_STRING, "some-value") < 0)
+            die ("kv_put failed");
+    }
+    t_put = now () - t;
+    t = now ();
+    for (i = 0; i < entries; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_get (kv, key, KV_STRING, &val) < 0)
+            die ("kv_get failed");
+    }
+    t_get = now () - t;
+    t = now ();
+    for (i = 0; i < entries; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (kv_delete (kv, key) < 0)
+            die ("kv_delete failed");
+    }
+    t_delete = now () - t;
+    printf ("put/get/delete: %d entries: put %.2fms get %.2fms"
+            " delete %.2fms\n",
+            entries,
+            t_put * 1E3,
+            t_get * 1E3,
+            t_delete * 1E3);
+    kv_destroy (kv);
+}
+
+static void bench_argv (int entries)
+{
+    const char **argv;
+    char arg[257];
+    struct kv *kv;
+    struct kv *kv2;
+    const char *buf;
+    int len;
+    double t;
+    double t_argv;
+    double t_join;
+    int i;
+
+    memset (arg, 'x', sizeof (arg) - 1);
+    arg[sizeof (arg) - 1] = '\0';
+    if (!(argv = calloc (entries + 1, sizeof (argv[0]))))
+        die ("out of memory");
+    for (i = 0; i < entries; i++)
+        argv[i] = arg;
+
+    t = now ();
+    if (!(kv = kv_encode_argv (argv)))
+        die ("kv_encode_argv failed");
+    t_argv = now () - t;
+
+    t = now ();
+    if (!(kv2 = kv_create ()) || kv_join (kv2, kv, "args.") < 0)
+        die ("kv_join failed");
+    t_join = now () - t;
+
+    if (kv_encode (kv2, &buf, &len) < 0)
+        die ("kv_encode failed");
+    printf ("argv/join: %d entries, %d bytes: argv %.2fms join %.2fms\n",
+            entries,
+            len,
+            t_argv * 1E3,
+            t_join * 1E3);
+    kv_destroy (kv2);
+    kv_destroy (kv);
+    free (argv);
+}
+
+static struct kv *filter_delete (struct kv *kv, const cf_t *allowed)
+{
+    struct kv *kv_env;
+    const char *var = NULL;
+
+    if (!(kv_env = kv_split (kv, "IMP_RUN_ENV_")))
+        die ("kv_split failed");
+    while ((var = kv_next (kv_env, var))) {
+        if (!cf_array_contains_match (allowed, var))
+            kv_delete (kv_env, var);
+    }
+    return kv_env;
+}
+
+static bool set_contains (const char *key, void *arg)
+{
+    return cf_set_contains (arg, key);
+}
+
+static struct kv *filter_compiled (struct kv *kv, const cf_t *allowed)
+{
+    struct cf_set *set;
+    struct kv *kv_env;
+
+    if (!(set = cf_set_create (allowed, CF_SET_MATCH)))
+        die ("cf_set_create failed");
+    if (!(kv_env = kv_split_filter (kv, "IMP_RUN_ENV_", set_contains, set)))
+        die ("kv_split_filter failed");
+    cf_set_destroy (set);
+    return kv_env;
+}
+
+static double bench_filter (struct kv *kv,
+                            const cf_t *allowed,
+                            int iterations,
+                            struct kv *(*fn)(struct kv *, const cf_t *))
+{
+    double t = now ();
+    int i;
+
+    for (i = 0; i < iterations; i++)
+        kv_destroy (fn (kv, allowed));
+    return (now () - t) / iterations;
+}
+
+int main (int argc, char *argv[])
+{
+    int entries = 10000;
+    int iterations = 10;
+    cf_t *cf;
+    struct kv *kv;
+    double t_delete;
+    double t_compiled;
+    int ch;
+
+    while ((ch = getopt (argc, argv, "n:i:")) != -1) {
+        switch (ch) {
+            case 'n':
+                entries = strtol (optarg, NULL, 10);
+                break;
+            case 'i':
+                iterations = strtol (optarg, NULL, 10);
+                break;
+            default:
+                goto usage;
+        }
+    }
+    if (optind != argc || entries <= 0 || iterations <= 0)
+        goto usage;
+
+    bench_put_get (entries);
+    bench_argv (entries);
+
+    if (!(cf = cf_create ())
+        || cf_update (cf, allowed_env, strlen (allowed_env), NULL) < 0)
+        die ("failed to create allowed-environment");
+    kv = create_env (entries);
+
+    t_delete = bench_filter (kv,
+                             cf_get_in (cf, "allowed-environment"),
+                             iterations,
+                             filter_delete);
+    t_compiled = bench_filter (kv,
+                               cf_get_in (cf, "allowed-environment"),
+                               iterations,
+                               filter_compiled);
+    printf ("filter: %d entries: delete %.2fms compiled %.2fms (%.2fx)\n",
+            entries,
+            t_delete * 1E3,
+            t_compiled * 1E3,
+            t_compiled > 0 ? t_delete / t_compiled : 0.);
+
+    kv_destroy (kv);
+    cf_destroy (cf);
+    return 0;
+usage:
+    fprintf (stderr, "Usage: kv_bench [-n entries] [-i iterations]\n");
+    return 1;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
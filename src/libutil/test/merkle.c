@@ -0,0 +1,158 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/libtap/tap.h"
+#include "src/libutil/merkle.h"
+
+static struct merkle *create_tree (int count)
+{
+    struct merkle *m;
+    char buf[32];
+    int i;
+
+    if (!(m = merkle_create (count)))
+        BAIL_OUT ("merkle_create %d failed", count);
+    for (i = 0; i < count; i++) {
+        snprintf (buf, sizeof (buf), "item-%d", i);
+        if (merkle_set_leaf (m, i, buf, strlen (buf)) < 0)
+            BAIL_OUT ("merkle_set_leaf %d failed", i);
+    }
+    if (merkle_build (m) < 0)
+        BAIL_OUT ("merkle_build failed");
+    return m;
+}
+
+/* Check that every leaf's proof reproduces the root, and that the
+ * proof fails to reproduce it for the wrong data or index.
+ */
+static void check_proofs (int count)
+{
+    struct merkle *m = create_tree (count);
+    unsigned char root[MERKLE_DIGEST_SIZE];
+    unsigned char r[MERKLE_DIGEST_SIZE];
+    unsigned char *proof;
+    char buf[32];
+    int good = 0;
+    int bad = 0;
+    int i;
+
+    if (merkle_root (m, root) < 0)
+        BAIL_OUT ("merkle_root failed");
+    if (!(proof = malloc (32 * MERKLE_DIGEST_SIZE)))
+        BAIL_OUT ("malloc failed");
+    for (i = 0; i < count; i++) {
+        snprintf (buf, sizeof (buf), "item-%d", i);
+        if (merkle_proof_len (i, count) > 31 || merkle_proof (m, i, proof) < 0)
+            BAIL_OUT ("merkle_proof %d failed", i);
+        if (merkle_proof_root (buf, strlen (buf), i, count, proof, r) == 0
+            && memcmp (r, root, sizeof (root)) == 0)
+            good++;
+        if (merkle_proof_root ("x", 1, i, count, proof, r) == 0
+            && memcmp (r, root, sizeof (root)) == 0)
+            bad++;
+        if (count > 1
+            && merkle_proof_root (buf, strlen (buf), (i + 1) % count, count,
+                                  proof, r) == 0
+            && memcmp (r, root, sizeof (root)) == 0)
+            bad++;
+    }
+    ok (good == count,
+        "count=%d: all proofs reproduce root", count);
+    ok (bad == 0,
+        "count=%d: no proof reproduces root for wrong data or index", count);
+    free (proof);
+    merkle_destroy (m);
+}
+
+void test_basic (void)
+{
+    struct merkle *m;
+    unsigned char root1[MERKLE_DIGEST_SIZE];
+    unsigned char root2[MERKLE_DIGEST_SIZE];
+
+    ok (merkle_proof_len (0, 1) == 0,
+        "merkle_proof_len index=0 count=1 is 0");
+    ok (merkle_proof_len (0, 2) == 1 && merkle_proof_len (1, 2) == 1,
+        "merkle_proof_len count=2 is 1");
+    ok (merkle_proof_len (0, 3) == 2 && merkle_proof_len (2, 3) == 1,
+        "merkle_proof_len count=3 is 2 or 1 for promoted leaf");
+    ok (merkle_proof_len (0, 1024) == 10,
+        "merkle_proof_len count=1024 is 10");
+
+    m = create_tree (5);
+    ok (merkle_root (m, root1) == 0,
+        "merkle_root works");
+    ok (merkle_set_leaf (m, 4, "foo", 3) == 0,
+        "merkle_set_leaf works on built tree");
+    errno = 0;
+    ok (merkle_root (m, root2) < 0 && errno == EINVAL,
+        "merkle_root fails with EINVAL after leaf change until rebuilt");
+    ok (merkle_build (m) == 0 && merkle_root (m, root2) == 0
+        && memcmp (root1, root2, sizeof (root1)) != 0,
+        "root changes when a leaf changes");
+    merkle_destroy (m);
+
+    check_proofs (1);
+    check_proofs (2);
+    check_proofs (3);
+    check_proofs (7);
+    check_proofs (64);
+    check_proofs (1001);
+}
+
+void test_inval (void)
+{
+    struct merkle *m;
+    unsigned char digest[MERKLE_DIGEST_SIZE];
+
+    errno = 0;
+    ok (merkle_create (0) == NULL && errno == EINVAL,
+        "merkle_create count=0 fails with EINVAL");
+    if (!(m = merkle_create (2)))
+        BAIL_OUT ("merkle_create failed");
+    errno = 0;
+    ok (merkle_set_leaf (m, 2, "foo", 3) < 0 && errno == EINVAL,
+        "merkle_set_leaf index=count fails with EINVAL");
+    errno = 0;
+    ok (merkle_set_leaf (m, 0, NULL, 3) < 0 && errno == EINVAL,
+        "merkle_set_leaf data=NULL len=3 fails with EINVAL");
+    errno = 0;
+    ok (merkle_proof (m, 0, digest) < 0 && errno == EINVAL,
+        "merkle_proof on unbuilt tree fails with EINVAL");
+    ok (merkle_proof_len (2, 2) < 0,
+        "merkle_proof_len index=count fails");
+    errno = 0;
+    ok (merkle_proof_root ("foo", 3, 0, 2, NULL, digest) < 0
+        && errno == EINVAL,
+        "merkle_proof_root proof=NULL count=2 fails with EINVAL");
+    merkle_destroy (m);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    test_basic ();
+    test_inval ();
+
+    done_testing ();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -43,6 +43,23 @@ const char *t3 = \
 "[t.a]\n" \
 "i = 42\n";
 
+/* strings in all their forms */
+const char *t4 = \
+"plain = \"foo bar\"\n" \
+"empty = \"\"\n" \
+"escaped = \"a\\tb\"\n" \
+"literal = 'c:\\dir'\n" \
+"multi = \"\"\"\nx\"\"\"\n" \
+"mliteral = '''y'''\n" \
+"[t]\n" \
+"i = 1\n";
+
+/* strings with control characters, which TOML disallows (except tab) */
+const char *ctrl_basic = "s = \"a\001b\"\n";
+const char *ctrl_literal = "s = 'a\037b'\n";
+const char *ctrl_del = "s = \"a\177b\"\n";
+const char *ctrl_tab = "s = 'a\tb'\n";
+
 /* bad on line 4 */
 const char *bad1 = \
 "# line 1\n" \
@@ -131,7 +148,7 @@ void test_tojson_t1 (void)
         && check_ts (ts, "1979-05-27T07:32:00Z"),
         "t1: has expected values");
     json_decref (obj);
-    toml_free (tab);
+    tomltk_free (tab);
 }
 
 void test_tojson_t2 (void)
@@ -160,7 +177,7 @@ void test_tojson_t2 (void)
     ok (ia[0] == 1 && ia[1] == 2 && ia[2] == 3,
         "t2: has expected values");
     json_decref (obj);
-    toml_free (tab);
+    tomltk_free (tab);
 }
 
 void test_tojson_t3 (void)
@@ -190,7 +207,84 @@ void test_tojson_t3 (void)
     ok (i == 42,
         "t3: has expected values");
     json_decref (obj);
-    toml_free (tab);
+    tomltk_free (tab);
+}
+
+void test_update_t4 (void)
+{
+    toml_table_t *tab;
+    json_t *obj;
+    const char *plain, *empty, *escaped, *literal, *multi, *mliteral;
+    int i = 0;
+    int keep = 0;
+    int rc;
+    struct tomltk_error error;
+
+    tab = tomltk_parse (t4, strlen (t4), &error);
+    ok (tab != NULL,
+        "t4: tomltk_parse works");
+    if (!tab)
+        BAIL_OUT ("%s: %d: %s", error.filename, error.lineno, error.errbuf);
+    if (!(obj = json_pack ("{s:s s:i}", "plain", "old", "keep", 1)))
+        BAIL_OUT ("json_pack failed");
+    ok (tomltk_table_update_json (obj, tab) == 0,
+        "t4: tomltk_table_update_json works");
+    jdiag ("t4", obj);
+    rc = json_unpack (obj, "{s:s s:s s:s s:s s:s s:s s:{s:i} s:i}",
+                      "plain", &plain,
+                      "empty", &empty,
+                      "escaped", &escaped,
+                      "literal", &literal,
+                      "multi", &multi,
+                      "mliteral", &mliteral,
+                      "t", "i", &i,
+                      "keep", &keep);
+    ok (rc == 0,
+        "t4: unpack successful");
+    ok (rc == 0 && !strcmp (plain, "foo bar") && !strcmp (empty, "")
+        && !strcmp (escaped, "a\tb") && !strcmp (literal, "c:\\dir")
+        && !strcmp (multi, "x") && !strcmp (mliteral, "y"),
+        "t4: strings converted correctly, existing value replaced");
+    ok (rc == 0 && i == 1 && keep == 1,
+        "t4: table added and unrelated key kept");
+
+    errno = 0;
+    ok (tomltk_table_update_json (NULL, tab) < 0 && errno == EINVAL,
+        "tomltk_table_update_json obj=NULL fails with EINVAL");
+    errno = 0;
+    ok (tomltk_table_update_json (obj, NULL) < 0 && errno == EINVAL,
+        "tomltk_table_update_json tab=NULL fails with EINVAL");
+
+    json_decref (obj);
+    tomltk_free (tab);
+}
+
+void test_control_chars (void)
+{
+    const char *bad[] = { ctrl_basic, ctrl_literal, ctrl_del, NULL };
+    toml_table_t *tab;
+    json_t *obj;
+    const char *s;
+    int i;
+
+    for (i = 0; bad[i] != NULL; i++) {
+        if (!(tab = tomltk_parse (bad[i], strlen (bad[i]), NULL)))
+            BAIL_OUT ("tomltk_parse ctrl %d failed", i);
+        errno = 0;
+        ok (tomltk_table_to_json (tab) == NULL && errno == EINVAL,
+            "ctrl %d: string with control character is rejected", i);
+        tomltk_free (tab);
+    }
+
+    if (!(tab = tomltk_parse (ctrl_tab, strlen (ctrl_tab), NULL)))
+        BAIL_OUT ("tomltk_parse ctrl_tab failed");
+    obj = tomltk_table_to_json (tab);
+    ok (obj != NULL
+        && json_unpack (obj, "{s:s}", "s", &s) == 0
+        && !strcmp (s, "a\tb"),
+        "ctrl_tab: string with tab is accepted");
+    json_decref (obj);
+    tomltk_free (tab);
 }
 
 void test_parse_lineno (void)
@@ -262,6 +356,8 @@ int main (int argc, char *argv[])
     test_tojson_t1 ();
     test_tojson_t2 ();
     test_tojson_t3 ();
+    test_update_t4 ();
+    test_control_chars ();
     test_parse_lineno ();
     test_corner ();
 
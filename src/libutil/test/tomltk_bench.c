@@ -0,0 +1,150 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* tomltk_bench - compare malloc and arena backed TOML parsing
+ *
+ * Usage: tomltk_bench [-n iterations] file.toml ...
+ *
+ * Each file is read into memory once, then parsed and freed 'iterations'
+ * times with toml_parse()/toml_free() and tomltk_parse()/tomltk_free().
+ * Try it on config files such as etc/sign.toml, and on curve certs.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+#include "src/libtomlc99/toml.h"
+#include "src/libutil/tomltk.h"
+
+static double now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+static char *read_file (const char *path, int *lenp)
+{
+    FILE *fp;
+    char *buf = NULL;
+    int len = 0;
+    int n;
+
+    if (!(fp = fopen (path, "r")))
+        return NULL;
+    do {
+        char *new;
+        if (!(new = realloc (buf, len + 4097))) {
+            free (buf);
+            fclose (fp);
+            return NULL;
+        }
+        buf = new;
+        n = fread (buf + len, 1, 4096, fp);
+        len += n;
+    } while (n > 0);
+    buf[len] = '\0';
+    fclose (fp);
+    *lenp = len;
+    return buf;
+}
+
+static void bench (const char *path, int iterations)
+{
+    char errbuf[200];
+    char *buf;
+    char *cpy;
+    int len;
+    double t;
+    double t_malloc;
+    double t_arena;
+    int i;
+
+    if (!(buf = read_file (path, &len))) {
+        fprintf (stderr, "%s: %s\n", path, strerror (errno));
+        exit (1);
+    }
+    if (!(cpy = malloc (len + 1))) {
+        fprintf (stderr, "out of memory\n");
+        exit (1);
+    }
+    t = now ();
+    for (i = 0; i < iterations; i++) {
+        toml_table_t *tab;
+
+        /* tomltk_parse() copies the input too, so do the same here.
+         */
+        memcpy (cpy, buf, len + 1);
+        if (!(tab = toml_parse (cpy, errbuf, sizeof (errbuf)))) {
+            fprintf (stderr, "%s: %s\n", path, errbuf);
+            exit (1);
+        }
+        toml_free (tab);
+    }
+    t_malloc = now () - t;
+
+    t = now ();
+    for (i = 0; i < iterations; i++) {
+        struct tomltk_error error;
+        toml_table_t *tab;
+
+        if (!(tab = tomltk_parse (buf, len, &error))) {
+            fprintf (stderr, "%s: %s\n", path, error.errbuf);
+            exit (1);
+        }
+        tomltk_free (tab);
+    }
+    t_arena = now () - t;
+
+    printf ("%s: %d bytes: malloc %.2fus arena %.2fus per parse (%.2fx)\n",
+            path,
+            len,
+            t_malloc * 1E6 / iterations,
+            t_arena * 1E6 / iterations,
+            t_arena > 0 ? t_malloc / t_arena : 0.);
+    free (cpy);
+    free (buf);
+}
+
+int main (int argc, char *argv[])
+{
+    int iterations = 10000;
+    int ch;
+    int i;
+
+    while ((ch = getopt (argc, argv, "n:")) != -1) {
+        switch (ch) {
+            case 'n':
+                iterations = strtol (optarg, NULL, 10);
+                break;
+            default:
+                goto usage;
+        }
+    }
+    if (optind == argc || iterations <= 0)
+        goto usage;
+    for (i = optind; i < argc; i++)
+        bench (argv[i], iterations);
+    return 0;
+usage:
+    fprintf (stderr, "Usage: tomltk_bench [-n iterations] file.toml ...\n");
+    return 1;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -14,15 +14,83 @@
 
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <string.h>
 #include <jansson.h>
 
 #include "src/libtomlc99/toml.h"
 #include "timestamp.h"
+#include "arena.h"
 #include "tomltk.h"
 
+/* While tomltk_parse() or tomltk_parse_file() is running in a thread,
+ * tomlc99 allocates from that thread's arena.  Otherwise the memutil
+ * hooks fall through to the C library, so other tomlc99 users are not
+ * affected.
+ */
+static __thread struct arena *parse_arena;
+static int memutil_installed;
+
+static void *arena_malloc_hook (size_t size)
+{
+    if (parse_arena)
+        return arena_malloc (parse_arena, size);
+    return malloc (size);
+}
+
+static void arena_free_hook (void *ptr)
+{
+    if (parse_arena)
+        arena_free (parse_arena, ptr);
+    else
+        free (ptr);
+}
+
+static void *arena_calloc_hook (size_t nmemb, size_t size)
+{
+    if (parse_arena)
+        return arena_calloc (parse_arena, nmemb, size);
+    return calloc (nmemb, size);
+}
+
+static void *arena_realloc_hook (void *ptr, size_t size)
+{
+    if (parse_arena)
+        return arena_realloc (parse_arena, ptr, size);
+    return realloc (ptr, size);
+}
+
+/* Create an arena and direct tomlc99 allocations in this thread to it.
+ */
+static struct arena *parse_begin (void)
+{
+    struct arena *arena;
+
+    if (!__atomic_load_n (&memutil_installed, __ATOMIC_ACQUIRE)) {
+        toml_set_memutil (arena_malloc_hook,
+                          arena_free_hook,
+                          arena_calloc_hook,
+                          arena_realloc_hook);
+        __atomic_store_n (&memutil_installed, 1, __ATOMIC_RELEASE);
+    }
+    if (!(arena = arena_create ()))
+        return NULL;
+    parse_arena = arena;
+    return arena;
+}
+
+/* Stop directing allocations to the arena.  If parsing failed, destroy it.
+ */
+static void parse_end (struct arena *arena, toml_table_t *tab)
+{
+    parse_arena = NULL;
+    if (!tab)
+        arena_destroy (arena);
+}
+
 static int table_to_json (toml_table_t *tab, json_t **op);
 
 static void errprintf (struct tomltk_error *error,
@@ -130,6 +198,34 @@ json_t *tomltk_epoch_to_json (time_t t)
     return obj;
 }
 
+/* Return true if raw TOML value is a single line basic or literal string
+ * without escapes or control characters, so its JSON value can be taken
+ * from the raw value as is.  Anything else is left to toml_rtos(), which
+ * also rejects the control characters TOML disallows (all but tab).
+ */
+static bool is_plain_string (const char *raw)
+{
+    char quote = raw[0];
+    size_t len;
+    size_t i;
+
+    if (quote != '"' && quote != '\'')
+        return false;
+    len = strlen (raw);
+    if (len < 2 || raw[len - 1] != quote)
+        return false;
+    if (len >= 6 && raw[1] == quote && raw[2] == quote) // multi-line
+        return false;
+    if (quote == '"' && memchr (raw, '\\', len))
+        return false;
+    for (i = 1; i < len - 1; i++) {
+        unsigned char ch = raw[i];
+        if ((ch < 0x20 && ch != '\t') || ch == 0x7f)
+            return false;
+    }
+    return true;
+}
+
 /* Convert raw TOML value from toml_raw_in() or toml_raw_at() to JSON.
  */
 static int value_to_json (const char *raw, json_t **op)
@@ -141,7 +237,11 @@ static int value_to_json (const char *raw, json_t **op)
     toml_timestamp_t ts;
     json_t *obj;
 
-    if (toml_rtos (raw, &s) == 0) {
+    if (is_plain_string (raw)) {
+        if (!(obj = json_stringn (raw + 1, strlen (raw) - 2)))
+            goto nomem;
+    }
+    else if (toml_rtos (raw, &s) == 0) {
         obj = json_string (s);
         free (s);
         if (!obj)
@@ -270,6 +370,81 @@ error:
     return -1;
 }
 
+/* Convert the value of key 'i' of 'tab', where keys are ordered values,
+ * then arrays, then tables, as with toml_key_in().
+ */
+static int key_to_json (toml_table_t *tab, int i, json_t **op)
+{
+    int nkval = toml_table_nkval (tab);
+    int narr = toml_table_narr (tab);
+    const char *key;
+    const char *raw;
+    toml_array_t *arr;
+    toml_table_t *subtab;
+
+    if (!(key = toml_key_in (tab, i)))
+        goto inval;
+    if (i < nkval) {
+        if (!(raw = toml_raw_in (tab, key)))
+            goto inval;
+        return value_to_json (raw, op);
+    }
+    if (i < nkval + narr) {
+        if (!(arr = toml_array_in (tab, key)))
+            goto inval;
+        return array_to_json (arr, op);
+    }
+    if (!(subtab = toml_table_in (tab, key)))
+        goto inval;
+    return table_to_json (subtab, op);
+inval:
+    errno = EINVAL;
+    return -1;
+}
+
+int tomltk_table_update_json (json_t *obj, toml_table_t *tab)
+{
+    json_t *small[32] = { NULL };
+    json_t **val = small;
+    int saved_errno;
+    int n;
+    int i;
+
+    if (!obj || !json_is_object (obj) || !tab) {
+        errno = EINVAL;
+        return -1;
+    }
+    n = toml_table_nkval (tab) + toml_table_narr (tab) + toml_table_ntab (tab);
+    if (n > 32 && !(val = calloc (n, sizeof (val[0]))))
+        return -1;
+    /* Convert all values before changing 'obj', so it is left unchanged
+     * if a value can't be converted.
+     */
+    for (i = 0; i < n; i++) {
+        if (key_to_json (tab, i, &val[i]) < 0)
+            goto error;
+    }
+    for (i = 0; i < n; i++) {
+        json_t *v = val[i];
+        val[i] = NULL;
+        if (json_object_set_new (obj, toml_key_in (tab, i), v) < 0) {
+            errno = ENOMEM;
+            goto error;
+        }
+    }
+    if (val != small)
+        free (val);
+    return 0;
+error:
+    saved_errno = errno;
+    for (i = 0; i < n; i++)
+        json_decref (val[i]);
+    if (val != small)
+        free (val);
+    errno = saved_errno;
+    return -1;
+}
+
 json_t *tomltk_table_to_json (toml_table_t *tab)
 {
     json_t *obj;
@@ -288,6 +463,7 @@ toml_table_t *tomltk_parse (const char *conf, int len,
 {
     char errbuf[200];
     char *cpy;
+    struct arena *arena;
     toml_table_t *tab;
 
     if (len < 0 || (!conf && len != 0)) {
@@ -295,14 +471,18 @@ toml_table_t *tomltk_parse (const char *conf, int len,
         errno = EINVAL;
         return NULL;
     }
-    if (!(cpy = calloc (1, len + 1))) {
+    if (!(arena = parse_begin ())
+        || !(cpy = arena_malloc (arena, len + 1))) {
+        parse_end (arena, NULL);
         errprintf (error, NULL, -1, "out of memory");
         errno = ENOMEM;
         return NULL;
     }
     memcpy (cpy, conf, len);
+    cpy[len] = '\0';
     tab = toml_parse (cpy, errbuf, sizeof (errbuf));
-    free (cpy);
+    arena_free (arena, cpy);
+    parse_end (arena, tab);
     if (!tab) {
         errfromtoml (error, NULL, errbuf);
         errno = EINVAL;
@@ -316,6 +496,7 @@ toml_table_t *tomltk_parse_file (const char *filename,
 {
     char errbuf[200];
     FILE *fp;
+    struct arena *arena;
     toml_table_t *tab;
 
     if (!filename) {
@@ -327,9 +508,16 @@ toml_table_t *tomltk_parse_file (const char *filename,
         errprintf (error, filename, -1, "%s", strerror (errno));
         return NULL;
     }
+    if (!(arena = parse_begin ())) {
+        errprintf (error, filename, -1, "out of memory");
+        (void)fclose (fp);
+        errno = ENOMEM;
+        return NULL;
+    }
     // N.B. toml_parse_file() doesn't give us any way to distinguish parse
     // error from read error
     tab = toml_parse_file (fp, errbuf, sizeof (errbuf));
+    parse_end (arena, tab);
     (void)fclose (fp);
     if (!tab) {
         errfromtoml (error, filename, errbuf);
@@ -339,6 +527,12 @@ toml_table_t *tomltk_parse_file (const char *filename,
     return tab;
 }
 
+void tomltk_free (toml_table_t *tab)
+{
+    if (tab)
+        arena_destroy (arena_from_ptr (tab));
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -32,6 +32,14 @@ struct tomltk_error {
  */
 json_t *tomltk_table_to_json (toml_table_t *tab);
 
+/* Convert each top-level key of TOML table 'tab' and set it in JSON
+ * object 'obj', replacing any existing value, without building a JSON
+ * copy of the whole table first.  If any value can't be converted,
+ * 'obj' is left unchanged.
+ * Return 0 on success, or -1 on failure with errno set.
+ */
+int tomltk_table_update_json (json_t *obj, toml_table_t *tab);
+
 /* Convert timestamp JSON object to a time_t (UTC).
  * Return 0 on success, or -1 on failure with errno set.
  */
@@ -51,6 +59,8 @@ int tomltk_ts_to_epoch (toml_timestamp_t *ts, time_t *tp);
  * adding NULL termination.  On success, 0 is returned.
  * On failure -1 is returned with errno set.  If 'error' is
  * non-NULL, an error description is written there.
+ * The table is allocated from an arena and must be freed
+ * with tomltk_free(), not toml_free().
  */
 toml_table_t *tomltk_parse (const char *conf, int len,
                             struct tomltk_error *error);
@@ -59,10 +69,16 @@ toml_table_t *tomltk_parse (const char *conf, int len,
  * opens/closes 'filename'.  On success, 0 is returned.
  * On failure -1 is returned with errno set.  If 'error' is
  * non-NULL, and error description is written there.
+ * The table must be freed with tomltk_free().
  */
 toml_table_t *tomltk_parse_file (const char *filename,
                                  struct tomltk_error *error);
 
+/* Free a table returned by tomltk_parse() or tomltk_parse_file(),
+ * all at once.
+ */
+void tomltk_free (toml_table_t *tab);
+
 #endif /* !_UTIL_TOMLTK_H */
 
 /*
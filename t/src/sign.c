@@ -10,7 +10,10 @@
 
 /* sign.c - sign stdin
  *
- * Usage: sign <input >output
+ * Usage: sign [--batch=N] <input >output
+ *
+ * With --batch=N, sign N copies of the input as a batch and write one
+ * credential per line.
  */
 
 #if HAVE_CONFIG_H
@@ -60,9 +63,12 @@ int main (int argc, char **argv)
     char buf[1024];
     int buflen;
     const char *msg;
+    int batch = 0;
 
-    if (argc != 1)
-        die ("Usage: sign <input >output");
+    if (argc == 2 && !strncmp (argv[1], "--batch=", 8))
+        batch = strtol (argv[1] + 8, NULL, 10);
+    if (argc > 2 || (argc == 2 && batch <= 0))
+        die ("Usage: sign [--batch=N] <input >output");
 
     if (!(ctx = flux_security_create (0)))
         die ("flux_security_create");
@@ -71,10 +77,31 @@ int main (int argc, char **argv)
 
     buflen = read_all (buf, sizeof (buf));
 
-    if (!(msg = flux_sign_wrap (ctx, buf, buflen, NULL, 0)))
-        die ("flux_sign_wrap: %s", flux_security_last_error (ctx));
-
-    printf ("%s\n", msg);
+    if (batch > 0) {
+        const void **pay;
+        int *paysz;
+        const char **msgs;
+        int i;
+
+        if (!(pay = calloc (batch, sizeof (pay[0])))
+            || !(paysz = calloc (batch, sizeof (paysz[0]))))
+            die ("out of memory");
+        for (i = 0; i < batch; i++) {
+            pay[i] = buf;
+            paysz[i] = buflen;
+        }
+        if (!(msgs = flux_sign_wrap_batch (ctx, pay, paysz, batch, NULL, 0)))
+            die ("flux_sign_wrap_batch: %s", flux_security_last_error (ctx));
+        for (i = 0; i < batch; i++)
+            printf ("%s\n", msgs[i]);
+        free (pay);
+        free (paysz);
+    }
+    else {
+        if (!(msg = flux_sign_wrap (ctx, buf, buflen, NULL, 0)))
+            die ("flux_sign_wrap: %s", flux_security_last_error (ctx));
+        printf ("%s\n", msg);
+    }
 
     flux_security_destroy (ctx);
 
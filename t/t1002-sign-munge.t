@@ -67,6 +67,23 @@ test_expect_success 'sign/verify a short message' '
 	test_cmp sign.in verify.out
 '
 
+test_expect_success 'sign/verify a batch' '
+	${sign} --batch=5 <sign.in >batch.out &&
+	test $(wc -l <batch.out) -eq 5 &&
+	for i in 1 2 3 4 5; do
+		sed -n ${i}p batch.out | ${verify} >batch.verify &&
+		test_cmp sign.in batch.verify || return 1
+	done
+'
+
+test_expect_success 'batch item with proof of another item fails verify' '
+	hp=$(sed -n 2p batch.out | cut -d. -f1,2) &&
+	sig=$(sed -n 1p batch.out | cut -d. -f3) &&
+	echo "$hp.$sig" >xbatch.out &&
+	test_must_fail ${verify} <xbatch.out 2>xbatch.err &&
+	grep -q "hash mismatch" xbatch.err
+'
+
 test_expect_success 'verify a hand-created test message' '
 	${xsign} good </dev/null >good.out &&
 	${verify} <good.out
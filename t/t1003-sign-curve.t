@@ -99,6 +99,61 @@ test_expect_success 'sign/verify a short message' '
 	test_cmp sign.in verify.out
 '
 
+test_expect_success 'sign/verify a batch' '
+	${sign} --batch=5 <sign.in >batch.out &&
+	test $(wc -l <batch.out) -eq 5 &&
+	for i in 1 2 3 4 5; do
+		sed -n ${i}p batch.out | ${verify} >batch.verify &&
+		test_cmp sign.in batch.verify || return 1
+	done
+'
+
+test_expect_success 'batch item with proof of another item fails verify' '
+	hp=$(sed -n 2p batch.out | cut -d. -f1,2) &&
+	sig=$(sed -n 1p batch.out | cut -d. -f3) &&
+	echo "$hp.$sig" >xbatch.out &&
+	test_must_fail ${verify} <xbatch.out 2>xbatch.err &&
+	grep -q "verification failure" xbatch.err
+'
+
+test_expect_success 'enable delegated signing with too short delegate-ttl' '
+	config_sign >conf.d/sign.toml &&
+	config_sign_curve_ca >>conf.d/sign.toml &&
+	echo "delegate-ttl = 10" >>conf.d/sign.toml
+'
+
+test_expect_success 'sign fails with delegate-ttl < max-ttl' '
+	test_must_fail ${sign} <sign.in 2>dttl.err &&
+	grep -q "delegate-ttl must be" dttl.err
+'
+
+test_expect_success 'enable delegated signing' '
+	config_sign >conf.d/sign.toml &&
+	config_sign_curve_ca >>conf.d/sign.toml &&
+	echo "delegate-ttl = 3600" >>conf.d/sign.toml
+'
+
+test_expect_success 'sign/verify a short message with delegated cert' '
+	${sign} <sign.in >dsign.out &&
+	cut -d. -f1 dsign.out | base64 -d | tr "\000" "\n" >dsign.header &&
+	grep -q "^curve.dcert." dsign.header &&
+	${verify} <dsign.out >dverify.out &&
+	test_cmp sign.in dverify.out
+'
+
+test_expect_success 'sign/verify a batch with delegated cert' '
+	${sign} --batch=3 <sign.in >dbatch.out &&
+	for i in 1 2 3; do
+		sed -n ${i}p dbatch.out | ${verify} >dbatch.verify &&
+		test_cmp sign.in dbatch.verify || return 1
+	done
+'
+
+test_expect_success 'disable delegated signing' '
+	config_sign >conf.d/sign.toml &&
+	config_sign_curve_ca >>conf.d/sign.toml
+'
+
 test_expect_success 'switch to un-CA-signed cert' '
 	mv u.pub u.pub.signed &&
 	mv u.pub.unsigned u.pub
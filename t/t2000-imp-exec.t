@@ -135,6 +135,22 @@ test_expect_success SUDO 'flux-imp exec works under sudo' '
 	id -u > id-sudo.expected &&
         test_cmp id-sudo.expected id-sudo.out
 '
+test_expect_success SUDO 'flux-imp exec rejects invalid cgroup path' '
+	printf "{\"J\":\"%s\",\"cgroup\":\"/../foo\"}" \
+	    $(echo foo | FLUX_IMP_CONFIG_PATTERN=sign-none.toml $sign) | \
+	    test_must_fail $SUDO FLUX_IMP_CONFIG_PATTERN=sign-none.toml \
+	      $flux_imp exec id -u >cgroup-invalid.out 2>&1 &&
+	test_debug "cat cgroup-invalid.out" &&
+	grep "exec: cgroup /../foo: Invalid argument" cgroup-invalid.out
+'
+test_expect_success SUDO 'flux-imp exec rejects cgroup not owned by IMP user' '
+	printf "{\"J\":\"%s\",\"cgroup\":\"/\"}" \
+	    $(echo foo | FLUX_IMP_CONFIG_PATTERN=sign-none.toml $sign) | \
+	    test_must_fail $SUDO FLUX_IMP_CONFIG_PATTERN=sign-none.toml \
+	      $flux_imp exec id -u >cgroup-owner.out 2>&1 &&
+	test_debug "cat cgroup-owner.out" &&
+	grep "exec: cgroup /: " cgroup-owner.out
+'
 test_expect_success SUDO 'flux-imp exec passes more than one argument to shell' '
 	( export FLUX_IMP_CONFIG_PATTERN=sign-none.toml  &&
           fake_imp_input foo | \
@@ -145,6 +161,56 @@ test_expect_success SUDO 'flux-imp exec passes more than one argument to shell'
 	id --zero --user > id-sudo2.expected &&
         test_cmp id-sudo2.expected id-sudo2.out
 '
+fake_multi_input() {
+	J=$(echo foo | FLUX_IMP_CONFIG_PATTERN=sign-none.toml $sign) &&
+	printf "[" &&
+	sep="" &&
+	for shell in "$@"; do
+		printf "%s{\"J\":\"%s\",\"shell_path\":\"%s\",\"args\":[\"%s\"]}" \
+		    "$sep" $J $shell $shell-arg
+		sep=","
+	done &&
+	printf "]"
+}
+test_expect_success 'flux-imp exec: multiple jobs require setuid IMP' '
+	( export FLUX_IMP_CONFIG_PATTERN=sign-none.toml &&
+	  fake_multi_input echo echo | \
+	    test_must_fail $flux_imp exec >multi-unpriv.log 2>&1
+	) &&
+	grep "multiple jobs require a setuid IMP" multi-unpriv.log
+'
+test_expect_success 'flux-imp exec: multiple jobs input must be an array' '
+	( export FLUX_IMP_CONFIG_PATTERN=sign-none.toml &&
+	  fake_imp_input foo | \
+	    test_must_fail $flux_imp exec >multi-notarray.log 2>&1
+	) &&
+	grep "missing arguments" multi-notarray.log
+'
+test_expect_success SUDO 'flux-imp exec launches multiple jobs' '
+	fake_multi_input echo echo | \
+	    $SUDO FLUX_IMP_CONFIG_PATTERN=sign-none.toml \
+	      $flux_imp exec >multi.out &&
+	test_debug "cat multi.out" &&
+	test $(grep -c "^echo-arg$" multi.out) -eq 2 &&
+	grep "\"index\":0,.*\"status\":0" multi.out &&
+	grep "\"index\":1,.*\"status\":0" multi.out
+'
+test_expect_success SUDO 'flux-imp exec reports exit status of each job' '
+	fake_multi_input echo id | \
+	    test_must_fail $SUDO FLUX_IMP_CONFIG_PATTERN=sign-none.toml \
+	      $flux_imp exec >multi-status.out &&
+	test_debug "cat multi-status.out" &&
+	grep "\"index\":0,.*\"status\":0" multi-status.out &&
+	grep "\"index\":1,.*\"status\":1" multi-status.out
+'
+test_expect_success SUDO 'flux-imp exec checks every shell of multiple jobs' '
+	fake_multi_input echo printf | \
+	    test_must_fail $SUDO FLUX_IMP_CONFIG_PATTERN=sign-none.toml \
+	      $flux_imp exec >multi-badshell.out 2>&1 &&
+	test_debug "cat multi-badshell.out" &&
+	grep "not in allowed-shells" multi-badshell.out &&
+	test_must_fail grep "echo-arg" multi-badshell.out
+'
 test "$chain_lint" = "t" || test_set_prereq NO_CHAIN_LINT
 test_expect_success SUDO,NO_CHAIN_LINT 'flux-imp exec: setuid IMP lingers' '
 	cat <<-EOF >sleeper.sh &&
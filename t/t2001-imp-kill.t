@@ -91,6 +91,60 @@ test_expect_success NO_CHAIN_LINT,SYSTEMD_CGROUP,SUDO 'flux-imp kill: works with
 	    $flux_imp kill 15 $pid >${name}.log 2>&1 &&
 	test_expect_code 143 wait $pid
 '
+test_expect_success 'flux-imp kill: --cgroup requires SIGNAL and PID' '
+	test_must_fail $flux_imp kill --cgroup 15 >cgroup-usage.log 2>&1 &&
+	grep "Usage flux-imp kill \[--cgroup\] SIGNAL PID\.\.\." cgroup-usage.log
+'
+test_expect_success NO_CHAIN_LINT,SYSTEMD_CGROUP 'flux-imp kill: --cgroup refuses own cgroup' '
+	name=cgroup-self &&
+	cat <<-EOF >${name}.toml
+	[exec]
+	allowed-users = [ "$(whoami)" ]
+	EOF
+	sleep 300 & pid=$! &&
+	( export FLUX_IMP_CONFIG_PATTERN=${name}.toml &&
+	  test_must_fail $flux_imp kill --cgroup 15 $pid >${name}.log 2>&1
+	) &&
+	test_debug "cat ${name}.log" &&
+	grep "kill: refusing" ${name}.log &&
+	kill $pid
+'
+test_expect_success NO_CHAIN_LINT,SYSTEMD_CGROUP 'flux-imp kill: signals multiple pids' '
+	name=multi &&
+	cat <<-EOF >${name}.toml
+	[exec]
+	allowed-users = [ "$(whoami)" ]
+	EOF
+	sleep 300 & pid1=$!
+	sleep 300 & pid2=$! &&
+	FLUX_IMP_CONFIG_PATTERN=${name}.toml \
+	    $flux_imp kill 15 $pid1 $pid2 >${name}.out 2>${name}.err &&
+	test_debug "cat ${name}.out ${name}.err" &&
+	grep "pid=$pid1 result=ok" ${name}.out &&
+	grep "pid=$pid2 result=ok" ${name}.out &&
+	test_expect_code 143 wait $pid1 &&
+	test_expect_code 143 wait $pid2
+'
+test_expect_success NO_CHAIN_LINT,SYSTEMD_CGROUP 'flux-imp kill: reports per-pid failure' '
+	name=multi-fail &&
+	cat <<-EOF >${name}.toml
+	[exec]
+	allowed-users = [ "$(whoami)" ]
+	EOF
+	for nopid in `seq 10000 12000`; do
+            kill -s 0 ${nopid} >/dev/null 2>&1 || break
+        done
+	sleep 300 & pid=$! &&
+	( export FLUX_IMP_CONFIG_PATTERN=${name}.toml &&
+	  test_must_fail $flux_imp kill 15 $pid $nopid \
+	    >${name}.out 2>${name}.err
+	) &&
+	test_debug "cat ${name}.out ${name}.err" &&
+	grep "pid=$pid result=ok" ${name}.out &&
+	grep "pid=$nopid result=failed" ${name}.out &&
+	grep "failed to signal 1 of 2 pids" ${name}.err &&
+	test_expect_code 143 wait $pid
+'
 test_expect_success SYSTEMD_CGROUP 'flux-imp kill: fails for nonexistent pid' '
 	name=pid-noexist &&
 	cat <<-EOF >${name}.toml &&
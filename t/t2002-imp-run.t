@@ -177,7 +177,7 @@ test_expect_success SUDO 'flux-imp run checks permission of parent dir' '
 	$SUDO chmod 755 $TESTDIR
 '
 test_expect_success SUDO 'cleanup test directory (sudo)' '
-	$SUDO rm $TESTDIR/* && $SUDO rmdir $TESTDIR
+	$SUDO rm -f $TESTDIR/* $TESTDIR/.cf-cache && $SUDO rmdir $TESTDIR
 '
 test_expect_success 'cleanup test directory' '
 	if test -d $TESTDIR; then rm -rf $TESTDIR; fi
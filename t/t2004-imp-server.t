@@ -0,0 +1,213 @@
+#!/bin/sh
+#
+
+test_description='IMP server functionality test
+
+Forward flux-imp commands to a flux-imp server over its socket
+'
+
+# Append --logfile option if FLUX_TESTS_LOGFILE is set in environment:
+test -n "$FLUX_TESTS_LOGFILE" && set -- "$@" --logfile
+. `dirname $0`/sharness.sh
+
+flux_imp=${SHARNESS_BUILD_DIRECTORY}/src/imp/flux-imp
+sign=${SHARNESS_BUILD_DIRECTORY}/t/src/sign
+
+echo "# Using ${flux_imp}"
+
+fake_imp_input() {
+	printf '{"J":"%s"}' $(echo $1 | FLUX_IMP_CONFIG_PATTERN=server.toml $sign)
+}
+
+#  The socket path must be short, so keep it out of the trash directory
+sockdir=$(mktemp -d)
+chmod 755 $sockdir
+socket=$sockdir/imp.sock
+export FLUX_IMP_SERVER_SOCKET=$socket
+
+waitsock()
+{
+	count=0
+	while ! test -S $1; do
+	    sleep 0.2
+	    count=$((count+1))
+	    test $count -gt 50 && break
+	done
+	test -S $1
+}
+
+test_expect_success 'create config for flux-imp server' '
+	cat <<-EOF >server.toml
+	[sign]
+	max-ttl = 30
+	default-type = "none"
+	allowed-types = [ "none" ]
+	[exec]
+	allowed-users = [ "$(whoami)" ]
+	allowed-shells = [ "id", "sh" ]
+	EOF
+'
+test "$(id -u)" != 0 && test_set_prereq NONROOT
+
+test_expect_success NONROOT 'flux-imp server fails when not run as root' '
+	test_must_fail env FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp server >notroot.log 2>&1 &&
+	grep "must be run as root" notroot.log
+'
+test_expect_success SUDO 'flux-imp server fails without a socket path' '
+	test_must_fail $SUDO env -u FLUX_IMP_SERVER_SOCKET \
+	    FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp server >nosocket.log 2>&1 &&
+	grep "no socket path is configured" nosocket.log
+'
+test_expect_success 'commands run locally when no server is listening' '
+	FLUX_IMP_CONFIG_PATTERN=server.toml $flux_imp whoami >local.out &&
+	test_must_fail grep "flux-imp: privileged" local.out
+'
+test "$chain_lint" = "t" || test_set_prereq NO_CHAIN_LINT
+
+test_expect_success NO_CHAIN_LINT,SUDO 'start flux-imp server' '
+	$SUDO sh -c "echo \$\$ >server.pid && \
+	    exec env FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    FLUX_IMP_SERVER_SOCKET=$socket \
+	    $flux_imp server >server.log 2>&1" &
+	waitsock $socket &&
+	test_debug "cat server.log"
+'
+test -S $socket && test_set_prereq SERVER
+
+test_expect_success SERVER 'flux-imp whoami is served by flux-imp server' '
+	FLUX_IMP_CONFIG_PATTERN=server.toml $flux_imp whoami >whoami.out &&
+	test_debug "cat whoami.out" &&
+	grep "flux-imp: privileged: uid=$(id -u) euid=0" whoami.out
+'
+test_expect_success SERVER 'forwarding flux-imp does not read configuration' '
+	FLUX_IMP_CONFIG_PATTERN=/nonexistent/*.toml \
+	    $flux_imp whoami >noconf.out &&
+	grep "flux-imp: privileged: uid=$(id -u) euid=0" noconf.out
+'
+test_expect_success SERVER 'flux-imp exec is served by flux-imp server' '
+	fake_imp_input foo | \
+	    FLUX_IMP_CONFIG_PATTERN=server.toml $flux_imp exec id -u >id.out &&
+	test "$(cat id.out)" = "$(id -u)"
+'
+test_expect_success SERVER 'flux-imp server returns exit status of job shell' '
+	fake_imp_input foo | \
+	    test_expect_code 42 env FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp exec sh -c "exit 42"
+'
+test_expect_success SERVER 'flux-imp server passes sanitized environment to job shell' '
+	fake_imp_input foo | \
+	    env FLUX_IMP_CONFIG_PATTERN=server.toml TESTVAR=ok \
+	    GCONV_PATH=/tmp LD_LIBRARY_PATH=/nonexistent \
+	    $flux_imp exec sh -c "echo \$TESTVAR:\$GCONV_PATH:\$LD_LIBRARY_PATH" \
+	    >env.out &&
+	test_debug "cat env.out" &&
+	test "$(cat env.out)" = "ok::"
+'
+test_expect_success SERVER 'flux-imp server applies exec.allowed-shells' '
+	fake_imp_input foo | \
+	    test_must_fail env FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp exec /bin/true foo >badshell.log 2>&1 &&
+	test_debug "cat badshell.log" &&
+	grep "shell not in allowed-shells" badshell.log
+'
+test_expect_success SERVER 'flux-imp server runs job shell with umask and limits of caller' '
+	fake_imp_input foo >attr.json &&
+	( umask 027 &&
+	  ulimit -S -n 100 &&
+	  FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp exec sh -c "umask; ulimit -S -n" <attr.json
+	) >attr.out &&
+	test_debug "cat attr.out" &&
+	printf "0027\n100\n" >attr.expected &&
+	test_cmp attr.expected attr.out
+'
+
+#  Move the server into a cgroup of its own, where possible, to check
+#   that commands are run in the cgroup of the caller instead.
+for dir in /sys/fs/cgroup /sys/fs/cgroup/systemd; do
+	case "$(stat -fc %T $dir 2>/dev/null)" in
+	cgroup2fs|cgroupfs)
+		cgroup_dir=$dir
+		break
+		;;
+	esac
+done
+server_cgroup=$cgroup_dir/t2004-server-$$
+user_cgroup=$cgroup_dir/t2004-user-$$
+if test_have_prereq SERVER && test -n "$cgroup_dir" \
+    && $SUDO mkdir $server_cgroup 2>/dev/null \
+    && $SUDO sh -c "echo $(cat server.pid) >$server_cgroup/cgroup.procs"; then
+	test_set_prereq SERVER_CGROUP
+fi
+
+test_expect_success SERVER_CGROUP 'flux-imp server runs job shell in cgroup of caller' '
+	fake_imp_input foo | \
+	    FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    $flux_imp exec sh -c "cat /proc/self/cgroup" >cgroup.out &&
+	test_debug "cat cgroup.out" &&
+	cat /proc/self/cgroup >cgroup.expected &&
+	test_cmp cgroup.expected cgroup.out
+'
+test_expect_success NO_CHAIN_LINT,SERVER_CGROUP 'flux-imp kill --cgroup through server refuses cgroup of caller' '
+	$SUDO mkdir $user_cgroup &&
+	$SUDO chown $(id -u) $user_cgroup &&
+	cat >in-cgroup.sh <<-\EOF &&
+	#!/bin/sh
+	cg=$1; shift
+	$SUDO sh -c "echo $$ >$cg/cgroup.procs" || exit 1
+	exec "$@"
+	EOF
+	SUDO="$SUDO" sh in-cgroup.sh $user_cgroup sleep 300 & pid=$! &&
+	count=0 &&
+	while ! grep -q t2004-user /proc/$pid/cgroup && test $count -lt 50; do
+	    sleep 0.1
+	    count=$((count+1))
+	done &&
+	test_must_fail env SUDO="$SUDO" FLUX_IMP_CONFIG_PATTERN=server.toml \
+	    sh in-cgroup.sh $user_cgroup \
+	    $flux_imp kill --cgroup 15 $pid >kill-self.log 2>&1 &&
+	test_debug "cat kill-self.log" &&
+	grep "refusing to kill cgroup .* containing flux-imp" kill-self.log &&
+	kill $pid
+'
+test_expect_success SERVER 'stop flux-imp server' '
+	$SUDO kill $(cat server.pid) &&
+	$SUDO rm -f $socket
+'
+test_expect_success SERVER_CGROUP 'remove test cgroups' '
+	count=0 &&
+	while test -d $server_cgroup && test $count -lt 50; do
+	    $SUDO rmdir $server_cgroup $user_cgroup 2>/dev/null
+	    sleep 0.2
+	    count=$((count+1))
+	done &&
+	! test -d $server_cgroup &&
+	! test -d $user_cgroup
+'
+test_expect_success NO_CHAIN_LINT,SUDO 'start flux-imp server without this user allowed' '
+	cat <<-EOF >refuse.toml &&
+	[exec]
+	allowed-users = [ "nosuchuser" ]
+	EOF
+	$SUDO sh -c "echo \$\$ >refuse.pid && \
+	    exec env FLUX_IMP_CONFIG_PATTERN=refuse.toml \
+	    FLUX_IMP_SERVER_SOCKET=$socket \
+	    $flux_imp server >refuse.log 2>&1" &
+	waitsock $socket
+'
+test -S $socket && test_set_prereq REFUSE_SERVER
+
+test_expect_success REFUSE_SERVER 'refused request is run locally' '
+	FLUX_IMP_CONFIG_PATTERN=server.toml $flux_imp whoami >refused.out &&
+	test_debug "cat refused.out" &&
+	test_must_fail grep "flux-imp: privileged" refused.out
+'
+test_expect_success REFUSE_SERVER 'stop flux-imp server' '
+	$SUDO kill $(cat refuse.pid) &&
+	$SUDO rm -f $socket
+'
+rm -rf $sockdir
+
+test_done